@@ -2,6 +2,7 @@ cmake_minimum_required(VERSION 3.14)
 
 find_package(Vulkan REQUIRED)
 find_package(SDL2 REQUIRED)
+find_package(Threads REQUIRED)
 
 include(${CMAKE_SOURCE_DIR}/cmake/imgui.cmake)
 
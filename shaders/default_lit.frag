@@ -1,7 +1,12 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
 //shader input
 layout (location = 0) in vec3 inColor;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec3 inWorldPosition;
+layout (location = 3) flat in uint inTextureIndex;
+layout (location = 4) flat in vec4 inUvRect;
 
 //output write
 layout (location = 0) out vec4 outFragColor;
@@ -14,8 +19,29 @@ layout(set = 0, binding = 1) uniform  SceneData {
 	vec4 sunlightColor;
 } sceneData;
 
+// every texture of the scene, slot 0 is plain white
+layout(set = 1, binding = 1) uniform sampler2D textures[];
+
+// Repeats the texture inside its rect of the atlas page. The derivatives of
+// the unwrapped coordinates keep fract's jump from picking the smallest level.
+vec4 sample_rect(uint index, vec4 rect, vec2 uv) {
+    return textureGrad(textures[nonuniformEXT(index)], rect.zw + fract(uv) * rect.xy,
+        dFdx(uv) * rect.xy, dFdy(uv) * rect.xy);
+}
+
+// The meshes have no texture coordinates, the texture is projected along
+// the three axes in world space and blended by the normal.
+vec4 sample_triplanar(uint index, vec4 rect, vec3 position, vec3 normal) {
+    // the code built meshes have no normals, those get an even blend
+    vec3 weights = abs(normal) + 1e-4;
+    weights /= weights.x + weights.y + weights.z;
+    return sample_rect(index, rect, position.yz) * weights.x
+        + sample_rect(index, rect, position.xz) * weights.y
+        + sample_rect(index, rect, position.xy) * weights.z;
+}
 
 void main() 
 {	
-	outFragColor = vec4(inColor + sceneData.ambientColor.xyz,1.0f);
+	vec3 albedo = sample_triplanar(inTextureIndex, inUvRect, inWorldPosition, inNormal).rgb;
+	outFragColor = vec4(inColor * albedo + sceneData.ambientColor.xyz,1.0f);
 }
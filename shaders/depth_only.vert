@@ -0,0 +1,35 @@
+#version 460
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Depth prepass version of tri_mesh.vert, reads nothing but the position
+// stream. Packed positions are unorm16, the model matrix scales them back.
+layout (location = 0) in vec3 vPosition;
+
+layout (set = 0, binding = 0) uniform CameraBuffer {
+    mat4 view;
+    mat4 projection;
+    mat4 viewproj;
+    mat4 rotation;
+} cameraData;
+
+struct ObjectData {
+    mat4 model;
+    vec4 uvRect;
+    uint textureIndex;
+};
+
+layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} buffers[];
+
+const uint OBJECT_BUFFER = 0;
+
+// has to come out bit for bit like in tri_mesh.vert, otherwise the main pass
+// fails its depth test against the prepass
+invariant gl_Position;
+
+void main() {
+    mat4 modelMatrix = buffers[OBJECT_BUFFER].objects[gl_InstanceIndex].model;
+    mat4 transformMatrix = (cameraData.viewproj * modelMatrix);
+    gl_Position = transformMatrix * vec4(vPosition, 1.0f);
+}
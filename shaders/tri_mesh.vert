@@ -1,10 +1,21 @@
 #version 460
+#extension GL_EXT_nonuniform_qualifier : require
 
+// The inputs are wide enough for both vertex formats, missing components are
+// filled in by the input assembler.
 layout (location = 0) in vec3 vPosition;
-layout (location = 1) in vec3 vNormal;
+layout (location = 1) in vec4 vNormal;
 layout (location = 2) in vec3 vColor;
 
 layout (location = 0) out vec3 outColor;
+layout (location = 1) out vec3 outNormal;
+layout (location = 2) out vec3 outWorldPosition;
+layout (location = 3) flat out uint outTextureIndex;
+layout (location = 4) flat out vec4 outUvRect;
+
+// true when the pipeline reads PackedVertex: unorm16 positions (the scale and
+// offset are folded into the model matrix), octahedral normals and snorm8 color
+layout (constant_id = 0) const bool PACKED_VERTICES = false;
 
 // binding = 0 says that pick the binding bound at 0
 // set = 0 says that pick up the first one in the binding
@@ -18,6 +29,10 @@ layout (set = 0, binding = 0) uniform CameraBuffer {
 // read object data from storage buffer
 struct ObjectData {
     mat4 model;
+    // xy scale and zw offset of the texture inside its atlas page
+    vec4 uvRect;
+    // slot in the bindless texture array
+    uint textureIndex;
 };
 
 // We need the std140 layout description to make the array match how arrays work in cpp.
@@ -26,13 +41,35 @@ struct ObjectData {
 // 1. To tell Vulkan only to read from it
 // 2. as Storage buffers are defined as buffers even though they're uniforms.
 
+// Set 1 is the bindless set, the objects are in its first buffer.
 layout (std140, set = 1, binding = 0) readonly buffer ObjectBuffer {
     ObjectData objects[];
-} objectBuffer;
+} buffers[];
+
+const uint OBJECT_BUFFER = 0;
+
+// the depth prepass (depth_only.vert) computes the same position
+invariant gl_Position;
+
+vec3 octahedral_decode(vec2 e) {
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
 
 void main() {
-    mat4 modelMatrix = objectBuffer.objects[gl_BaseInstance].model;
+    ObjectData object = buffers[OBJECT_BUFFER].objects[gl_InstanceIndex];
+    mat4 modelMatrix = object.model;
     mat4 transformMatrix = (cameraData.viewproj * modelMatrix);
     gl_Position = transformMatrix * vec4(vPosition, 1.0f);
     outColor = vColor;
+    vec3 normal = PACKED_VERTICES ? octahedral_decode(vNormal.xy) : vNormal.xyz;
+    // only used to weigh the texture projections, the scale of packed
+    // positions bending it a little doesn't matter
+    outNormal = mat3(modelMatrix) * normal;
+    outWorldPosition = (modelMatrix * vec4(vPosition, 1.0f)).xyz;
+    outTextureIndex = object.textureIndex;
+    outUvRect = object.uvRect;
 }
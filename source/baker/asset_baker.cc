@@ -0,0 +1,230 @@
+#include "atlas.hh"
+#include "mesh.hh"
+#include "mesh_cache.hh"
+#include "pack_file.hh"
+#include "texture_cook.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+// every regular file below directory, false when it can't be walked
+bool list_files(const std::filesystem::path& directory, std::vector<std::filesystem::path>& files)
+{
+        std::error_code error;
+        if (!std::filesystem::exists(directory, error)) {
+                std::cerr << "WARN: " << directory << " doesn't exist" << std::endl;
+                return true;
+        }
+        for (auto it = std::filesystem::recursive_directory_iterator(directory, error);
+                !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error)) {
+                if (it->is_regular_file()) {
+                        files.push_back(it->path());
+                }
+        }
+        if (error) {
+                std::cerr << "ERROR: failed to walk " << directory << ": " << error.message() << std::endl;
+                return false;
+        }
+        return true;
+}
+
+// whatever stb_image decodes
+bool is_image(const std::filesystem::path& path)
+{
+        static const char* extensions[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp", ".psd", ".gif", ".hdr", ".pic", ".ppm", ".pgm" };
+        const std::string extension = path.extension().string();
+        return std::find(std::begin(extensions), std::end(extensions), extension) != std::end(extensions);
+}
+
+}
+
+// AssetBaker [asset root] [output directory] [pack file]
+//
+// Cooks every obj below <root>/models into <output>/cache/meshes in every
+// vertex format, through the same Mesh::load the engine uses, so the engine
+// finds them there and only has to map them. The output directory is the
+// build directory the engine runs from, nothing is written into the sources.
+// glb files are read in place by the engine and skipped here. The images
+// below <root>/textures of at most ATLAS_MAX_TEXTURE_SIZE are packed into
+// atlas pages in <output>/cache/textures, listed in its ATLAS_MANIFEST, the
+// engine samples those from the pages. Every other image is compressed into a
+// KTX2 of its own there.
+//
+// With a pack file the models, textures, their cooked versions, the compiled
+// shaders and the fonts are written into it as well, named relative to the
+// output directory like the engine opens them. Only the obj sources get
+// compressed, the engine reads them just on cache misses, everything else
+// stays raw so it is used straight from the mapping.
+int main(int argc, char* argv[])
+{
+        const std::filesystem::path root = argc > 1 ? argv[1] : "..";
+        const std::filesystem::path output = argc > 2 ? argv[2] : ".";
+        const char* packPath = argc > 3 ? argv[3] : nullptr;
+        MeshCache::global().set_directory((output / MESH_CACHE_DIRECTORY).string());
+        const std::string textureCache = (output / TEXTURE_CACHE_DIRECTORY).string();
+
+        std::vector<std::filesystem::path> models;
+        if (!list_files(root / "models", models)) {
+                return 1;
+        }
+        std::vector<std::string> sources;
+        for (const std::filesystem::path& model : models) {
+                if (model.extension() == ".obj") {
+                        sources.push_back(model.string());
+                }
+        }
+        // biggest first, they would otherwise be the long tail at the end
+        std::sort(sources.begin(), sources.end(), [](const std::string& l, const std::string& r) {
+                std::error_code error;
+                return std::filesystem::file_size(l, error) > std::filesystem::file_size(r, error);
+        });
+
+        const VertexFormat formats[] = { VertexFormat::Full, VertexFormat::Packed };
+        const size_t formatCount = std::size(formats);
+
+        // every source in every format, obj::parse goes wide inside a job too
+        std::atomic<uint32_t> failures { 0 };
+        auto start = std::chrono::high_resolution_clock::now();
+        ThreadPool::global().parallel_for(sources.size() * formatCount, [&](size_t job) {
+                const std::string& source = sources[job / formatCount];
+                Mesh mesh;
+                if (!mesh.load(source.c_str(), formats[job % formatCount])) {
+                        std::cerr << "ERROR: failed to bake " << source << std::endl;
+                        failures++;
+                }
+        });
+        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        const MeshCacheStats stats = MeshCache::global().stats();
+        std::printf("Baked %zu sources in %zu formats in %.2f s on %u threads: %u cooked, %u already cached, %u failed\n",
+                sources.size(), formatCount, elapsed.count(), ThreadPool::global().size(), stats.misses, stats.hits, failures.load());
+        if (failures > 0) {
+                return 1;
+        }
+
+        std::vector<std::filesystem::path> textures;
+        if (!list_files(root / "textures", textures)) {
+                return 1;
+        }
+        std::erase_if(textures, [](const std::filesystem::path& texture) { return !is_image(texture); });
+        std::vector<std::string> textureSources;
+        std::vector<std::string> textureNames;
+        for (const std::filesystem::path& texture : textures) {
+                textureSources.push_back(texture.string());
+                textureNames.push_back(std::filesystem::relative(texture, root).generic_string());
+        }
+        atlas::Manifest manifest;
+        const std::string manifestPath = (std::filesystem::path(textureCache) / ATLAS_MANIFEST).string();
+        start = std::chrono::high_resolution_clock::now();
+        if (!atlas::bake(textureSources, textureNames, textureCache, manifest) || !atlas::write_manifest(manifestPath.c_str(), manifest)) {
+                std::cerr << "ERROR: failed to bake the texture atlases" << std::endl;
+                return 1;
+        }
+        elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        // how well the small textures packed, the border counts as unused
+        std::unordered_set<std::string> atlased;
+        for (const atlas::Page& page : manifest.pages) {
+                uint64_t used = 0;
+                for (const atlas::Member& member : page.members) {
+                        used += uint64_t(member.rect.width) * member.rect.height;
+                        atlased.insert(member.name);
+                }
+                std::printf("  atlas %ux%u %s: %zu textures, %.1f%% filled\n", page.width, page.height, page.opaque ? "BC1" : "BC7",
+                        page.members.size(), 100.0 * used / (uint64_t(page.width) * page.height));
+        }
+        std::printf("Packed %zu small textures into %zu atlas pages in %.2f s\n", atlased.size(), manifest.pages.size(), elapsed.count());
+
+        // the engine samples the atlas members from the pages, only the
+        // others get a cooked file of their own. The block compression goes
+        // wide inside too
+        std::vector<std::string> cookedTextures(textures.size());
+        std::atomic<uint32_t> cooked { 0 };
+        start = std::chrono::high_resolution_clock::now();
+        ThreadPool::global().parallel_for(textures.size(), [&](size_t i) {
+                if (atlased.contains(textureNames[i])) {
+                        return;
+                }
+                const std::string& source = textureSources[i];
+                cookedTextures[i] = texture_cook::entry_path(source.c_str(), true, textureCache);
+                std::error_code error;
+                if (!cookedTextures[i].empty() && std::filesystem::exists(cookedTextures[i], error)) {
+                        return;
+                }
+                if (cookedTextures[i].empty() || !texture_cook::cook(source.c_str(), cookedTextures[i].c_str())) {
+                        std::cerr << "ERROR: failed to bake " << source << std::endl;
+                        failures++;
+                        return;
+                }
+                cooked++;
+        });
+        elapsed = std::chrono::high_resolution_clock::now() - start;
+
+        std::printf("Baked %zu textures in %.2f s: %zu in atlases, %u cooked, %u failed\n", textures.size(), elapsed.count(), atlased.size(),
+                cooked.load(), failures.load());
+        if (failures > 0) {
+                return 1;
+        }
+        if (!packPath) {
+                return 0;
+        }
+
+        std::vector<pack::PackInput> inputs;
+        auto add = [&](const std::filesystem::path& path, bool compress) {
+                std::string name = std::filesystem::relative(path, output).generic_string();
+                inputs.push_back({ name, path.string(), compress });
+        };
+        for (const std::filesystem::path& model : models) {
+                add(model, model.extension() == ".obj");
+        }
+        // only the entries of the current sources, the cache directory keeps
+        // the ones of every older version as well
+        for (const std::string& source : sources) {
+                for (VertexFormat format : formats) {
+                        add(MeshCache::global().entry_path(source.c_str(), format), false);
+                }
+        }
+        // the atlas members have no cooked file of their own
+        for (size_t i = 0; i < textures.size(); i++) {
+                add(textures[i], false);
+                if (!cookedTextures[i].empty()) {
+                        add(cookedTextures[i], false);
+                }
+        }
+        for (const atlas::Page& page : manifest.pages) {
+                add(std::filesystem::path(textureCache) / page.compressedFile, false);
+                add(std::filesystem::path(textureCache) / page.uncompressedFile, false);
+        }
+        add(manifestPath, false);
+        std::vector<std::filesystem::path> files;
+        if (!list_files(root / "shaders" / "compiled", files) || !list_files(root / "fonts", files)) {
+                return 1;
+        }
+        for (const std::filesystem::path& file : files) {
+                add(file, false);
+        }
+
+        // most builds change nothing, the pack stays as it is then
+        if (pack::is_current(packPath, inputs)) {
+                std::printf("%s is up to date, %zu files\n", packPath, inputs.size());
+                return 0;
+        }
+        if (!pack::write(packPath, inputs)) {
+                std::cerr << "ERROR: failed to write " << packPath << std::endl;
+                return 1;
+        }
+        std::error_code error;
+        std::printf("Packed %zu files into %s, %.1f MB\n", inputs.size(), packPath,
+                std::filesystem::file_size(packPath, error) / (1024.0 * 1024.0));
+        return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 64 bit xxHash (XXH64), a few GB/s per core, used for content addressed
+// caches. Not meant to be cryptographic.
+uint64_t hash64(const void* data, size_t size, uint64_t seed = 0);
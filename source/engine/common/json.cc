@@ -0,0 +1,364 @@
+#include "json.hh"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+namespace json {
+
+namespace {
+
+const Value NULL_VALUE {};
+
+// documents nested deeper than this are rejected instead of overflowing the stack
+constexpr int MAX_DEPTH = 256;
+
+void append_utf8(std::string& out, uint32_t codepoint)
+{
+        if (codepoint < 0x80) {
+                out += static_cast<char>(codepoint);
+        } else if (codepoint < 0x800) {
+                out += static_cast<char>(0xc0 | (codepoint >> 6));
+                out += static_cast<char>(0x80 | (codepoint & 0x3f));
+        } else if (codepoint < 0x10000) {
+                out += static_cast<char>(0xe0 | (codepoint >> 12));
+                out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+                out += static_cast<char>(0x80 | (codepoint & 0x3f));
+        } else {
+                out += static_cast<char>(0xf0 | (codepoint >> 18));
+                out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3f));
+                out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3f));
+                out += static_cast<char>(0x80 | (codepoint & 0x3f));
+        }
+}
+
+}
+
+class Parser {
+public:
+        Parser(const char* data, size_t size)
+                : _cursor(data)
+                , _begin(data)
+                , _end(data + size)
+        {
+        }
+
+        bool parse_document(Value& out)
+        {
+                if (!parse_value(out, 0)) {
+                        return false;
+                }
+                skip_whitespace();
+                return _cursor == _end || fail("trailing characters");
+        }
+
+        std::string error() const { return _error + " at byte " + std::to_string(_errorOffset); }
+
+private:
+        bool fail(const char* message)
+        {
+                if (_error.empty()) {
+                        _error = message;
+                        _errorOffset = _cursor - _begin;
+                }
+                return false;
+        }
+
+        void skip_whitespace()
+        {
+                while (_cursor < _end && (*_cursor == ' ' || *_cursor == '\t' || *_cursor == '\n' || *_cursor == '\r')) {
+                        _cursor++;
+                }
+        }
+
+        bool consume(const char* literal)
+        {
+                size_t length = std::strlen(literal);
+                if (static_cast<size_t>(_end - _cursor) < length || std::memcmp(_cursor, literal, length) != 0) {
+                        return fail("unexpected token");
+                }
+                _cursor += length;
+                return true;
+        }
+
+        bool parse_value(Value& out, int depth)
+        {
+                if (depth > MAX_DEPTH) {
+                        return fail("nested too deep");
+                }
+
+                skip_whitespace();
+                if (_cursor == _end) {
+                        return fail("unexpected end");
+                }
+
+                switch (*_cursor) {
+                case '{':
+                        return parse_object(out, depth);
+                case '[':
+                        return parse_array(out, depth);
+                case '"':
+                        out._type = Value::Type::String;
+                        return parse_string(out._string);
+                case 't':
+                        out._type = Value::Type::Bool;
+                        out._bool = true;
+                        return consume("true");
+                case 'f':
+                        out._type = Value::Type::Bool;
+                        out._bool = false;
+                        return consume("false");
+                case 'n':
+                        out._type = Value::Type::Null;
+                        return consume("null");
+                default:
+                        return parse_number(out);
+                }
+        }
+
+        bool parse_object(Value& out, int depth)
+        {
+                out._type = Value::Type::Object;
+                _cursor++;
+                skip_whitespace();
+                if (_cursor < _end && *_cursor == '}') {
+                        _cursor++;
+                        return true;
+                }
+
+                while (true) {
+                        skip_whitespace();
+                        if (_cursor == _end || *_cursor != '"') {
+                                return fail("expected a member name");
+                        }
+                        out._members.emplace_back();
+                        if (!parse_string(out._members.back().first)) {
+                                return false;
+                        }
+
+                        skip_whitespace();
+                        if (_cursor == _end || *_cursor != ':') {
+                                return fail("expected ':'");
+                        }
+                        _cursor++;
+                        if (!parse_value(out._members.back().second, depth + 1)) {
+                                return false;
+                        }
+
+                        skip_whitespace();
+                        if (_cursor < _end && *_cursor == ',') {
+                                _cursor++;
+                        } else if (_cursor < _end && *_cursor == '}') {
+                                _cursor++;
+                                return true;
+                        } else {
+                                return fail("expected ',' or '}'");
+                        }
+                }
+        }
+
+        bool parse_array(Value& out, int depth)
+        {
+                out._type = Value::Type::Array;
+                _cursor++;
+                skip_whitespace();
+                if (_cursor < _end && *_cursor == ']') {
+                        _cursor++;
+                        return true;
+                }
+
+                while (true) {
+                        out._elements.emplace_back();
+                        if (!parse_value(out._elements.back(), depth + 1)) {
+                                return false;
+                        }
+
+                        skip_whitespace();
+                        if (_cursor < _end && *_cursor == ',') {
+                                _cursor++;
+                        } else if (_cursor < _end && *_cursor == ']') {
+                                _cursor++;
+                                return true;
+                        } else {
+                                return fail("expected ',' or ']'");
+                        }
+                }
+        }
+
+        bool parse_hex(uint32_t& value)
+        {
+                if (_end - _cursor < 4) {
+                        return fail("truncated escape");
+                }
+                value = 0;
+                for (int i = 0; i < 4; i++) {
+                        char c = *_cursor++;
+                        value <<= 4;
+                        if (c >= '0' && c <= '9') {
+                                value |= c - '0';
+                        } else if (c >= 'a' && c <= 'f') {
+                                value |= c - 'a' + 10;
+                        } else if (c >= 'A' && c <= 'F') {
+                                value |= c - 'A' + 10;
+                        } else {
+                                return fail("invalid escape");
+                        }
+                }
+                return true;
+        }
+
+        bool parse_string(std::string& out)
+        {
+                // skip the opening quote
+                _cursor++;
+                while (_cursor < _end) {
+                        char c = *_cursor++;
+                        if (c == '"') {
+                                return true;
+                        }
+                        if (c != '\\') {
+                                out += c;
+                                continue;
+                        }
+
+                        if (_cursor == _end) {
+                                break;
+                        }
+                        switch (*_cursor++) {
+                        case '"':
+                                out += '"';
+                                break;
+                        case '\\':
+                                out += '\\';
+                                break;
+                        case '/':
+                                out += '/';
+                                break;
+                        case 'b':
+                                out += '\b';
+                                break;
+                        case 'f':
+                                out += '\f';
+                                break;
+                        case 'n':
+                                out += '\n';
+                                break;
+                        case 'r':
+                                out += '\r';
+                                break;
+                        case 't':
+                                out += '\t';
+                                break;
+                        case 'u': {
+                                uint32_t codepoint;
+                                if (!parse_hex(codepoint)) {
+                                        return false;
+                                }
+                                // surrogates only come in pairs, a high one followed by a low one
+                                if (codepoint >= 0xdc00 && codepoint < 0xe000) {
+                                        return fail("invalid surrogate pair");
+                                }
+                                if (codepoint >= 0xd800 && codepoint < 0xdc00) {
+                                        if (_end - _cursor < 6 || _cursor[0] != '\\' || _cursor[1] != 'u') {
+                                                return fail("invalid surrogate pair");
+                                        }
+                                        _cursor += 2;
+                                        uint32_t low;
+                                        if (!parse_hex(low)) {
+                                                return false;
+                                        }
+                                        if (low < 0xdc00 || low >= 0xe000) {
+                                                return fail("invalid surrogate pair");
+                                        }
+                                        codepoint = 0x10000 + ((codepoint - 0xd800) << 10) + (low - 0xdc00);
+                                }
+                                append_utf8(out, codepoint);
+                                break;
+                        }
+                        default:
+                                return fail("invalid escape");
+                        }
+                }
+                return fail("unterminated string");
+        }
+
+        bool parse_number(Value& out)
+        {
+                const char* start = _cursor;
+                while (_cursor < _end
+                        && ((*_cursor >= '0' && *_cursor <= '9') || *_cursor == '-' || *_cursor == '+' || *_cursor == '.'
+                                || *_cursor == 'e' || *_cursor == 'E')) {
+                        _cursor++;
+                }
+                if (_cursor == start) {
+                        return fail("unexpected character");
+                }
+
+                // strtod wants a terminated string, numbers are short
+                std::string token(start, _cursor);
+                char* end = nullptr;
+                out._type = Value::Type::Number;
+                out._number = std::strtod(token.c_str(), &end);
+                if (end != token.c_str() + token.size()) {
+                        _cursor = start;
+                        return fail("invalid number");
+                }
+                return true;
+        }
+
+        const char* _cursor;
+        const char* _begin;
+        const char* _end;
+        std::string _error;
+        size_t _errorOffset = 0;
+};
+
+size_t Value::size() const
+{
+        if (_type == Type::Array) {
+                return _elements.size();
+        }
+        if (_type == Type::Object) {
+                return _members.size();
+        }
+        return 0;
+}
+
+const Value& Value::operator[](size_t index) const
+{
+        if (_type != Type::Array || index >= _elements.size()) {
+                return NULL_VALUE;
+        }
+        return _elements[index];
+}
+
+const Value* Value::find(const char* key) const
+{
+        for (const auto& member : _members) {
+                if (member.first == key) {
+                        return &member.second;
+                }
+        }
+        return nullptr;
+}
+
+double Value::number(const char* key, double fallback) const
+{
+        const Value* value = find(key);
+        return value ? value->as_number(fallback) : fallback;
+}
+
+bool parse(const char* data, size_t size, Value& out, std::string* error)
+{
+        out = Value {};
+        Parser parser(data, size);
+        if (!parser.parse_document(out)) {
+                if (error) {
+                        *error = parser.error();
+                }
+                return false;
+        }
+        return true;
+}
+
+}
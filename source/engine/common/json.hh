@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Small DOM style JSON reader, enough for asset metadata like the glTF
+// scene description. Numbers are stored as doubles.
+namespace json {
+
+class Value {
+public:
+        enum class Type {
+                Null,
+                Bool,
+                Number,
+                String,
+                Array,
+                Object,
+        };
+
+        Type type() const { return _type; }
+        bool is_null() const { return _type == Type::Null; }
+        bool is_number() const { return _type == Type::Number; }
+        bool is_string() const { return _type == Type::String; }
+        bool is_array() const { return _type == Type::Array; }
+        bool is_object() const { return _type == Type::Object; }
+
+        // the fallback is returned when the value has another type
+        bool as_bool(bool fallback = false) const { return _type == Type::Bool ? _bool : fallback; }
+        double as_number(double fallback = 0.0) const { return _type == Type::Number ? _number : fallback; }
+        const std::string& as_string() const { return _string; }
+
+        // element count of arrays and objects, 0 for everything else
+        size_t size() const;
+        // array element, a null value when out of range
+        const Value& operator[](size_t index) const;
+        // object member, nullptr when missing
+        const Value* find(const char* key) const;
+        // find() for members that are numbers
+        double number(const char* key, double fallback = 0.0) const;
+
+        const std::vector<std::pair<std::string, Value>>& members() const { return _members; }
+
+private:
+        friend class Parser;
+
+        Type _type = Type::Null;
+        bool _bool = false;
+        double _number = 0.0;
+        std::string _string;
+        std::vector<Value> _elements;
+        std::vector<std::pair<std::string, Value>> _members;
+};
+
+// Parses a whole document, error gets a message with the byte offset.
+bool parse(const char* data, size_t size, Value& out, std::string* error = nullptr);
+
+}
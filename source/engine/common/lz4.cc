@@ -0,0 +1,204 @@
+#include "lz4.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace lz4 {
+
+namespace {
+
+constexpr size_t MIN_MATCH = 4;
+// the last match has to start this far before the end of the block
+constexpr size_t MATCH_START_LIMIT = 12;
+// and the last 5 bytes are always literals
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 16;
+
+uint32_t read32(const uint8_t* p)
+{
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+}
+
+uint32_t hash(uint32_t sequence)
+{
+        return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// writes the 255 continuation bytes of a length that didn't fit its nibble
+bool write_length(uint8_t*& op, const uint8_t* oend, size_t length)
+{
+        while (length >= 255) {
+                if (op >= oend) {
+                        return false;
+                }
+                *op++ = 255;
+                length -= 255;
+        }
+        if (op >= oend) {
+                return false;
+        }
+        *op++ = static_cast<uint8_t>(length);
+        return true;
+}
+
+bool read_length(const uint8_t*& ip, const uint8_t* iend, size_t& length)
+{
+        uint8_t byte;
+        do {
+                if (ip >= iend) {
+                        return false;
+                }
+                byte = *ip++;
+                length += byte;
+        } while (byte == 255);
+        return true;
+}
+
+// one sequence: literals, then a match unless it is the last one
+bool write_sequence(uint8_t*& op, const uint8_t* oend, const uint8_t* literals, size_t literalLength, size_t offset, size_t matchLength)
+{
+        if (op >= oend) {
+                return false;
+        }
+        uint8_t* token = op++;
+        *token = static_cast<uint8_t>(std::min<size_t>(literalLength, 15) << 4);
+        if (literalLength >= 15 && !write_length(op, oend, literalLength - 15)) {
+                return false;
+        }
+        if (literalLength > static_cast<size_t>(oend - op)) {
+                return false;
+        }
+        // empty buffers may be null, which memcpy doesn't allow even for 0
+        if (literalLength > 0) {
+                std::memcpy(op, literals, literalLength);
+        }
+        op += literalLength;
+
+        if (matchLength == 0) {
+                return true;
+        }
+        if (oend - op < 2) {
+                return false;
+        }
+        *op++ = static_cast<uint8_t>(offset);
+        *op++ = static_cast<uint8_t>(offset >> 8);
+        matchLength -= MIN_MATCH;
+        *token |= static_cast<uint8_t>(std::min<size_t>(matchLength, 15));
+        return matchLength < 15 || write_length(op, oend, matchLength - 15);
+}
+
+}
+
+size_t compress_bound(size_t size)
+{
+        return size + size / 255 + 16;
+}
+
+size_t compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity)
+{
+        uint8_t* op = dst;
+        const uint8_t* oend = dst + capacity;
+
+        // last position a match may start at, plus one
+        const size_t matchStartEnd = size > MATCH_START_LIMIT ? size - MATCH_START_LIMIT : 0;
+        // positions + 1 so zero means empty
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+
+        size_t anchor = 0;
+        size_t ip = 0;
+        while (ip < matchStartEnd) {
+                const uint32_t sequence = read32(src + ip);
+                uint32_t& slot = table[hash(sequence)];
+                const size_t candidate = slot;
+                slot = static_cast<uint32_t>(ip + 1);
+
+                if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET || read32(src + candidate - 1) != sequence) {
+                        ip++;
+                        continue;
+                }
+
+                const size_t match = candidate - 1;
+                size_t length = MIN_MATCH;
+                while (ip + length < size - LAST_LITERALS && src[match + length] == src[ip + length]) {
+                        length++;
+                }
+
+                if (!write_sequence(op, oend, src + anchor, ip - anchor, ip - match, length)) {
+                        return 0;
+                }
+                ip += length;
+                anchor = ip;
+        }
+
+        if (!write_sequence(op, oend, src + anchor, size - anchor, 0, 0)) {
+                return 0;
+        }
+        return op - dst;
+}
+
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize)
+{
+        const uint8_t* ip = src;
+        const uint8_t* iend = src + srcSize;
+        uint8_t* op = dst;
+        uint8_t* oend = dst + dstSize;
+
+        while (ip < iend) {
+                const uint8_t token = *ip++;
+
+                size_t literalLength = token >> 4;
+                if (literalLength == 15 && !read_length(ip, iend, literalLength)) {
+                        return false;
+                }
+                if (literalLength > static_cast<size_t>(iend - ip) || literalLength > static_cast<size_t>(oend - op)) {
+                        return false;
+                }
+                if (literalLength > 0) {
+                        std::memcpy(op, ip, literalLength);
+                }
+                ip += literalLength;
+                op += literalLength;
+
+                // the last sequence has no match
+                if (ip == iend) {
+                        break;
+                }
+
+                if (iend - ip < 2) {
+                        return false;
+                }
+                const size_t offset = ip[0] | (ip[1] << 8);
+                ip += 2;
+                if (offset == 0 || offset > static_cast<size_t>(op - dst)) {
+                        return false;
+                }
+
+                size_t matchLength = token & 15;
+                if (matchLength == 15 && !read_length(ip, iend, matchLength)) {
+                        return false;
+                }
+                matchLength += MIN_MATCH;
+                if (matchLength > static_cast<size_t>(oend - op)) {
+                        return false;
+                }
+
+                // matches may overlap their own output, runs of a byte do
+                const uint8_t* match = op - offset;
+                if (offset >= matchLength) {
+                        std::memcpy(op, match, matchLength);
+                } else {
+                        for (size_t i = 0; i < matchLength; i++) {
+                                op[i] = match[i];
+                        }
+                }
+                op += matchLength;
+        }
+
+        return op == oend;
+}
+
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// LZ4 block format, compatible with the reference implementation. The
+// compressor is the plain greedy one, fast enough for offline packing, the
+// decompressor checks every length against both buffers.
+namespace lz4 {
+
+// worst case size of compressing size bytes
+size_t compress_bound(size_t size);
+// compressed size, 0 when it doesn't fit into capacity
+size_t compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+// true when src decoded into exactly dstSize bytes
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+}
@@ -0,0 +1,155 @@
+#include "mapped_file.hh"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+        close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+        *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+        if (this != &other) {
+                close();
+                std::swap(_data, other._data);
+                std::swap(_size, other._size);
+#ifdef _WIN32
+                std::swap(_file, other._file);
+                std::swap(_fileMapping, other._fileMapping);
+#endif
+        }
+        return *this;
+}
+
+#ifdef _WIN32
+bool MappedFile::open(const char* path)
+{
+        close();
+
+        HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+                return false;
+        }
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+                CloseHandle(file);
+                return false;
+        }
+
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping) {
+                CloseHandle(file);
+                return false;
+        }
+
+        void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!view) {
+                CloseHandle(mapping);
+                CloseHandle(file);
+                return false;
+        }
+
+        _file = file;
+        _fileMapping = mapping;
+        _data = static_cast<const uint8_t*>(view);
+        _size = static_cast<size_t>(fileSize.QuadPart);
+        return true;
+}
+
+void MappedFile::close()
+{
+        if (_data) {
+                UnmapViewOfFile(_data);
+                CloseHandle(_fileMapping);
+                CloseHandle(_file);
+        }
+        _data = nullptr;
+        _size = 0;
+        _file = nullptr;
+        _fileMapping = nullptr;
+}
+#else
+bool MappedFile::open(const char* path)
+{
+        close();
+
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) {
+                return false;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0) {
+                ::close(fd);
+                return false;
+        }
+
+        void* view = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // the mapping keeps its own reference to the file
+        ::close(fd);
+        if (view == MAP_FAILED) {
+                return false;
+        }
+
+        _data = static_cast<const uint8_t*>(view);
+        _size = static_cast<size_t>(info.st_size);
+        return true;
+}
+
+void MappedFile::close()
+{
+        if (_data) {
+                munmap(const_cast<uint8_t*>(_data), _size);
+        }
+        _data = nullptr;
+        _size = 0;
+}
+#endif
+
+bool write_file_atomically(const char* path, const std::function<bool(std::ostream&)>& write)
+{
+        static std::atomic<uint64_t> counter { 0 };
+#ifdef _WIN32
+        const unsigned long process = GetCurrentProcessId();
+#else
+        const unsigned long process = static_cast<unsigned long>(getpid());
+#endif
+        const std::string tempPath = std::string(path) + "." + std::to_string(process) + "." + std::to_string(counter++) + ".tmp";
+
+        bool written;
+        {
+                std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+                written = file.is_open() && write(file);
+                file.close();
+                written = written && file.good();
+        }
+        std::error_code error;
+        if (written) {
+                std::filesystem::rename(tempPath, path, error);
+        }
+        if (!written || error) {
+                std::filesystem::remove(tempPath, error);
+                return false;
+        }
+        return true;
+}
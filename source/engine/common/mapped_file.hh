@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+
+// Read-only memory mapping of a whole file, the mapping lives as long as the
+// object does so any pointer into data() has to be dropped before that.
+class MappedFile {
+public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        bool open(const char* path);
+        void close();
+
+        bool is_open() const { return _data != nullptr; }
+        const uint8_t* data() const { return _data; }
+        size_t size() const { return _size; }
+
+private:
+        const uint8_t* _data = nullptr;
+        size_t _size = 0;
+#ifdef _WIN32
+        void* _file = nullptr;
+        void* _fileMapping = nullptr;
+#endif
+};
+
+// Writes path through a temporary file that is renamed over it once write
+// returned true, so a crash never leaves half of it behind. The temporary
+// name is unique, writers of the same path in other threads and processes
+// don't step on each other, the last rename wins.
+bool write_file_atomically(const char* path, const std::function<bool(std::ostream&)>& write);
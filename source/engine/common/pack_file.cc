@@ -0,0 +1,147 @@
+#include "pack_file.hh"
+#include "hash.hh"
+#include "lz4.hh"
+#include "mapped_file.hh"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string_view>
+
+namespace pack {
+
+namespace {
+
+uint64_t align(uint64_t offset)
+{
+        return (offset + PACK_ALIGNMENT - 1) & ~(PACK_ALIGNMENT - 1);
+}
+
+}
+
+bool write(const char* filename, const std::vector<PackInput>& inputs)
+{
+        return write_file_atomically(filename, [&](std::ostream& file) {
+                // the header goes in last, once the offsets are known
+                PackHeader header {};
+                header.magic = PACK_MAGIC;
+                header.version = PACK_VERSION;
+                header.entryCount = static_cast<uint32_t>(inputs.size());
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+                std::vector<PackEntry> entries;
+                std::string names;
+                std::vector<uint8_t> compressed;
+                const char padding[PACK_ALIGNMENT] = {};
+                uint64_t offset = sizeof(header);
+
+                for (const PackInput& input : inputs) {
+                        MappedFile source;
+                        // empty files don't map, they are valid entries all the same
+                        std::error_code error;
+                        const bool empty = std::filesystem::file_size(input.path, error) == 0 && !error;
+                        if (!empty && !source.open(input.path.c_str())) {
+                                std::cerr << "ERROR: failed to open " << input.path << std::endl;
+                                return false;
+                        }
+
+                        PackEntry entry {};
+                        entry.rawSize = source.size();
+                        entry.hash = hash64(source.data(), source.size());
+                        entry.nameOffset = static_cast<uint32_t>(names.size());
+                        entry.nameLength = static_cast<uint32_t>(input.name.size());
+                        names += input.name;
+
+                        const uint8_t* data = source.data();
+                        entry.size = source.size();
+                        entry.compression = Compression::None;
+                        entry.compressRequested = input.compress;
+                        // the compressor keeps 32 bit positions
+                        if (input.compress && source.size() > 0 && source.size() < UINT32_MAX) {
+                                compressed.resize(lz4::compress_bound(source.size()));
+                                size_t size = lz4::compress(source.data(), source.size(), compressed.data(), compressed.size());
+                                if (size > 0 && size <= source.size() / 4 * 3) {
+                                        data = compressed.data();
+                                        entry.size = size;
+                                        entry.compression = Compression::LZ4;
+                                }
+                        }
+
+                        const uint64_t aligned = align(offset);
+                        file.write(padding, aligned - offset);
+                        entry.offset = aligned;
+                        if (entry.size > 0) {
+                                file.write(reinterpret_cast<const char*>(data), entry.size);
+                        }
+                        offset = aligned + entry.size;
+                        entries.push_back(entry);
+                }
+
+                header.tocOffset = align(offset);
+                file.write(padding, header.tocOffset - offset);
+                file.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PackEntry));
+                header.namesOffset = header.tocOffset + entries.size() * sizeof(PackEntry);
+                header.namesSize = names.size();
+                file.write(names.data(), names.size());
+
+                file.seekp(0);
+                file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                return file.good();
+        });
+}
+
+bool is_current(const char* filename, const std::vector<PackInput>& inputs)
+{
+        std::error_code error;
+        if (!std::filesystem::exists(filename, error)) {
+                return false;
+        }
+        MappedFile pack;
+        if (!pack.open(filename)) {
+                return false;
+        }
+
+        const uint8_t* base = pack.data();
+        const size_t size = pack.size();
+        PackHeader header;
+        if (size < sizeof(header)) {
+                return false;
+        }
+        std::memcpy(&header, base, sizeof(header));
+        if (header.magic != PACK_MAGIC || header.version != PACK_VERSION || header.entryCount != inputs.size()
+                || header.tocOffset > size || header.entryCount > (size - header.tocOffset) / sizeof(PackEntry)
+                || header.namesOffset > size || header.namesSize > size - header.namesOffset) {
+                return false;
+        }
+
+        // the names and flags are compared first, they are cheaper than the
+        // contents
+        std::vector<PackEntry> entries(header.entryCount);
+        std::memcpy(entries.data(), base + header.tocOffset, entries.size() * sizeof(PackEntry));
+        const char* names = reinterpret_cast<const char*>(base + header.namesOffset);
+        for (size_t i = 0; i < inputs.size(); i++) {
+                const PackEntry& entry = entries[i];
+                if (uint64_t(entry.nameOffset) + entry.nameLength > header.namesSize
+                        || std::string_view(names + entry.nameOffset, entry.nameLength) != inputs[i].name
+                        || (entry.compressRequested != 0) != inputs[i].compress) {
+                        return false;
+                }
+        }
+
+        for (size_t i = 0; i < inputs.size(); i++) {
+                const uint64_t inputSize = std::filesystem::file_size(inputs[i].path, error);
+                if (error || inputSize != entries[i].rawSize) {
+                        return false;
+                }
+                MappedFile source;
+                if (inputSize > 0 && !source.open(inputs[i].path.c_str())) {
+                        return false;
+                }
+                if (hash64(source.data(), source.size()) != entries[i].hash) {
+                        return false;
+                }
+        }
+        return true;
+}
+
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// On disk layout of an asset pack:
+//      PackHeader
+//      blobs, every one aligned to PACK_ALIGNMENT
+//      PackEntry[entryCount]
+//      entry names, not terminated
+// Uncompressed blobs are used straight from the mapping, so the alignment is
+// enough for SPIR-V words and cooked mesh sections.
+namespace pack {
+
+constexpr uint32_t PACK_MAGIC = 0x4b434150; // "PACK"
+constexpr uint32_t PACK_VERSION = 2;
+constexpr uint64_t PACK_ALIGNMENT = 16;
+
+enum class Compression : uint32_t {
+        None = 0,
+        // one LZ4 block
+        LZ4 = 1,
+};
+
+struct PackHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t reserved;
+        uint64_t tocOffset;
+        uint64_t namesOffset;
+        uint64_t namesSize;
+};
+
+struct PackEntry {
+        uint64_t offset;
+        // bytes in the pack, rawSize once decompressed
+        uint64_t size;
+        uint64_t rawSize;
+        // hash64 of the raw bytes, saves hashing content addressed lookups
+        uint64_t hash;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        Compression compression;
+        // PackInput::compress it was written with, compression stays None
+        // when LZ4 didn't save enough
+        uint32_t compressRequested;
+};
+
+struct PackInput {
+        // path inside the pack, '/' separated
+        std::string name;
+        // file to read it from
+        std::string path;
+        // LZ4 is only kept when it saves a quarter of the size
+        bool compress = true;
+};
+
+// Writes the inputs into a new pack, false when an input can't be read or
+// the pack can't be written.
+bool write(const char* filename, const std::vector<PackInput>& inputs);
+
+// Whether filename is a pack of exactly these inputs, in this order, with the
+// same compress flags and the contents they have now. Only hashes the inputs, rewriting an up to date
+// pack would compress and write all of them again.
+bool is_current(const char* filename, const std::vector<PackInput>& inputs);
+
+}
@@ -0,0 +1,88 @@
+#include "range_allocator.hh"
+
+#include <cassert>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(uint64_t capacity)
+{
+        grow(capacity);
+}
+
+uint64_t RangeAllocator::allocate(uint64_t size, uint64_t alignment)
+{
+        if (size == 0 || alignment == 0) {
+                return INVALID_OFFSET;
+        }
+
+        for (auto it = _free.begin(); it != _free.end(); ++it) {
+                uint64_t blockStart = it->first;
+                uint64_t blockSize = it->second;
+
+                uint64_t offset = (blockStart + alignment - 1) / alignment * alignment;
+                uint64_t padding = offset - blockStart;
+                if (padding + size > blockSize) {
+                        continue;
+                }
+
+                _free.erase(it);
+                // whatever is left behind the range stays free
+                uint64_t end = offset + size;
+                if (end < blockStart + blockSize) {
+                        _free[end] = blockStart + blockSize - end;
+                }
+
+                _allocations[offset] = { size, blockStart };
+                _used += padding + size;
+                return offset;
+        }
+
+        return INVALID_OFFSET;
+}
+
+void RangeAllocator::free(uint64_t offset)
+{
+        auto it = _allocations.find(offset);
+        assert(it != _allocations.end() && "freeing a range that was never allocated");
+        if (it == _allocations.end()) {
+                return;
+        }
+
+        uint64_t blockStart = it->second.blockStart;
+        uint64_t blockSize = offset + it->second.size - blockStart;
+        _allocations.erase(it);
+        _used -= blockSize;
+
+        insert_free(blockStart, blockSize);
+}
+
+void RangeAllocator::grow(uint64_t capacity)
+{
+        if (capacity <= _capacity) {
+                return;
+        }
+
+        insert_free(_capacity, capacity - _capacity);
+        _capacity = capacity;
+}
+
+void RangeAllocator::insert_free(uint64_t offset, uint64_t size)
+{
+        auto next = _free.lower_bound(offset);
+
+        // merge with the free range behind it
+        if (next != _free.end() && offset + size == next->first) {
+                size += next->second;
+                next = _free.erase(next);
+        }
+
+        // and the one in front
+        if (next != _free.begin()) {
+                auto previous = std::prev(next);
+                if (previous->first + previous->second == offset) {
+                        previous->second += size;
+                        return;
+                }
+        }
+
+        _free[offset] = size;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <map>
+
+// Hands out ranges of a linear address space, e.g. one big gpu buffer. First
+// fit over a free list kept sorted by offset, neighbouring free ranges are
+// merged again on free. Doesn't touch the memory itself.
+class RangeAllocator {
+public:
+        static constexpr uint64_t INVALID_OFFSET = UINT64_MAX;
+
+        explicit RangeAllocator(uint64_t capacity = 0);
+
+        // Offset of a range of size bytes starting at a multiple of alignment
+        // (doesn't need to be a power of two), INVALID_OFFSET when full.
+        uint64_t allocate(uint64_t size, uint64_t alignment = 1);
+        // offset has to come from allocate, the size is remembered
+        void free(uint64_t offset);
+
+        // adds the space between the old and new capacity, it can only grow
+        void grow(uint64_t capacity);
+
+        uint64_t capacity() const { return _capacity; }
+        uint64_t used() const { return _used; }
+        size_t allocation_count() const { return _allocations.size(); }
+
+private:
+        struct Allocation {
+                uint64_t size;
+                // start of the free space the range was cut from, the padding
+                // in front of the aligned offset is returned with it
+                uint64_t blockStart;
+        };
+
+        void insert_free(uint64_t offset, uint64_t size);
+
+        uint64_t _capacity = 0;
+        uint64_t _used = 0;
+        // offset -> size
+        std::map<uint64_t, uint64_t> _free;
+        // aligned offset -> allocation
+        std::map<uint64_t, Allocation> _allocations;
+};
@@ -0,0 +1,101 @@
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <atomic>
+
+ThreadPool::ThreadPool(unsigned threadCount)
+{
+        threadCount = std::max(threadCount, 1u);
+        _workers.reserve(threadCount);
+        for (unsigned i = 0; i < threadCount; i++) {
+                _workers.emplace_back([this]() { worker_loop(); });
+        }
+}
+
+ThreadPool::~ThreadPool()
+{
+        {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _stopping = true;
+        }
+        _condition.notify_all();
+
+        for (std::thread& worker : _workers) {
+                worker.join();
+        }
+}
+
+ThreadPool& ThreadPool::global()
+{
+        static ThreadPool pool;
+        return pool;
+}
+
+void ThreadPool::enqueue(std::function<void()>&& job)
+{
+        {
+                std::lock_guard<std::mutex> lock(_mutex);
+                _jobs.push_back(std::move(job));
+        }
+        _condition.notify_one();
+}
+
+void ThreadPool::worker_loop()
+{
+        while (true) {
+                std::function<void()> job;
+                {
+                        std::unique_lock<std::mutex> lock(_mutex);
+                        _condition.wait(lock, [this]() { return _stopping || !_jobs.empty(); });
+                        if (_stopping && _jobs.empty()) {
+                                return;
+                        }
+                        job = std::move(_jobs.front());
+                        _jobs.pop_front();
+                }
+                job();
+        }
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& function)
+{
+        if (count == 0) {
+                return;
+        }
+
+        // Shared between the caller and the helpers. Helpers that only get to
+        // run after everything is done find no work left and just drop it,
+        // which is why the caller waits for the items instead of the helpers.
+        struct State {
+                std::function<void(size_t)> function;
+                size_t count;
+                std::atomic<size_t> next { 0 };
+                std::atomic<size_t> finished { 0 };
+                std::mutex mutex;
+                std::condition_variable done;
+        };
+        auto state = std::make_shared<State>();
+        state->function = function;
+        state->count = count;
+
+        auto work = [](State& state) {
+                size_t i;
+                while ((i = state.next.fetch_add(1)) < state.count) {
+                        state.function(i);
+                        if (state.finished.fetch_add(1) + 1 == state.count) {
+                                std::lock_guard<std::mutex> lock(state.mutex);
+                                state.done.notify_all();
+                        }
+                }
+        };
+
+        const size_t helpers = std::min<size_t>(count - 1, _workers.size());
+        for (size_t i = 0; i < helpers; i++) {
+                enqueue([state, work]() { work(*state); });
+        }
+
+        work(*state);
+
+        std::unique_lock<std::mutex> lock(state->mutex);
+        state->done.wait(lock, [&]() { return state->finished.load() == count; });
+}
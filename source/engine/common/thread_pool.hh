@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed set of worker threads shared by everything that wants to go wide
+// (asset parsing, cooking, decoding).
+class ThreadPool {
+public:
+        explicit ThreadPool(unsigned threadCount = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // the pool used by the engine, created on first use
+        static ThreadPool& global();
+
+        unsigned size() const { return static_cast<unsigned>(_workers.size()); }
+
+        template <typename F>
+        auto submit(F&& function) -> std::future<std::invoke_result_t<F>>
+        {
+                using Result = std::invoke_result_t<F>;
+                auto task = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(function));
+                std::future<Result> future = task->get_future();
+                enqueue([task]() { (*task)(); });
+                return future;
+        }
+
+        // Runs function(i) for every i in [0, count) and returns once all of
+        // them finished. The calling thread works on the items too, so this
+        // is safe to call from inside a worker.
+        void parallel_for(size_t count, const std::function<void(size_t)>& function);
+
+private:
+        void enqueue(std::function<void()>&& job);
+        void worker_loop();
+
+        std::vector<std::thread> _workers;
+        std::deque<std::function<void()>> _jobs;
+        std::mutex _mutex;
+        std::condition_variable _condition;
+        bool _stopping = false;
+};
@@ -3,9 +3,20 @@
 
 #pragma once
 
+#include <cstdlib>
+#include <iostream>
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.h>
 
+#define VK_CHECK(x)                                                            \
+    do {                                                                       \
+        VkResult err = x;                                                      \
+        if (err) {                                                             \
+            std::cout << "Detected Vulkan error: " << err << std::endl;        \
+            abort();                                                           \
+        }                                                                      \
+    } while (0)
+
 struct AllocatedBuffer {
         VkBuffer _buffer;
         VmaAllocation _allocation;
@@ -15,3 +26,11 @@ struct AllocatedImage {
         VkImage _image;
         VmaAllocation _allocation;
 };
+
+// a sampled image with every mip level, ready for a descriptor
+struct Texture {
+        AllocatedImage image;
+        VkImageView imageView;
+        VkSampler sampler;
+        uint32_t mipLevels;
+};
@@ -0,0 +1,137 @@
+#include "vfs.hh"
+#include "hash.hh"
+#include "lz4.hh"
+#include "mapped_file.hh"
+
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+Vfs& Vfs::global()
+{
+        static Vfs vfs;
+        return vfs;
+}
+
+bool Vfs::mount(const char* packPath, const char* root)
+{
+        auto mapping = std::make_shared<MappedFile>();
+        if (!mapping->open(packPath)) {
+                std::cerr << "ERROR: failed to open " << packPath << std::endl;
+                return false;
+        }
+
+        const uint8_t* base = mapping->data();
+        const size_t size = mapping->size();
+
+        pack::PackHeader header;
+        if (size < sizeof(header)) {
+                return false;
+        }
+        std::memcpy(&header, base, sizeof(header));
+        if (header.magic != pack::PACK_MAGIC || header.version != pack::PACK_VERSION) {
+                std::cerr << "ERROR: " << packPath << " is not an asset pack" << std::endl;
+                return false;
+        }
+        if (header.tocOffset > size || header.entryCount > (size - header.tocOffset) / sizeof(pack::PackEntry)
+                || header.namesOffset > size || header.namesSize > size - header.namesOffset) {
+                return false;
+        }
+
+        std::unordered_map<std::string, pack::PackEntry> entries;
+        entries.reserve(header.entryCount);
+        for (uint32_t i = 0; i < header.entryCount; i++) {
+                pack::PackEntry entry;
+                std::memcpy(&entry, base + header.tocOffset + i * sizeof(entry), sizeof(entry));
+                if (entry.offset > size || entry.size > size - entry.offset
+                        || uint64_t(entry.nameOffset) + entry.nameLength > header.namesSize) {
+                        std::cerr << "ERROR: " << packPath << " has a broken entry" << std::endl;
+                        return false;
+                }
+                const char* name = reinterpret_cast<const char*>(base + header.namesOffset + entry.nameOffset);
+                entries.emplace(std::string(name, entry.nameLength), entry);
+        }
+
+        _packData = base;
+        _packSize = size;
+        _pack = std::move(mapping);
+        _root = std::filesystem::path(root).lexically_normal().generic_string();
+        _entries = std::move(entries);
+
+        std::cout << "Mounted " << packPath << ": " << _entries.size() << " files, "
+                  << size / (1024.0 * 1024.0) << " MB" << std::endl;
+        return true;
+}
+
+const pack::PackEntry* Vfs::find(const char* path) const
+{
+        if (!_pack) {
+                return nullptr;
+        }
+
+        // the entry names are relative to the root, and may lead out of it
+        std::string name = std::filesystem::path(path).lexically_normal().lexically_relative(_root).generic_string();
+        if (name.empty()) {
+                return nullptr;
+        }
+        auto item = _entries.find(name);
+        return item == _entries.end() ? nullptr : &item->second;
+}
+
+bool Vfs::read(const char* path, VfsFile& file) const
+{
+        const pack::PackEntry* entry = find(path);
+        if (!entry) {
+                auto mapping = std::make_shared<MappedFile>();
+                if (!mapping->open(path)) {
+                        return false;
+                }
+                file.data = mapping->data();
+                file.size = mapping->size();
+                file.owner = std::move(mapping);
+                return true;
+        }
+
+        const uint8_t* data = _packData + entry->offset;
+        if (entry->compression == pack::Compression::None) {
+                file.data = data;
+                file.size = entry->size;
+                file.owner = _pack;
+                return true;
+        }
+
+        if (entry->compression != pack::Compression::LZ4) {
+                return false;
+        }
+        auto decompressed = std::make_shared<std::vector<uint8_t>>(entry->rawSize);
+        if (!lz4::decompress(data, entry->size, decompressed->data(), decompressed->size())) {
+                std::cerr << "ERROR: corrupt pack entry " << path << std::endl;
+                return false;
+        }
+        file.data = decompressed->data();
+        file.size = decompressed->size();
+        file.owner = std::move(decompressed);
+        return true;
+}
+
+bool Vfs::exists(const char* path) const
+{
+        std::error_code error;
+        return find(path) || std::filesystem::is_regular_file(path, error);
+}
+
+bool Vfs::content_hash(const char* path, uint64_t& hash) const
+{
+        if (const pack::PackEntry* entry = find(path)) {
+                hash = entry->hash;
+                return true;
+        }
+
+        VfsFile file;
+        if (!read(path, file)) {
+                return false;
+        }
+        hash = hash64(file.data, file.size);
+        return true;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "pack_file.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// written by the AssetBaker into the build directory, the working directory
+// of the engine
+constexpr const char* ASSET_PACK_PATH = "assets.pack";
+
+// The bytes of a whole file. data points into the pack mapping, into a
+// mapping of a loose file or, for compressed pack entries, into a
+// decompressed copy; owner keeps whichever it is alive.
+struct VfsFile {
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        std::shared_ptr<const void> owner;
+};
+
+// Asset file access. With a pack mounted the files in it are served from one
+// mapping of the pack, everything else (and everything without a pack) is
+// mapped from disk. Files in the pack shadow the loose ones, so the pack has
+// to be rebuilt when assets change, the BakeAssets build step does that.
+//
+// mount() has to happen before the first read, reads may come from any thread.
+class Vfs {
+public:
+        static Vfs& global();
+
+        // Paths of the pack entries are relative to root, "../models/a.obj"
+        // with root ".." finds the entry "models/a.obj", with root "." the
+        // entry "../models/a.obj".
+        bool mount(const char* packPath, const char* root);
+        bool mounted() const { return _pack != nullptr; }
+
+        bool read(const char* path, VfsFile& file) const;
+        bool exists(const char* path) const;
+        // hash64 of the file bytes, taken from the pack without reading the
+        // entry when it is in there
+        bool content_hash(const char* path, uint64_t& hash) const;
+
+private:
+        const pack::PackEntry* find(const char* path) const;
+
+        std::shared_ptr<const void> _pack;
+        const uint8_t* _packData = nullptr;
+        size_t _packSize = 0;
+        std::string _root;
+        std::unordered_map<std::string, pack::PackEntry> _entries;
+};
@@ -233,6 +233,26 @@ VkImageViewCreateInfo vkinit::create_image_view_info(VkFormat format, VkImage im
         return info;
 }
 
+VkSamplerCreateInfo vkinit::sampler_create_info(VkFilter filters, VkSamplerAddressMode samplerAddressMode)
+{
+        VkSamplerCreateInfo info {};
+        info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        info.pNext = nullptr;
+
+        info.magFilter = filters;
+        info.minFilter = filters;
+        info.addressModeU = samplerAddressMode;
+        info.addressModeV = samplerAddressMode;
+        info.addressModeW = samplerAddressMode;
+
+        // every mip the view has, blended between levels
+        info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+        info.minLod = 0.0f;
+        info.maxLod = VK_LOD_CLAMP_NONE;
+
+        return info;
+}
+
 VkPipelineDepthStencilStateCreateInfo vkinit::depth_stencil_create_info(bool bDepthTest, bool bDepthWrite, VkCompareOp compareOp)
 {
         VkPipelineDepthStencilStateCreateInfo info = {};
@@ -277,6 +297,21 @@ VkWriteDescriptorSet vkinit::write_descriptor_buffer(VkDescriptorType type, VkDe
         return write;
 }
 
+VkWriteDescriptorSet vkinit::write_descriptor_image(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorImageInfo* imageInfo, uint32_t binding)
+{
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.pNext = nullptr;
+
+        write.dstBinding = binding;
+        write.dstSet = dstSet;
+        write.descriptorCount = 1;
+        write.descriptorType = type;
+        write.pImageInfo = imageInfo;
+
+        return write;
+}
+
 VkFenceCreateInfo vkinit::fence_create_info(VkFenceCreateFlags flags)
 {
         VkFenceCreateInfo fenceInfo {};
@@ -18,9 +18,11 @@ VkPipelineColorBlendAttachmentState color_blend_attachment_state();
 VkPipelineLayoutCreateInfo pipeline_layout_create_info();
 VkImageCreateInfo create_image_info(VkFormat format, VkImageUsageFlags flags, VkExtent3D extent, VkSampleCountFlagBits sampleCount);
 VkImageViewCreateInfo create_image_view_info(VkFormat format, VkImage image, VkImageAspectFlags flags);
+VkSamplerCreateInfo sampler_create_info(VkFilter filters, VkSamplerAddressMode samplerAddressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT);
 VkPipelineDepthStencilStateCreateInfo depth_stencil_create_info(bool bDepthTest, bool bDepthWrite, VkCompareOp compareOp);
 VkDescriptorSetLayoutBinding descriptorset_layout_binding(VkDescriptorType type, VkShaderStageFlags stageFlags, uint32_t binding);
 VkWriteDescriptorSet write_descriptor_buffer(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorBufferInfo* bufferInfo, uint32_t binding);
+VkWriteDescriptorSet write_descriptor_image(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorImageInfo* imageInfo, uint32_t binding);
 VkFenceCreateInfo fence_create_info(VkFenceCreateFlags flags);
 VkCommandBufferBeginInfo command_buffer_begin_info(VkCommandBufferUsageFlags usage);
 VkSubmitInfo sumbit_info(VkCommandBuffer* cmd);
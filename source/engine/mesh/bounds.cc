@@ -0,0 +1,190 @@
+#include "bounds.hh"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BOUNDS_SSE 1
+#endif
+
+namespace {
+
+inline glm::vec3 position_at(const float* positions, size_t stride, size_t i)
+{
+        const float* p = reinterpret_cast<const float*>(reinterpret_cast<const char*>(positions) + i * stride);
+        return { p[0], p[1], p[2] };
+}
+
+}
+
+void compute_aabb(const float* positions, size_t count, size_t stride, glm::vec3& min, glm::vec3& max)
+{
+        if (count == 0) {
+                min = max = glm::vec3 { 0.0f };
+                return;
+        }
+
+        size_t i = 0;
+        min = max = position_at(positions, stride, 0);
+
+#ifdef BOUNDS_SSE
+        // every load grabs one float past the position, which is only safe
+        // when the stride covers it and another position follows, the last
+        // one may end the buffer and goes through the scalar loop. Two
+        // accumulators hide the latency.
+        if (stride >= 4 * sizeof(float) && count >= 2) {
+                const char* base = reinterpret_cast<const char*>(positions);
+                __m128 min0 = _mm_loadu_ps(positions);
+                __m128 max0 = min0;
+                __m128 min1 = min0;
+                __m128 max1 = min0;
+
+                for (; i + 2 < count; i += 2) {
+                        __m128 p0 = _mm_loadu_ps(reinterpret_cast<const float*>(base + i * stride));
+                        __m128 p1 = _mm_loadu_ps(reinterpret_cast<const float*>(base + (i + 1) * stride));
+                        min0 = _mm_min_ps(min0, p0);
+                        max0 = _mm_max_ps(max0, p0);
+                        min1 = _mm_min_ps(min1, p1);
+                        max1 = _mm_max_ps(max1, p1);
+                }
+
+                alignas(16) float lo[4];
+                alignas(16) float hi[4];
+                _mm_store_ps(lo, _mm_min_ps(min0, min1));
+                _mm_store_ps(hi, _mm_max_ps(max0, max1));
+                // the fourth lane is whatever followed the position, ignored
+                min = { lo[0], lo[1], lo[2] };
+                max = { hi[0], hi[1], hi[2] };
+        }
+#endif
+
+        for (; i < count; i++) {
+                glm::vec3 p = position_at(positions, stride, i);
+                min = glm::min(min, p);
+                max = glm::max(max, p);
+        }
+}
+
+void compute_sphere(const float* positions, size_t count, size_t stride, glm::vec3& center, float& radius)
+{
+        if (count == 0) {
+                center = glm::vec3 { 0.0f };
+                radius = 0.0f;
+                return;
+        }
+
+        // start from a far apart pair: the point furthest from the first one,
+        // and the point furthest from that
+        glm::vec3 a = position_at(positions, stride, 0);
+        glm::vec3 b = a;
+        float distance = 0.0f;
+        for (size_t i = 0; i < count; i++) {
+                glm::vec3 p = position_at(positions, stride, i);
+                float d = glm::dot(p - a, p - a);
+                if (d > distance) {
+                        distance = d;
+                        b = p;
+                }
+        }
+        glm::vec3 c = b;
+        distance = 0.0f;
+        for (size_t i = 0; i < count; i++) {
+                glm::vec3 p = position_at(positions, stride, i);
+                float d = glm::dot(p - b, p - b);
+                if (d > distance) {
+                        distance = d;
+                        c = p;
+                }
+        }
+
+        center = (b + c) * 0.5f;
+        radius = std::sqrt(distance) * 0.5f;
+
+        // grow it to fit the rest
+        for (size_t i = 0; i < count; i++) {
+                glm::vec3 p = position_at(positions, stride, i);
+                float d = glm::length(p - center);
+                if (d > radius) {
+                        float grown = (radius + d) * 0.5f;
+                        center += (p - center) * ((grown - radius) / d);
+                        radius = grown;
+                }
+        }
+}
+
+Bounds compute_bounds(const float* positions, size_t count, size_t stride)
+{
+        Bounds bounds {};
+        compute_aabb(positions, count, stride, bounds.min, bounds.max);
+        compute_sphere(positions, count, stride, bounds.center, bounds.radius);
+
+        // for boxy meshes the sphere around the box can still be the better one
+        glm::vec3 boxCenter = (bounds.min + bounds.max) * 0.5f;
+        float boxRadius = glm::length(bounds.max - boxCenter);
+        if (boxRadius < bounds.radius) {
+                bounds.center = boxCenter;
+                bounds.radius = boxRadius;
+        }
+
+        return bounds;
+}
+
+Bounds transform_bounds(const Bounds& bounds, const glm::mat4& transform)
+{
+        Bounds result {};
+
+        // Arvo: every output axis starts at the translation and picks, per
+        // matrix element, whichever of min/max makes it smaller or larger
+        result.min = result.max = glm::vec3(transform[3]);
+        for (int column = 0; column < 3; column++) {
+                for (int row = 0; row < 3; row++) {
+                        float a = transform[column][row] * bounds.min[column];
+                        float b = transform[column][row] * bounds.max[column];
+                        result.min[row] += std::min(a, b);
+                        result.max[row] += std::max(a, b);
+                }
+        }
+
+        result.center = glm::vec3(transform * glm::vec4(bounds.center, 1.0f));
+        float scale = std::max({ glm::length(glm::vec3(transform[0])),
+                glm::length(glm::vec3(transform[1])),
+                glm::length(glm::vec3(transform[2])) });
+        result.radius = bounds.radius * scale;
+
+        return result;
+}
+
+Frustum extract_frustum(const glm::mat4& viewProj)
+{
+        glm::vec4 rows[4];
+        for (int r = 0; r < 4; r++) {
+                rows[r] = glm::vec4(viewProj[0][r], viewProj[1][r], viewProj[2][r], viewProj[3][r]);
+        }
+
+        Frustum frustum {
+                rows[3] + rows[0], // left
+                rows[3] - rows[0], // right
+                rows[3] + rows[1], // bottom
+                rows[3] - rows[1], // top
+                rows[2], // near, the projections map depth to 0..1 like vulkan
+                rows[3] - rows[2], // far
+        };
+        for (glm::vec4& plane : frustum.planes) {
+                float length = glm::length(glm::vec3(plane));
+                if (length > 0.0f) {
+                        plane = plane / length;
+                }
+        }
+        return frustum;
+}
+
+bool sphere_in_frustum(const Frustum& frustum, const glm::vec3& center, float radius)
+{
+        for (const glm::vec4& plane : frustum.planes) {
+                if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                        return false;
+                }
+        }
+        return true;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+
+struct Bounds {
+        glm::vec3 min;
+        glm::vec3 max;
+        // bounding sphere, tighter than the one around the box
+        glm::vec3 center;
+        float radius;
+};
+
+// Positions are read as three floats every stride bytes, so they can be
+// pulled straight out of an interleaved vertex array.
+
+// min/max of all positions, SSE when the stride leaves room for 16 byte loads
+void compute_aabb(const float* positions, size_t count, size_t stride, glm::vec3& min, glm::vec3& max);
+
+// Ritter's bounding sphere, within a few percent of the minimal one
+void compute_sphere(const float* positions, size_t count, size_t stride, glm::vec3& center, float& radius);
+
+Bounds compute_bounds(const float* positions, size_t count, size_t stride);
+
+// Bounds after transform: the box with Arvo's method (exact box around the
+// transformed box), the sphere scaled by the largest axis scale.
+Bounds transform_bounds(const Bounds& bounds, const glm::mat4& transform);
+
+// Frustum planes (Gribb/Hartmann) pointing inwards, normalized so the plane
+// distance can be compared against a sphere radius. Extracted from a
+// model-view-projection matrix the planes are in model space.
+struct Frustum {
+        glm::vec4 planes[6];
+};
+
+// viewProj has to map depth to 0..1, see GLM_FORCE_DEPTH_ZERO_TO_ONE
+Frustum extract_frustum(const glm::mat4& viewProj);
+bool sphere_in_frustum(const Frustum& frustum, const glm::vec3& center, float radius);
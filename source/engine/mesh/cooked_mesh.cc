@@ -0,0 +1,269 @@
+#include "cooked_mesh.hh"
+#include "mapped_file.hh"
+#include "mesh.hh"
+#include "mesh_cache.hh"
+#include "vfs.hh"
+
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+bool Mesh::load(const char* filename, VertexFormat format)
+{
+        _format = format;
+
+        // glb buffers are read in place, cooking them wouldn't save much
+        if (std::filesystem::path(filename).extension() == ".glb") {
+                auto start = std::chrono::high_resolution_clock::now();
+                if (!load_from_glb(filename)) {
+                        return false;
+                }
+                std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+                _sourceLoadMs = elapsed.count();
+                std::cout << filename << ": glb load took " << _sourceLoadMs << "ms" << std::endl;
+                return true;
+        }
+
+        // keyed by the source contents, a hit is always up to date. Hashing
+        // the source is part of what a hit costs, so the clock starts here
+        auto lookupStart = std::chrono::high_resolution_clock::now();
+        MeshCache& cache = MeshCache::global();
+        const std::string cookedPath = cache.entry_path(filename, format);
+        if (cookedPath.empty()) {
+                std::cerr << "ERROR: failed to read " << filename << std::endl;
+                return false;
+        }
+
+        std::error_code error;
+        if (Vfs::global().exists(cookedPath.c_str())) {
+                if (load_from_cooked(cookedPath.c_str()) && _format == format) {
+                        std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - lookupStart;
+                        cache.record_hit(_sourceLoadMs - elapsed.count());
+                        std::cout << filename << ": hashing and cooked load took " << elapsed.count()
+                                  << "ms, processing the obj took " << _sourceLoadMs << "ms" << std::endl;
+                        return true;
+                }
+                std::cerr << "Cooked mesh " << cookedPath << " is invalid, regenerating it." << std::endl;
+                _format = format;
+        }
+        cache.record_miss();
+
+        // everything the cache saves goes into _sourceLoadMs
+        auto start = std::chrono::high_resolution_clock::now();
+        if (!load_from_obj(filename)) {
+                return false;
+        }
+        if (_format == VertexFormat::Packed) {
+                pack_vertices();
+        }
+        build_lods();
+        build_meshlets();
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        _sourceLoadMs = elapsed.count();
+        std::cout << filename << ": obj load and processing took " << _sourceLoadMs << "ms" << std::endl;
+
+        std::filesystem::create_directories(std::filesystem::path(cookedPath).parent_path(), error);
+        if (!save_cooked(cookedPath.c_str())) {
+                std::cerr << "Failed to write cooked mesh " << cookedPath << std::endl;
+        }
+        return true;
+}
+
+bool Mesh::peek_bounds(const char* filename, VertexFormat format, Bounds& bounds)
+{
+        if (std::filesystem::path(filename).extension() == ".glb") {
+                // only maps the file, the vertices are read when they are written
+                Mesh mesh;
+                if (!mesh.load_from_glb(filename)) {
+                        return false;
+                }
+                bounds = mesh._bounds;
+                return true;
+        }
+
+        const std::string cookedPath = MeshCache::global().entry_path(filename, format);
+        VfsFile file;
+        cooked::MeshHeader header;
+        if (cookedPath.empty() || !Vfs::global().exists(cookedPath.c_str()) || !Vfs::global().read(cookedPath.c_str(), file)
+                || file.size < sizeof(header)) {
+                return false;
+        }
+        std::memcpy(&header, file.data, sizeof(header));
+        if (header.magic != cooked::MESH_MAGIC || header.version != cooked::MESH_VERSION) {
+                return false;
+        }
+        bounds.min = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+        bounds.max = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+        bounds.center = { header.center[0], header.center[1], header.center[2] };
+        bounds.radius = header.radius;
+        return true;
+}
+
+bool Mesh::load_from_cooked(const char* filename)
+{
+        VfsFile file;
+        if (!Vfs::global().read(filename, file)) {
+                return false;
+        }
+
+        const uint8_t* base = file.data;
+        const size_t size = file.size;
+
+        cooked::MeshHeader header;
+        if (size < sizeof(header)) {
+                return false;
+        }
+        std::memcpy(&header, base, sizeof(header));
+        if (header.magic != cooked::MESH_MAGIC || header.version != cooked::MESH_VERSION) {
+                return false;
+        }
+        if (sizeof(header) + header.sectionCount * sizeof(cooked::MeshSection) > size) {
+                return false;
+        }
+
+        if (header.vertexFormat > static_cast<uint32_t>(VertexFormat::Packed)) {
+                return false;
+        }
+        const VertexFormat format = static_cast<VertexFormat>(header.vertexFormat);
+
+        const void* vertices = nullptr;
+        const void* indices = nullptr;
+        const Meshlet* meshlets = nullptr;
+        const MeshLod* lods = nullptr;
+        size_t vertexCount = 0, indexCount = 0, meshletCount = 0, lodCount = 0;
+        uint32_t indexStride = 0;
+
+        for (uint32_t i = 0; i < header.sectionCount; i++) {
+                cooked::MeshSection section;
+                std::memcpy(&section, base + sizeof(header) + i * sizeof(section), sizeof(section));
+                // divided so a corrupt count can't overflow past the check
+                if (section.offset > size || (section.stride > 0 && section.count > (size - section.offset) / section.stride)) {
+                        return false;
+                }
+
+                switch (section.type) {
+                case cooked::SectionType::Vertices:
+                        if (section.stride != (format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex))) {
+                                return false;
+                        }
+                        vertices = base + section.offset;
+                        vertexCount = section.count;
+                        break;
+                case cooked::SectionType::Indices:
+                        indices = base + section.offset;
+                        indexCount = section.count;
+                        indexStride = section.stride;
+                        break;
+                case cooked::SectionType::Meshlets:
+                        if (section.stride != sizeof(Meshlet)) {
+                                return false;
+                        }
+                        meshlets = reinterpret_cast<const Meshlet*>(base + section.offset);
+                        meshletCount = section.count;
+                        break;
+                case cooked::SectionType::Lods:
+                        if (section.stride != sizeof(MeshLod)) {
+                                return false;
+                        }
+                        lods = reinterpret_cast<const MeshLod*>(base + section.offset);
+                        lodCount = section.count;
+                        break;
+                default:
+                        // unknown sections are skipped so older builds can read newer files
+                        break;
+                }
+        }
+
+        if (!vertices || !indices) {
+                return false;
+        }
+        // the index size follows from the vertex count, a mismatch means the
+        // file was written by something else
+        if (indexStride != (vertexCount <= UINT16_MAX ? sizeof(uint16_t) : sizeof(uint32_t))) {
+                return false;
+        }
+
+        _vertices.clear();
+        _indices.clear();
+        _packedVertices.clear();
+        _primitives.clear();
+        _meshlets.assign(meshlets, meshlets + meshletCount);
+        _lods.assign(lods, lods + lodCount);
+        _format = format;
+        _mapping = std::move(file.owner);
+        _mappedVertices = vertices;
+        _mappedVertexCount = vertexCount;
+        _mappedIndices = indices;
+        _mappedIndexCount = indexCount;
+
+        _sourceLoadMs = header.sourceLoadMs;
+        _bounds.min = { header.boundsMin[0], header.boundsMin[1], header.boundsMin[2] };
+        _bounds.max = { header.boundsMax[0], header.boundsMax[1], header.boundsMax[2] };
+        _bounds.center = { header.center[0], header.center[1], header.center[2] };
+        _bounds.radius = header.radius;
+
+        return true;
+}
+
+bool Mesh::save_cooked(const char* filename) const
+{
+        cooked::MeshHeader header {};
+        header.magic = cooked::MESH_MAGIC;
+        header.version = cooked::MESH_VERSION;
+        header.sectionCount = 4;
+        header.sourceLoadMs = _sourceLoadMs;
+        header.vertexFormat = static_cast<uint32_t>(_format);
+        for (int i = 0; i < 3; i++) {
+                header.boundsMin[i] = _bounds.min[i];
+                header.boundsMax[i] = _bounds.max[i];
+                header.center[i] = _bounds.center[i];
+        }
+        header.radius = _bounds.radius;
+
+        cooked::MeshSection sections[4];
+        uint64_t offset = cooked::align(sizeof(header) + sizeof(sections));
+
+        sections[0].type = cooked::SectionType::Vertices;
+        sections[0].stride = static_cast<uint32_t>(vertex_stride());
+        sections[0].offset = offset;
+        sections[0].count = vertex_count();
+        offset = cooked::align(offset + sections[0].count * sections[0].stride);
+
+        sections[1].type = cooked::SectionType::Indices;
+        sections[1].stride = static_cast<uint32_t>(index_size());
+        sections[1].offset = offset;
+        sections[1].count = index_count();
+        offset = cooked::align(offset + sections[1].count * sections[1].stride);
+
+        sections[2].type = cooked::SectionType::Meshlets;
+        sections[2].stride = sizeof(Meshlet);
+        sections[2].offset = offset;
+        sections[2].count = _meshlets.size();
+        offset = cooked::align(offset + sections[2].count * sections[2].stride);
+
+        sections[3].type = cooked::SectionType::Lods;
+        sections[3].stride = sizeof(MeshLod);
+        sections[3].offset = offset;
+        sections[3].count = _lods.size();
+        offset += sections[3].count * sections[3].stride;
+
+        // build the whole file in memory, it is written in one go
+        std::vector<char> blob(offset, 0);
+        std::memcpy(blob.data(), &header, sizeof(header));
+        std::memcpy(blob.data() + sizeof(header), sections, sizeof(sections));
+        write_vertices(blob.data() + sections[0].offset);
+        write_indices(blob.data() + sections[1].offset);
+        if (!_meshlets.empty()) {
+                std::memcpy(blob.data() + sections[2].offset, _meshlets.data(), _meshlets.size() * sizeof(Meshlet));
+        }
+        if (!_lods.empty()) {
+                std::memcpy(blob.data() + sections[3].offset, _lods.data(), _lods.size() * sizeof(MeshLod));
+        }
+
+        return write_file_atomically(filename, [&](std::ostream& file) {
+                file.write(blob.data(), blob.size());
+                return file.good();
+        });
+}
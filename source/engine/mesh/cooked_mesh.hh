@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+// On disk layout of a cooked mesh:
+//      CookedMeshHeader
+//      CookedMeshSection[sectionCount]
+//      blobs, every one aligned to COOKED_MESH_ALIGNMENT
+// The blobs are stored exactly like the gpu buffers want them, so loading is
+// a mmap followed by a memcpy into the staging buffer.
+namespace cooked {
+
+constexpr uint32_t MESH_MAGIC = 0x4853454d; // "MESH"
+constexpr uint32_t MESH_VERSION = 8;
+constexpr uint64_t MESH_ALIGNMENT = 16;
+
+enum class SectionType : uint32_t {
+        Vertices = 0,
+        Indices = 1,
+        Meshlets = 2,
+        Lods = 3,
+};
+
+struct MeshSection {
+        SectionType type;
+        // size of one element, for indices this is the index size
+        uint32_t stride;
+        uint64_t offset;
+        uint64_t count;
+};
+
+struct MeshHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t sectionCount;
+        float sourceLoadMs;
+        // VertexFormat of the vertex blob
+        uint32_t vertexFormat;
+        uint32_t reserved;
+
+        float boundsMin[3];
+        float boundsMax[3];
+        float center[3];
+        float radius;
+};
+
+constexpr uint64_t align(uint64_t offset)
+{
+        return (offset + MESH_ALIGNMENT - 1) & ~(MESH_ALIGNMENT - 1);
+}
+
+}
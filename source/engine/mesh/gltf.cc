@@ -0,0 +1,638 @@
+#include "gltf.hh"
+#include "json.hh"
+#include "obj_parser.hh"
+#include "vfs.hh"
+
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+constexpr uint32_t GLB_MAGIC = 0x46546C67; // "glTF"
+constexpr uint32_t GLB_VERSION = 2;
+constexpr uint32_t CHUNK_JSON = 0x4E4F534A;
+constexpr uint32_t CHUNK_BIN = 0x004E4942;
+
+constexpr uint32_t MODE_TRIANGLES = 4;
+
+enum ComponentType : uint32_t {
+        Byte = 5120,
+        UnsignedByte = 5121,
+        Short = 5122,
+        UnsignedShort = 5123,
+        UnsignedInt = 5125,
+        Float = 5126,
+};
+
+size_t component_size(uint32_t type)
+{
+        switch (type) {
+        case Byte:
+        case UnsignedByte:
+                return 1;
+        case Short:
+        case UnsignedShort:
+                return 2;
+        case UnsignedInt:
+        case Float:
+                return 4;
+        default:
+                return 0;
+        }
+}
+
+uint32_t component_count(const std::string& type)
+{
+        if (type == "SCALAR") {
+                return 1;
+        }
+        if (type == "VEC2") {
+                return 2;
+        }
+        if (type == "VEC3") {
+                return 3;
+        }
+        if (type == "VEC4") {
+                return 4;
+        }
+        // matrices aren't vertex attributes
+        return 0;
+}
+
+float read_component(const uint8_t* data, uint32_t type, bool normalized)
+{
+        switch (type) {
+        case Byte: {
+                int8_t value = static_cast<int8_t>(*data);
+                return normalized ? std::max(value / 127.0f, -1.0f) : value;
+        }
+        case UnsignedByte:
+                return normalized ? *data / 255.0f : *data;
+        case Short: {
+                int16_t value;
+                std::memcpy(&value, data, sizeof(value));
+                return normalized ? std::max(value / 32767.0f, -1.0f) : value;
+        }
+        case UnsignedShort: {
+                uint16_t value;
+                std::memcpy(&value, data, sizeof(value));
+                return normalized ? value / 65535.0f : value;
+        }
+        case UnsignedInt: {
+                uint32_t value;
+                std::memcpy(&value, data, sizeof(value));
+                return static_cast<float>(value);
+        }
+        default: {
+                float value;
+                std::memcpy(&value, data, sizeof(value));
+                return value;
+        }
+        }
+}
+
+glm::vec3 read_vec3(const AccessorView& view, size_t i)
+{
+        const uint8_t* element = view.data + i * view.stride;
+        glm::vec3 value { 0.0f };
+        // the common case, plain floats
+        if (view.componentType == Float && view.components >= 3) {
+                std::memcpy(&value, element, sizeof(value));
+                return value;
+        }
+
+        const size_t size = component_size(view.componentType);
+        for (uint32_t c = 0; c < std::min(view.components, 3u); c++) {
+                value[c] = read_component(element + c * size, view.componentType, view.normalized);
+        }
+        return value;
+}
+
+struct Document {
+        std::shared_ptr<const void> mapping;
+        json::Value root;
+        const uint8_t* bin = nullptr;
+        size_t binSize = 0;
+};
+
+const json::Value& member(const json::Value& object, const char* key)
+{
+        static const json::Value null {};
+        const json::Value* value = object.find(key);
+        return value ? *value : null;
+}
+
+// array element by a json number, null for indices that aren't valid
+const json::Value& element(const json::Value& array, double index)
+{
+        return index >= 0.0 && index < array.size() ? array[static_cast<size_t>(index)] : array[array.size()];
+}
+
+// byte offsets, lengths and counts, out of range values end up failing the bounds checks
+size_t size_member(const json::Value& object, const char* key, size_t fallback = 0)
+{
+        const double value = object.number(key, static_cast<double>(fallback));
+        if (value < 0.0) {
+                return SIZE_MAX / 2;
+        }
+        return static_cast<size_t>(std::min(value, static_cast<double>(SIZE_MAX / 2)));
+}
+
+bool open(const char* filename, Document& document)
+{
+        VfsFile file;
+        if (!Vfs::global().read(filename, file)) {
+                std::cerr << "ERROR: failed to open " << filename << std::endl;
+                return false;
+        }
+
+        const uint8_t* base = file.data;
+        uint32_t header[3];
+        if (file.size < sizeof(header)) {
+                return false;
+        }
+        std::memcpy(header, base, sizeof(header));
+        if (header[0] != GLB_MAGIC || header[1] != GLB_VERSION || header[2] > file.size) {
+                std::cerr << "ERROR: " << filename << " is not a glTF 2.0 binary" << std::endl;
+                return false;
+        }
+
+        // the chunks follow the header, json first, then the optional buffer
+        const size_t length = header[2];
+        bool parsed = false;
+        size_t offset = sizeof(header);
+        while (offset + 8 <= length) {
+                uint32_t chunk[2];
+                std::memcpy(chunk, base + offset, sizeof(chunk));
+                const uint8_t* data = base + offset + sizeof(chunk);
+                if (chunk[0] > length - offset - sizeof(chunk)) {
+                        break;
+                }
+
+                if (chunk[1] == CHUNK_JSON && !parsed) {
+                        std::string error;
+                        if (!json::parse(reinterpret_cast<const char*>(data), chunk[0], document.root, &error)) {
+                                std::cerr << "ERROR: " << filename << ": " << error << std::endl;
+                                return false;
+                        }
+                        parsed = true;
+                } else if (chunk[1] == CHUNK_BIN && !document.bin) {
+                        document.bin = data;
+                        document.binSize = chunk[0];
+                }
+                // chunks are padded to 4 bytes
+                offset += sizeof(chunk) + ((static_cast<size_t>(chunk[0]) + 3) & ~size_t(3));
+        }
+        if (!parsed) {
+                std::cerr << "ERROR: " << filename << " has no json chunk" << std::endl;
+                return false;
+        }
+
+        document.mapping = std::move(file.owner);
+        return true;
+}
+
+// Resolves an accessor into a view of the binary chunk, fails for accessors
+// reaching outside of it or using things the loader doesn't support.
+bool read_accessor(const Document& document, double index, AccessorView& view, size_t& count, const json::Value** out = nullptr)
+{
+        const json::Value& accessor = element(member(document.root, "accessors"), index);
+        if (!accessor.is_object()) {
+                return false;
+        }
+        // accessors without a buffer view are all zeros, sparse ones patch
+        // the view, neither shows up in exported meshes
+        if (!accessor.find("bufferView") || accessor.find("sparse")) {
+                std::cerr << "ERROR: glTF accessors without a buffer view or sparse ones are not supported" << std::endl;
+                return false;
+        }
+
+        const json::Value& bufferView = element(member(document.root, "bufferViews"), accessor.number("bufferView", -1));
+        if (!bufferView.is_object() || bufferView.number("buffer", -1) != 0) {
+                return false;
+        }
+        // only the embedded buffer is mapped
+        const json::Value& buffer = member(document.root, "buffers")[0];
+        if (buffer.find("uri") || !document.bin) {
+                std::cerr << "ERROR: glTF buffers outside the glb are not supported" << std::endl;
+                return false;
+        }
+
+        view.componentType = static_cast<uint32_t>(accessor.number("componentType"));
+        view.components = component_count(member(accessor, "type").as_string());
+        view.normalized = member(accessor, "normalized").as_bool();
+        const size_t elementSize = component_size(view.componentType) * view.components;
+        if (elementSize == 0) {
+                return false;
+        }
+
+        const size_t viewOffset = size_member(bufferView, "byteOffset");
+        const size_t viewLength = size_member(bufferView, "byteLength");
+        const size_t offset = size_member(accessor, "byteOffset");
+        view.stride = size_member(bufferView, "byteStride", elementSize);
+        count = size_member(accessor, "count");
+
+        if (viewOffset > document.binSize || viewLength > document.binSize - viewOffset || view.stride < elementSize) {
+                return false;
+        }
+        // written so nothing overflows for made up counts
+        if (count > 0
+                && (offset > viewLength || viewLength - offset < elementSize
+                        || count - 1 > (viewLength - offset - elementSize) / view.stride)) {
+                return false;
+        }
+
+        view.data = document.bin + viewOffset + offset;
+        if (out) {
+                *out = &accessor;
+        }
+        return true;
+}
+
+// An optional attribute has to have one element per vertex.
+bool read_attribute(const Document& document, const json::Value& attributes, const char* name, size_t vertexCount, AccessorView& view)
+{
+        const json::Value* index = attributes.find(name);
+        if (!index) {
+                return true;
+        }
+        size_t count;
+        return read_accessor(document, index->as_number(-1), view, count) && count == vertexCount;
+}
+
+bool read_mesh(const Document& document, size_t meshIndex, Mesh& mesh)
+{
+        const json::Value& primitives = member(member(document.root, "meshes")[meshIndex], "primitives");
+        if (!primitives.is_array()) {
+                return false;
+        }
+
+        std::vector<MeshPrimitive> result;
+        size_t vertexCount = 0, indexCount = 0;
+        glm::vec3 min { FLT_MAX }, max { -FLT_MAX };
+        // POSITION accessors must have min/max, files that skip them get
+        // their positions read once more
+        bool haveBounds = true;
+
+        for (size_t p = 0; p < primitives.size(); p++) {
+                const json::Value& object = primitives[p];
+                const json::Value& attributes = member(object, "attributes");
+                if (object.number("mode", MODE_TRIANGLES) != MODE_TRIANGLES || !attributes.find("POSITION")) {
+                        std::cerr << "WARN: skipping a glTF primitive that is no triangle list" << std::endl;
+                        continue;
+                }
+
+                MeshPrimitive primitive;
+                const json::Value* positions = nullptr;
+                if (!read_accessor(document, member(attributes, "POSITION").as_number(-1), primitive.positions, primitive.vertexCount, &positions)
+                        || primitive.positions.components != 3) {
+                        return false;
+                }
+                if (primitive.vertexCount == 0) {
+                        continue;
+                }
+                if (!read_attribute(document, attributes, "NORMAL", primitive.vertexCount, primitive.normals)
+                        || !read_attribute(document, attributes, "COLOR_0", primitive.vertexCount, primitive.colors)) {
+                        return false;
+                }
+
+                if (const json::Value* indices = object.find("indices")) {
+                        if (!read_accessor(document, indices->as_number(-1), primitive.indices, primitive.indexCount)
+                                || primitive.indices.components != 1 || primitive.indices.componentType == Float) {
+                                return false;
+                        }
+                } else {
+                        primitive.indexCount = primitive.vertexCount;
+                }
+
+                const json::Value& accessorMin = member(*positions, "min");
+                const json::Value& accessorMax = member(*positions, "max");
+                if (accessorMin.size() == 3 && accessorMax.size() == 3 && !primitive.positions.normalized) {
+                        for (int c = 0; c < 3; c++) {
+                                min[c] = std::min(min[c], static_cast<float>(accessorMin[c].as_number()));
+                                max[c] = std::max(max[c], static_cast<float>(accessorMax[c].as_number()));
+                        }
+                } else {
+                        haveBounds = false;
+                }
+
+                vertexCount += primitive.vertexCount;
+                indexCount += primitive.indexCount;
+                result.push_back(primitive);
+        }
+        if (result.empty() || vertexCount == 0) {
+                return false;
+        }
+
+        // whatever was loaded before is replaced
+        mesh._vertices.clear();
+        mesh._indices.clear();
+        mesh._packedVertices.clear();
+        mesh._meshlets.clear();
+        mesh._lods.clear();
+        mesh._mapping = document.mapping;
+        mesh._mappedVertices = nullptr;
+        mesh._mappedIndices = nullptr;
+        mesh._mappedVertexCount = vertexCount;
+        mesh._mappedIndexCount = indexCount;
+        mesh._primitives = std::move(result);
+
+        const AccessorView& firstPositions = mesh._primitives[0].positions;
+        if (mesh._primitives.size() == 1 && firstPositions.componentType == Float) {
+                // the float positions can be read in place, that also gets the tighter sphere
+                mesh._bounds = compute_bounds(reinterpret_cast<const float*>(firstPositions.data), vertexCount, firstPositions.stride);
+                return true;
+        }
+
+        if (!haveBounds) {
+                for (const MeshPrimitive& primitive : mesh._primitives) {
+                        for (size_t i = 0; i < primitive.vertexCount; i++) {
+                                glm::vec3 position = read_vec3(primitive.positions, i);
+                                min = glm::min(min, position);
+                                max = glm::max(max, position);
+                        }
+                }
+        }
+        mesh._bounds.min = min;
+        mesh._bounds.max = max;
+        mesh._bounds.center = (min + max) * 0.5f;
+        mesh._bounds.radius = glm::length(max - min) * 0.5f;
+        return true;
+}
+
+}
+
+Vertex MeshPrimitive::vertex(size_t i) const
+{
+        Vertex vertex;
+        vertex.position = read_vec3(positions, i);
+        vertex.normals = normals.valid() ? read_vec3(normals, i) : glm::vec3 { 0.0f };
+        // same as the obj loader, the normal doubles as color when there is none
+        vertex.color = colors.valid() ? read_vec3(colors, i) : vertex.normals;
+        return vertex;
+}
+
+uint32_t MeshPrimitive::index(size_t i) const
+{
+        if (!indices.valid()) {
+                return static_cast<uint32_t>(i);
+        }
+
+        const uint8_t* element = indices.data + i * indices.stride;
+        switch (indices.componentType) {
+        case UnsignedByte:
+                return *element;
+        case UnsignedShort: {
+                uint16_t index;
+                std::memcpy(&index, element, sizeof(index));
+                return index;
+        }
+        default: {
+                uint32_t index;
+                std::memcpy(&index, element, sizeof(index));
+                return index;
+        }
+        }
+}
+
+bool Mesh::load_from_glb(const char* filename, size_t meshIndex)
+{
+        Document document;
+        if (!open(filename, document)) {
+                return false;
+        }
+        if (!read_mesh(document, meshIndex, *this)) {
+                std::cerr << "ERROR: " << filename << " has no usable mesh " << meshIndex << std::endl;
+                return false;
+        }
+        return true;
+}
+
+void Mesh::write_primitive_vertices(void* attributes, void* positions) const
+{
+        const glm::vec3 scale = packing_scale(_bounds);
+        const size_t positionSize = position_stride();
+        const size_t attributeSize = attribute_stride();
+        // where the attribute stream starts inside a whole vertex
+        const size_t attributeStart = _splitPositions ? positionSize : 0;
+
+        uint8_t* attributeOut = static_cast<uint8_t*>(attributes);
+        uint8_t* positionOut = static_cast<uint8_t*>(positions);
+        for (const MeshPrimitive& primitive : _primitives) {
+                for (size_t i = 0; i < primitive.vertexCount; i++) {
+                        Vertex vertex = primitive.vertex(i);
+                        PackedVertex packed;
+                        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&vertex);
+                        if (_format == VertexFormat::Packed) {
+                                packed = pack_vertex(vertex, _bounds, scale);
+                                bytes = reinterpret_cast<const uint8_t*>(&packed);
+                        }
+
+                        if (attributeOut) {
+                                std::memcpy(attributeOut, bytes + attributeStart, attributeSize);
+                                attributeOut += attributeSize;
+                        }
+                        if (positionOut) {
+                                std::memcpy(positionOut, bytes, positionSize);
+                                positionOut += positionSize;
+                        }
+                }
+        }
+}
+
+void Mesh::write_primitive_indices(void* dst) const
+{
+        const bool narrow = index_type() == VK_INDEX_TYPE_UINT16;
+        uint16_t* indices16 = static_cast<uint16_t*>(dst);
+        uint32_t* indices32 = static_cast<uint32_t*>(dst);
+
+        // the primitives share one vertex range, so their indices get rebased
+        size_t written = 0;
+        uint32_t baseVertex = 0;
+        for (const MeshPrimitive& primitive : _primitives) {
+                // broken files must not reach into the vertices of other meshes
+                const uint32_t last = static_cast<uint32_t>(primitive.vertexCount - 1);
+                for (size_t i = 0; i < primitive.indexCount; i++) {
+                        uint32_t index = baseVertex + std::min(primitive.index(i), last);
+                        if (narrow) {
+                                indices16[written++] = static_cast<uint16_t>(index);
+                        } else {
+                                indices32[written++] = index;
+                        }
+                }
+                baseVertex += static_cast<uint32_t>(primitive.vertexCount);
+        }
+}
+
+namespace gltf {
+
+bool load_meshes(const char* filename, std::vector<Mesh>& meshes, std::vector<std::string>* names)
+{
+        Document document;
+        if (!open(filename, document)) {
+                return false;
+        }
+
+        const json::Value& gltfMeshes = member(document.root, "meshes");
+        for (size_t i = 0; i < gltfMeshes.size(); i++) {
+                Mesh mesh;
+                if (!read_mesh(document, i, mesh)) {
+                        std::cerr << "WARN: skipping mesh " << i << " of " << filename << std::endl;
+                        continue;
+                }
+                meshes.push_back(std::move(mesh));
+                if (names) {
+                        const json::Value& name = member(gltfMeshes[i], "name");
+                        names->push_back(name.is_string() ? name.as_string() : "mesh" + std::to_string(i));
+                }
+        }
+        return !meshes.empty();
+}
+
+bool write_glb(const char* filename, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices)
+{
+        const size_t vertexCount = vertices.size();
+        const size_t attributeSize = vertexCount * sizeof(glm::vec3);
+        const size_t indexSize = indices.size() * sizeof(uint32_t);
+
+        // positions, normals and colors one after another, then the indices
+        std::vector<uint8_t> bin(3 * attributeSize + indexSize);
+        glm::vec3 min { FLT_MAX }, max { -FLT_MAX };
+        for (size_t i = 0; i < vertexCount; i++) {
+                const Vertex& vertex = vertices[i];
+                std::memcpy(bin.data() + i * sizeof(glm::vec3), &vertex.position, sizeof(glm::vec3));
+                std::memcpy(bin.data() + attributeSize + i * sizeof(glm::vec3), &vertex.normals, sizeof(glm::vec3));
+                std::memcpy(bin.data() + 2 * attributeSize + i * sizeof(glm::vec3), &vertex.color, sizeof(glm::vec3));
+                min = glm::min(min, vertex.position);
+                max = glm::max(max, vertex.position);
+        }
+        if (!indices.empty()) {
+                std::memcpy(bin.data() + 3 * attributeSize, indices.data(), indexSize);
+        }
+
+        char json[2048];
+        int length = std::snprintf(json, sizeof(json),
+                "{\"asset\":{\"version\":\"2.0\"},"
+                "\"buffers\":[{\"byteLength\":%zu}],"
+                "\"bufferViews\":["
+                "{\"buffer\":0,\"byteOffset\":0,\"byteLength\":%zu,\"target\":34962},"
+                "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34962},"
+                "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34962},"
+                "{\"buffer\":0,\"byteOffset\":%zu,\"byteLength\":%zu,\"target\":34963}],"
+                "\"accessors\":["
+                "{\"bufferView\":0,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\",\"min\":[%.9g,%.9g,%.9g],\"max\":[%.9g,%.9g,%.9g]},"
+                "{\"bufferView\":1,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+                "{\"bufferView\":2,\"componentType\":5126,\"count\":%zu,\"type\":\"VEC3\"},"
+                "{\"bufferView\":3,\"componentType\":5125,\"count\":%zu,\"type\":\"SCALAR\"}],"
+                "\"meshes\":[{\"primitives\":[{\"attributes\":{\"POSITION\":0,\"NORMAL\":1,\"COLOR_0\":2},\"indices\":3}]}],"
+                "\"nodes\":[{\"mesh\":0}],\"scenes\":[{\"nodes\":[0]}],\"scene\":0}",
+                bin.size(),
+                attributeSize,
+                attributeSize, attributeSize,
+                2 * attributeSize, attributeSize,
+                3 * attributeSize, indexSize,
+                vertexCount, min.x, min.y, min.z, max.x, max.y, max.z,
+                vertexCount,
+                vertexCount,
+                indices.size());
+        if (length < 0 || static_cast<size_t>(length) >= sizeof(json)) {
+                return false;
+        }
+
+        // the json chunk is padded with spaces, the binary one with zeros
+        std::string jsonChunk(json, length);
+        jsonChunk.resize((jsonChunk.size() + 3) & ~size_t(3), ' ');
+        bin.resize((bin.size() + 3) & ~size_t(3), 0);
+
+        const uint32_t header[3] = {
+                GLB_MAGIC,
+                GLB_VERSION,
+                static_cast<uint32_t>(12 + 8 + jsonChunk.size() + 8 + bin.size()),
+        };
+        const uint32_t jsonHeader[2] = { static_cast<uint32_t>(jsonChunk.size()), CHUNK_JSON };
+        const uint32_t binHeader[2] = { static_cast<uint32_t>(bin.size()), CHUNK_BIN };
+
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+                return false;
+        }
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(jsonHeader), sizeof(jsonHeader));
+        file.write(jsonChunk.data(), jsonChunk.size());
+        file.write(reinterpret_cast<const char*>(binHeader), sizeof(binHeader));
+        file.write(reinterpret_cast<const char*>(bin.data()), bin.size());
+        return file.good();
+}
+
+void benchmark(const char* objFilename, int iterations)
+{
+        iterations = std::max(iterations, 1);
+        std::vector<Vertex> objVertices;
+        std::vector<uint32_t> objIndices;
+        if (!obj::parse(objFilename, objVertices, objIndices)) {
+                std::cerr << "ERROR: failed to parse " << objFilename << std::endl;
+                return;
+        }
+
+        const std::string glbFilename = (std::filesystem::temp_directory_path()
+                / std::filesystem::path(objFilename).filename().replace_extension(".glb"))
+                                                .string();
+        if (!write_glb(glbFilename.c_str(), objVertices, objIndices)) {
+                std::cerr << "ERROR: failed to write " << glbFilename << std::endl;
+                return;
+        }
+
+        auto measure = [&](auto&& load) {
+                double best = 1e30;
+                for (int i = 0; i < iterations; i++) {
+                        auto start = std::chrono::high_resolution_clock::now();
+                        load();
+                        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+                        best = std::min(best, elapsed.count());
+                }
+                return best;
+        };
+
+        // both end with the bytes upload_mesh would copy into the staging ring
+        auto stage = [](const Mesh& mesh, std::vector<uint8_t>& staging) {
+                const size_t vertexSize = mesh.vertex_count() * mesh.vertex_stride();
+                staging.resize(vertexSize + mesh.index_count() * mesh.index_size());
+                mesh.write_vertices(staging.data());
+                mesh.write_indices(staging.data() + vertexSize);
+        };
+
+        std::vector<uint8_t> objStaging, glbStaging;
+        size_t glbVertices = 0;
+        double objTime = measure([&]() {
+                Mesh mesh;
+                obj::parse(objFilename, mesh._vertices, mesh._indices);
+                stage(mesh, objStaging);
+        });
+        double glbTime = measure([&]() {
+                Mesh mesh;
+                mesh.load_from_glb(glbFilename.c_str());
+                stage(mesh, glbStaging);
+                glbVertices = mesh.vertex_count();
+        });
+
+        std::error_code error;
+        const double objMegabytes = std::filesystem::file_size(objFilename, error) / (1024.0 * 1024.0);
+        const double glbMegabytes = std::filesystem::file_size(glbFilename, error) / (1024.0 * 1024.0);
+        std::filesystem::remove(glbFilename, error);
+
+        std::printf("%s: %zu vertices, %zu indices\n", objFilename, objVertices.size(), objIndices.size());
+        std::printf("  obj: %8.2f ms, %6.1f MB file\n", objTime * 1000.0, objMegabytes);
+        std::printf("  glb: %8.2f ms, %6.1f MB file, %zu vertices, %.1fx faster, %s staging data\n",
+                glbTime * 1000.0, glbMegabytes, glbVertices, objTime / glbTime,
+                objStaging == glbStaging ? "same" : "different");
+}
+
+}
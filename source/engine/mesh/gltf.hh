@@ -0,0 +1,26 @@
+#pragma once
+
+#include "mesh.hh"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Binary glTF 2.0 (.glb) reader. The file is mapped and the meshes only keep
+// views of the accessors inside its binary chunk, the vertices are converted
+// while they are written into the staging buffer. Triangle list primitives
+// with POSITION, NORMAL, COLOR_0 and optional indices in the embedded buffer
+// are supported, node transforms, materials and sparse accessors are not.
+namespace gltf {
+
+// Every mesh of the file, sharing one mapping. names gets the glTF mesh names.
+bool load_meshes(const char* filename, std::vector<Mesh>& meshes, std::vector<std::string>* names = nullptr);
+
+// Writes a glb with a single mesh, every attribute in a buffer view of its own.
+bool write_glb(const char* filename, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+
+// Converts the obj into a glb, then prints how long either takes to go from
+// the file to the bytes the staging buffer gets.
+void benchmark(const char* objFilename, int iterations = 5);
+
+}
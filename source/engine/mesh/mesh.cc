@@ -1,20 +1,69 @@
 #include "mesh.hh"
+#include "obj_parser.hh"
+#include "optimize.hh"
+#include "simplify.hh"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
 #include <tiny_obj_loader.h>
+#include <unordered_map>
 #include <vector>
 
-VertexInputDescription Vertex::get_vertex_input_desc()
+namespace std {
+template <>
+struct hash<Vertex> {
+        size_t operator()(const Vertex& vertex) const
+        {
+                // hash the raw bits of every component, the vertices come
+                // straight from the parser so equal values have equal bits
+                uint32_t bits[9];
+                std::memcpy(bits, &vertex, sizeof(bits));
+
+                size_t seed = 0;
+                for (uint32_t b : bits) {
+                        seed ^= std::hash<uint32_t> {}(b) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+                }
+                return seed;
+        }
+};
+}
+
+bool Vertex::operator==(const Vertex& other) const
+{
+        return position == other.position && normals == other.normals && color == other.color;
+}
+
+VertexInputDescription Vertex::get_vertex_input_desc(VertexFormat format, VertexLayout layout)
 {
         VertexInputDescription description;
 
+        const uint32_t stride = format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+        // the position comes first in both vertex types
+        const uint32_t positionStride = format == VertexFormat::Packed ? sizeof(PackedVertex::position) : sizeof(Vertex::position);
+
         VkVertexInputBindingDescription mainBinding {};
 
         mainBinding.binding = 0; // number of these to generate
         mainBinding.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-        mainBinding.stride = sizeof(Vertex);
+        mainBinding.stride = layout == VertexLayout::Interleaved ? stride : positionStride;
 
         description.bindings.push_back(mainBinding);
 
+        // the rest of the vertex, with the offsets shifted by the position
+        uint32_t attributeBinding = 0;
+        uint32_t attributeShift = 0;
+        if (layout == VertexLayout::Split) {
+                VkVertexInputBindingDescription attributeDescription = mainBinding;
+                attributeDescription.binding = 1;
+                attributeDescription.stride = stride - positionStride;
+                description.bindings.push_back(attributeDescription);
+
+                attributeBinding = 1;
+                attributeShift = positionStride;
+        }
+
         VkVertexInputAttributeDescription
                 positionAttrib {},
                 colorAttrib {},
@@ -22,27 +71,68 @@ VertexInputDescription Vertex::get_vertex_input_desc()
 
         positionAttrib.binding = 0;
         positionAttrib.location = 0;
-        positionAttrib.offset = offsetof(Vertex, position);
-        positionAttrib.format = VK_FORMAT_R32G32B32_SFLOAT;
 
-        colorAttrib.binding = 0;
+        colorAttrib.binding = attributeBinding;
         colorAttrib.location = 2;
-        colorAttrib.offset = offsetof(Vertex, color);
-        colorAttrib.format = VK_FORMAT_R32G32B32_SFLOAT;
 
-        normalsAttrib.binding = 0;
+        normalsAttrib.binding = attributeBinding;
         normalsAttrib.location = 1;
-        normalsAttrib.offset = offsetof(Vertex, normals);
-        normalsAttrib.format = VK_FORMAT_R32G32B32_SFLOAT;
+
+        if (format == VertexFormat::Packed) {
+                // the shader decodes the normal, the rest is plain unorm
+                positionAttrib.offset = offsetof(PackedVertex, position);
+                positionAttrib.format = VK_FORMAT_R16G16B16A16_UNORM;
+                colorAttrib.offset = offsetof(PackedVertex, color) - attributeShift;
+                colorAttrib.format = VK_FORMAT_R8G8B8A8_SNORM;
+                normalsAttrib.offset = offsetof(PackedVertex, normal) - attributeShift;
+                normalsAttrib.format = VK_FORMAT_R16G16_SNORM;
+        } else {
+                positionAttrib.offset = offsetof(Vertex, position);
+                positionAttrib.format = VK_FORMAT_R32G32B32_SFLOAT;
+                colorAttrib.offset = offsetof(Vertex, color) - attributeShift;
+                colorAttrib.format = VK_FORMAT_R32G32B32_SFLOAT;
+                normalsAttrib.offset = offsetof(Vertex, normals) - attributeShift;
+                normalsAttrib.format = VK_FORMAT_R32G32B32_SFLOAT;
+        }
 
         description.attributes.push_back(positionAttrib);
-        description.attributes.push_back(normalsAttrib);
-        description.attributes.push_back(colorAttrib);
+        if (layout != VertexLayout::PositionOnly) {
+                description.attributes.push_back(normalsAttrib);
+                description.attributes.push_back(colorAttrib);
+        }
 
         return description;
 };
 
 bool Mesh::load_from_obj(const char* filename)
+{
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        if (!obj::parse(filename, vertices, indices)) {
+                return false;
+        }
+
+        // whatever was loaded before is replaced
+        _mapping.reset();
+        _mappedVertices = nullptr;
+        _mappedIndices = nullptr;
+        _primitives.clear();
+        _vertices = std::move(vertices);
+        _indices = std::move(indices);
+        _packedVertices.clear();
+        _meshlets.clear();
+        _lods.clear();
+
+        std::cout << filename << ": " << _vertices.size() << " unique vertices out of "
+                  << _indices.size() << std::endl;
+
+        optimize(filename);
+        compute_bounds();
+
+        return true;
+}
+
+bool Mesh::load_from_obj_tinyobj(const char* filename)
 {
         // this is gonna contain the vertex arrays
         tinyobj::attrib_t attrib;
@@ -56,7 +146,7 @@ bool Mesh::load_from_obj(const char* filename)
         std::string warn, err;
 
         // load the object
-        tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, nullptr);
+        bool loaded = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename, nullptr);
 
         if (!warn.empty()) {
                 std::cout << "WARN: " << warn << std::endl;
@@ -64,6 +154,24 @@ bool Mesh::load_from_obj(const char* filename)
         if (!err.empty()) {
                 std::cerr << "ERROR: " << err << std::endl;
         }
+        if (!loaded) {
+                return false;
+        }
+
+        // whatever was loaded before is replaced
+        _mapping.reset();
+        _mappedVertices = nullptr;
+        _mappedIndices = nullptr;
+        _primitives.clear();
+        _vertices.clear();
+        _indices.clear();
+        _packedVertices.clear();
+        _meshlets.clear();
+        _lods.clear();
+
+        // maps every unique vertex to its slot in _vertices
+        std::unordered_map<Vertex, uint32_t> uniqueVertices;
+        size_t faceVertexCount = 0;
 
         // Loop over shapes
         for (size_t s = 0; s < shapes.size(); s++) {
@@ -75,7 +183,7 @@ bool Mesh::load_from_obj(const char* filename)
                         int fv = 3;
 
                         // Loop over vertices in the face.
-                        for (size_t v = 0; v < fv; v++) {
+                        for (int v = 0; v < fv; v++) {
                                 // access to vertex
                                 tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
 
@@ -105,11 +213,310 @@ bool Mesh::load_from_obj(const char* filename)
                                 // we are setting the vertex color as the vertex normal. This is just for display purposes
                                 new_vert.color = new_vert.normals;
 
-                                _vertices.push_back(new_vert);
+                                // only keep the vertex if we haven't seen it yet,
+                                // either way the face references it by index
+                                auto [it, inserted] = uniqueVertices.try_emplace(new_vert, static_cast<uint32_t>(_vertices.size()));
+                                if (inserted) {
+                                        _vertices.push_back(new_vert);
+                                }
+                                _indices.push_back(it->second);
+                                faceVertexCount++;
                         }
                         index_offset += fv;
                 }
         }
 
+        std::cout << filename << ": " << _vertices.size() << " unique vertices out of "
+                  << faceVertexCount << std::endl;
+
+        compute_bounds();
+
         return true;
 }
+
+void Mesh::optimize(const char* name)
+{
+        if (_indices.empty()) {
+                return;
+        }
+
+        VertexCacheStats before = analyze_vertex_cache(_indices.data(), _indices.size(), _vertices.size());
+
+        optimize_vertex_cache(_indices.data(), _indices.size(), _vertices.size());
+        optimize_overdraw(_indices.data(), _indices.size(), _vertices);
+        optimize_vertex_fetch(_vertices, _indices.data(), _indices.size());
+
+        VertexCacheStats after = analyze_vertex_cache(_indices.data(), _indices.size(), _vertices.size());
+
+        std::cout << name << ": ACMR " << before.acmr << " -> " << after.acmr
+                  << ", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+void Mesh::compute_bounds()
+{
+        static_assert(offsetof(Vertex, position) == 0, "positions are read from the start of Vertex");
+        if (_vertices.empty()) {
+                _bounds = {};
+                return;
+        }
+        _bounds = ::compute_bounds(&_vertices.data()->position.x, _vertices.size(), sizeof(Vertex));
+}
+
+glm::vec3 packing_scale(const Bounds& bounds)
+{
+        const glm::vec3 extent = bounds.max - bounds.min;
+        // flat meshes have no extent along one axis, everything maps to 0 there
+        return {
+                extent.x > 0.0f ? 65535.0f / extent.x : 0.0f,
+                extent.y > 0.0f ? 65535.0f / extent.y : 0.0f,
+                extent.z > 0.0f ? 65535.0f / extent.z : 0.0f,
+        };
+}
+
+PackedVertex pack_vertex(const Vertex& vertex, const Bounds& bounds, const glm::vec3& scale)
+{
+        PackedVertex packed;
+
+        glm::vec3 position = (vertex.position - bounds.min) * scale;
+        for (int c = 0; c < 3; c++) {
+                packed.position[c] = static_cast<uint16_t>(std::clamp(std::lround(position[c]), 0l, 65535l));
+        }
+        packed.position[3] = 0;
+
+        // project onto the octahedron, then fold the lower half over
+        glm::vec3 n = vertex.normals;
+        float sum = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+        n = sum > 0.0f ? n / sum : glm::vec3(0.0f, 0.0f, 1.0f);
+        float ex = n.x, ey = n.y;
+        if (n.z < 0.0f) {
+                ex = (1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+                ey = (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+        }
+        packed.normal[0] = static_cast<int16_t>(std::lround(std::clamp(ex, -1.0f, 1.0f) * 32767.0f));
+        packed.normal[1] = static_cast<int16_t>(std::lround(std::clamp(ey, -1.0f, 1.0f) * 32767.0f));
+
+        // signed, a normal standing in for the color has negative components
+        for (int c = 0; c < 3; c++) {
+                packed.color[c] = static_cast<int8_t>(std::lround(std::clamp(vertex.color[c], -1.0f, 1.0f) * 127.0f));
+        }
+        packed.color[3] = 127;
+
+        return packed;
+}
+
+void Mesh::pack_vertices()
+{
+        _packedVertices.resize(_vertices.size());
+
+        const glm::vec3 scale = packing_scale(_bounds);
+        for (size_t i = 0; i < _vertices.size(); i++) {
+                _packedVertices[i] = pack_vertex(_vertices[i], _bounds, scale);
+        }
+}
+
+void Mesh::build_lods()
+{
+        _lods.clear();
+        if (_indices.size() < 3) {
+                return;
+        }
+
+        const uint32_t baseCount = static_cast<uint32_t>(_indices.size());
+        _lods.push_back({ 0, baseCount, 0.0f });
+
+        // every level starts from the full mesh so the errors don't stack up
+        std::vector<uint32_t> lodIndices;
+        for (size_t level = 1; level < MAX_MESH_LODS; level++) {
+                size_t target = (baseCount >> level) / 3 * 3;
+                if (target < 3 * 8) {
+                        break;
+                }
+
+                float error;
+                lodIndices = simplify_mesh(_vertices, _indices.data(), baseCount, target, error);
+                // stop once the simplifier doesn't get much further
+                if (lodIndices.empty() || lodIndices.size() > _lods.back().indexCount * 9 / 10) {
+                        break;
+                }
+
+                MeshLod lod;
+                lod.firstIndex = static_cast<uint32_t>(_indices.size());
+                lod.indexCount = static_cast<uint32_t>(lodIndices.size());
+                lod.error = error;
+                _lods.push_back(lod);
+                _indices.insert(_indices.end(), lodIndices.begin(), lodIndices.end());
+        }
+}
+
+void Mesh::build_meshlets()
+{
+        _meshlets = ::build_meshlets(_vertices, _indices.data(), lod(0).indexCount);
+}
+
+size_t Mesh::lod_count() const
+{
+        return _lods.empty() ? 1 : _lods.size();
+}
+
+MeshLod Mesh::lod(size_t level) const
+{
+        if (_lods.empty()) {
+                return { 0, static_cast<uint32_t>(index_count()), 0.0f };
+        }
+        return _lods[std::min(level, _lods.size() - 1)];
+}
+
+size_t Mesh::select_lod(float pixelsPerUnit) const
+{
+        size_t level = 0;
+        for (size_t i = 1; i < _lods.size(); i++) {
+                if (_lods[i].error * pixelsPerUnit > 1.0f) {
+                        break;
+                }
+                level = i;
+        }
+        return level;
+}
+
+size_t Mesh::vertex_count() const
+{
+        return _mapping ? _mappedVertexCount : _vertices.size();
+}
+
+size_t Mesh::vertex_stride() const
+{
+        return _format == VertexFormat::Packed ? sizeof(PackedVertex) : sizeof(Vertex);
+}
+
+size_t Mesh::position_stride() const
+{
+        return _format == VertexFormat::Packed ? sizeof(PackedVertex::position) : sizeof(Vertex::position);
+}
+
+size_t Mesh::attribute_stride() const
+{
+        return _splitPositions ? vertex_stride() - position_stride() : vertex_stride();
+}
+
+VertexLayout Mesh::layout() const
+{
+        return _splitPositions ? VertexLayout::Split : VertexLayout::Interleaved;
+}
+
+glm::mat4 Mesh::vertex_transform() const
+{
+        glm::mat4 transform { 1.0f };
+        if (_format == VertexFormat::Packed) {
+                // undo the normalization done in pack_vertices. A flat mesh
+                // has only zeros along one axis, any scale works there, but
+                // without one the matrix can't be inverted for the normals
+                glm::vec3 extent = _bounds.max - _bounds.min;
+                const float minimum = std::max({ extent.x, extent.y, extent.z, 1.0f }) * 1e-6f;
+                extent = glm::max(extent, glm::vec3(minimum));
+                transform[0][0] = extent.x;
+                transform[1][1] = extent.y;
+                transform[2][2] = extent.z;
+                transform[3] = glm::vec4(_bounds.min, 1.0f);
+        }
+        return transform;
+}
+
+size_t Mesh::index_count() const
+{
+        return _mapping ? _mappedIndexCount : _indices.size();
+}
+
+VkIndexType Mesh::index_type() const
+{
+        return vertex_count() <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+size_t Mesh::index_size() const
+{
+        return index_type() == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+int32_t Mesh::vertex_offset() const
+{
+        // the arena aligns vertex ranges to the stride, so this is exact
+        return static_cast<int32_t>(_geometry.vertexOffset / attribute_stride());
+}
+
+int32_t Mesh::position_offset() const
+{
+        return static_cast<int32_t>(_geometry.positionOffset / position_stride());
+}
+
+uint32_t Mesh::first_index() const
+{
+        return static_cast<uint32_t>(_geometry.indexOffset / index_size());
+}
+
+const void* Mesh::vertex_data() const
+{
+        if (_mappedVertices) {
+                return _mappedVertices;
+        }
+        return _format == VertexFormat::Packed ? static_cast<const void*>(_packedVertices.data()) : _vertices.data();
+}
+
+void Mesh::write_vertices(void* dst) const
+{
+        if (!_primitives.empty()) {
+                write_primitive_vertices(dst, nullptr);
+                return;
+        }
+
+        if (!_splitPositions) {
+                std::memcpy(dst, vertex_data(), vertex_count() * vertex_stride());
+                return;
+        }
+
+        // everything behind the position of every vertex
+        const char* src = static_cast<const char*>(vertex_data()) + position_stride();
+        char* out = static_cast<char*>(dst);
+        const size_t stride = vertex_stride();
+        const size_t size = attribute_stride();
+        for (size_t i = 0; i < vertex_count(); i++) {
+                std::memcpy(out + i * size, src + i * stride, size);
+        }
+}
+
+void Mesh::write_positions(void* dst) const
+{
+        if (!_primitives.empty()) {
+                write_primitive_vertices(nullptr, dst);
+                return;
+        }
+
+        const char* src = static_cast<const char*>(vertex_data());
+        char* out = static_cast<char*>(dst);
+        const size_t stride = vertex_stride();
+        const size_t size = position_stride();
+        for (size_t i = 0; i < vertex_count(); i++) {
+                std::memcpy(out + i * size, src + i * stride, size);
+        }
+}
+
+void Mesh::write_indices(void* dst) const
+{
+        if (!_primitives.empty()) {
+                write_primitive_indices(dst);
+                return;
+        }
+
+        // cooked indices are already stored in the gpu index type
+        if (_mappedIndices) {
+                std::memcpy(dst, _mappedIndices, index_count() * index_size());
+                return;
+        }
+
+        if (index_type() == VK_INDEX_TYPE_UINT16) {
+                uint16_t* indices = static_cast<uint16_t*>(dst);
+                for (size_t i = 0; i < _indices.size(); i++) {
+                        indices[i] = static_cast<uint16_t>(_indices[i]);
+                }
+        } else {
+                std::memcpy(dst, _indices.data(), _indices.size() * sizeof(uint32_t));
+        }
+}
@@ -1,7 +1,11 @@
 #pragma once
 
+#include "bounds.hh"
+#include "geometry_arena.hh"
+#include "meshlet.hh"
 #include "types.hh"
 #include <glm/glm.hpp>
+#include <memory>
 #include <vector>
 
 struct VertexInputDescription {
@@ -11,17 +15,199 @@ struct VertexInputDescription {
         VkPipelineVertexInputStateCreateFlags flags = 0;
 };
 
+enum class VertexFormat : uint32_t {
+        // Vertex, three float vectors
+        Full = 0,
+        // PackedVertex, quantized to 16 bytes
+        Packed = 1,
+};
+
+// How the vertex attributes are spread over the vertex buffer bindings.
+enum class VertexLayout : uint32_t {
+        // everything in binding 0
+        Interleaved = 0,
+        // positions in binding 0, normal and color in binding 1
+        Split = 1,
+        // only the positions in binding 0, for depth only pipelines
+        PositionOnly = 2,
+};
+
 struct Vertex {
         glm::vec3 position;
         glm::vec3 normals;
         glm::vec3 color;
 
-        static VertexInputDescription get_vertex_input_desc();
+        bool operator==(const Vertex& other) const;
+
+        static VertexInputDescription get_vertex_input_desc(VertexFormat format = VertexFormat::Full,
+                VertexLayout layout = VertexLayout::Interleaved);
+};
+
+// Compressed version of Vertex, less than half its size. The position is
+// normalized to the mesh bounds, the model matrix gets the matching scale and
+// offset from Mesh::vertex_transform().
+struct PackedVertex {
+        // unorm16, w is padding
+        uint16_t position[4];
+        // octahedral encoded unit vector, snorm16
+        int16_t normal[2];
+        // rgba8 snorm, the loaders use the normal as color when there is none
+        int8_t color[4];
+};
+
+// One level of detail, a range of the mesh index buffer. Level 0 is the full
+// mesh, every following level has about half the triangles.
+struct MeshLod {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+        // how far the simplified surface strays from the original, model units
+        float error;
+};
+
+constexpr size_t MAX_MESH_LODS = 5;
+
+// Strided view of a glTF accessor inside the mapped file.
+struct AccessorView {
+        const uint8_t* data = nullptr;
+        size_t stride = 0;
+        // glTF componentType (5120 byte ... 5126 float) and components per element
+        uint32_t componentType = 0;
+        uint32_t components = 0;
+        bool normalized = false;
+
+        bool valid() const { return data != nullptr; }
+};
+
+// One triangle list of a mesh loaded with load_from_glb. Nothing is copied
+// while loading, the accessors are converted on their way into the staging
+// buffer. The vertices of a primitive follow the ones of the previous one.
+struct MeshPrimitive {
+        AccessorView positions;
+        // normals and colors are optional
+        AccessorView normals;
+        AccessorView colors;
+        // not set for primitives without an index buffer
+        AccessorView indices;
+        size_t vertexCount = 0;
+        size_t indexCount = 0;
+
+        Vertex vertex(size_t i) const;
+        uint32_t index(size_t i) const;
 };
 
 struct Mesh {
+        // layout of the gpu vertex buffer
+        VertexFormat _format = VertexFormat::Full;
+
         std::vector<Vertex> _vertices;
-        AllocatedBuffer _vertexBuffer;
+        // indices into _vertices, narrowed to 16 bit on upload when possible
+        std::vector<uint32_t> _indices;
+        // _vertices compressed, only filled for the packed format
+        std::vector<PackedVertex> _packedVertices;
+
+        // Set when the mesh came from a cooked or glb file, the vertex and
+        // index data then stays in the mapped file (see VfsFile::owner)
+        // instead of the vectors above. Cooked data is already in the gpu
+        // layout, glb data is described by _primitives.
+        std::shared_ptr<const void> _mapping;
+        const void* _mappedVertices = nullptr;
+        const void* _mappedIndices = nullptr;
+        size_t _mappedVertexCount = 0;
+        size_t _mappedIndexCount = 0;
+        std::vector<MeshPrimitive> _primitives;
+
+        // clusters of the lod 0 index range used for culling
+        std::vector<Meshlet> _meshlets;
+        // index ranges of the detail levels, the coarser levels are stored
+        // after lod 0 in _indices. Empty means the whole buffer is lod 0.
+        std::vector<MeshLod> _lods;
+
+        Bounds _bounds {};
+        // how long loading and processing the source asset took, kept in the
+        // cooked file so cooked loads can be compared against it
+        float _sourceLoadMs = 0.0f;
 
+        // Keeps the positions in a stream of their own next to the other
+        // attributes, so depth only passes fetch just the positions. Has to be
+        // set before the upload.
+        bool _splitPositions = false;
+
+        // where upload_mesh put the mesh in the engine's geometry arena
+        GeometryRange _geometry;
+
+        // Loads the cooked version of the file from the MeshCache, otherwise
+        // parses and processes the obj and adds it to the cache for the next
+        // run. glb files are read directly, they don't need cooking.
+        bool load(const char* filename, VertexFormat format = VertexFormat::Full);
         bool load_from_obj(const char* filename);
+        // the old tinyobj based loader, only kept around to benchmark obj::parse
+        bool load_from_obj_tinyobj(const char* filename);
+        bool load_from_cooked(const char* filename);
+        // The bounds load() ends up with, without loading the mesh: from the
+        // header of the cooked entry, glb files are mapped for them. False
+        // when the obj wasn't cooked yet.
+        static bool peek_bounds(const char* filename, VertexFormat format, Bounds& bounds);
+        // Maps a binary glTF file and keeps views of the primitives of one of
+        // its meshes, see gltf.hh for files with several meshes.
+        bool load_from_glb(const char* filename, size_t meshIndex = 0);
+        bool save_cooked(const char* filename) const;
+
+        // reorders _indices and _vertices for the post-transform cache,
+        // overdraw and vertex fetch, prints the cache stats before and after
+        void optimize(const char* name);
+        void compute_bounds();
+        // compresses _vertices into _packedVertices, needs the bounds
+        void pack_vertices();
+        // simplifies lod 0 into up to MAX_MESH_LODS - 1 coarser levels
+        void build_lods();
+        // splits the lod 0 indices into _meshlets
+        void build_meshlets();
+
+        size_t lod_count() const;
+        MeshLod lod(size_t level) const;
+        // coarsest level whose error stays below a pixel, pixelsPerUnit is
+        // the size of one model space unit on screen
+        size_t select_lod(float pixelsPerUnit) const;
+
+        size_t vertex_count() const;
+        // size of a whole vertex, the sum of the two strides below
+        size_t vertex_stride() const;
+        size_t position_stride() const;
+        // stride of the vertex stream, only normal and color when the
+        // positions are split off
+        size_t attribute_stride() const;
+        VertexLayout layout() const;
+        size_t index_count() const;
+
+        // 16 bit indices are used whenever every vertex can be addressed with them
+        VkIndexType index_type() const;
+        size_t index_size() const;
+
+        // draw parameters locating the mesh inside the arena buffers
+        int32_t vertex_offset() const;
+        // vertexOffset for drawing the position stream on its own
+        int32_t position_offset() const;
+        uint32_t first_index() const;
+
+        // maps the vertex positions of the buffer back into model space
+        glm::mat4 vertex_transform() const;
+
+        // Write the data in the layout the gpu buffers expect, dst has to hold
+        // vertex_count() * attribute_stride(), vertex_count() * position_stride()
+        // and index_count() * index_size() bytes.
+        void write_vertices(void* dst) const;
+        // only for _splitPositions
+        void write_positions(void* dst) const;
+        // the interleaved vertices, from the mapping or the vectors
+        const void* vertex_data() const;
+        void write_indices(void* dst) const;
+
+private:
+        // converts _primitives into the gpu layout, either pointer may be null
+        void write_primitive_vertices(void* attributes, void* positions) const;
+        void write_primitive_indices(void* dst) const;
 };
+
+// the scale pack_vertices applies to positions after subtracting bounds.min
+glm::vec3 packing_scale(const Bounds& bounds);
+PackedVertex pack_vertex(const Vertex& vertex, const Bounds& bounds, const glm::vec3& scale);
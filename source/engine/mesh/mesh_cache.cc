@@ -0,0 +1,78 @@
+#include "mesh_cache.hh"
+#include "cooked_mesh.hh"
+#include "hash.hh"
+#include "meshlet.hh"
+#include "vfs.hh"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <filesystem>
+
+namespace {
+
+// everything besides the source that ends up in the cooked file, bump
+// cooked::MESH_VERSION for changes to the processing itself
+struct CookSettings {
+        uint32_t version;
+        uint32_t format;
+        uint32_t maxLods;
+        uint32_t meshletVertices;
+        uint32_t meshletTriangles;
+};
+
+}
+
+MeshCache& MeshCache::global()
+{
+        static MeshCache cache;
+        return cache;
+}
+
+void MeshCache::set_directory(const std::string& directory)
+{
+        std::lock_guard lock(_mutex);
+        _directory = directory;
+}
+
+std::string MeshCache::entry_path(const char* source, VertexFormat format) const
+{
+        uint64_t key;
+        if (!Vfs::global().content_hash(source, key)) {
+                return {};
+        }
+
+        CookSettings settings {};
+        settings.version = cooked::MESH_VERSION;
+        settings.format = static_cast<uint32_t>(format);
+        settings.maxLods = MAX_MESH_LODS;
+        settings.meshletVertices = MESHLET_MAX_VERTICES;
+        settings.meshletTriangles = MESHLET_MAX_TRIANGLES;
+
+        key = hash64(&settings, sizeof(settings), key);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016" PRIx64 ".mesh", key);
+
+        std::lock_guard lock(_mutex);
+        return (std::filesystem::path(_directory) / name).string();
+}
+
+void MeshCache::record_hit(float savedMs)
+{
+        std::lock_guard lock(_mutex);
+        _stats.hits++;
+        _stats.savedMs += std::max(savedMs, 0.0f);
+}
+
+void MeshCache::record_miss()
+{
+        std::lock_guard lock(_mutex);
+        _stats.misses++;
+}
+
+MeshCacheStats MeshCache::stats() const
+{
+        std::lock_guard lock(_mutex);
+        return _stats;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "mesh.hh"
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// relative to the working directory, the build directory the engine runs
+// from, generated files stay out of the source tree
+constexpr const char* MESH_CACHE_DIRECTORY = "cache/meshes";
+
+struct MeshCacheStats {
+        uint32_t hits = 0;
+        uint32_t misses = 0;
+        // processing time of the hits minus the time it took to hash their
+        // sources and map them
+        float savedMs = 0.0f;
+};
+
+// Content addressed directory of cooked meshes. An entry is named after a
+// hash of the source file bytes and of everything that changes the cooked
+// output, so edited sources and new settings simply miss, and reverted ones
+// hit again. Entries are never invalidated, the directory can be deleted at
+// any time.
+//
+// Meshes load on the thread pool, everything here may be called from any thread.
+class MeshCache {
+public:
+        // the cache used by Mesh::load
+        static MeshCache& global();
+
+        void set_directory(const std::string& directory);
+
+        // Path of the cooked entry for source loaded in format, whether it
+        // exists or not. Empty when the source can't be read.
+        std::string entry_path(const char* source, VertexFormat format) const;
+
+        void record_hit(float savedMs);
+        void record_miss();
+        MeshCacheStats stats() const;
+
+private:
+        mutable std::mutex _mutex;
+        std::string _directory = MESH_CACHE_DIRECTORY;
+        MeshCacheStats _stats;
+};
@@ -0,0 +1,134 @@
+#include "meshlet.hh"
+#include "bounds.hh"
+#include "mesh.hh"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+Meshlet finish_meshlet(const std::vector<Vertex>& vertices, const uint32_t* indices, uint32_t firstIndex, uint32_t indexCount)
+{
+        Meshlet meshlet {};
+        meshlet.firstIndex = firstIndex;
+        meshlet.indexCount = indexCount;
+
+        std::vector<glm::vec3> points;
+        points.reserve(indexCount);
+        std::vector<glm::vec3> normals;
+        normals.reserve(indexCount / 3);
+
+        glm::vec3 axis { 0.0f };
+        for (uint32_t i = firstIndex; i < firstIndex + indexCount; i += 3) {
+                const glm::vec3& p0 = vertices[indices[i + 0]].position;
+                const glm::vec3& p1 = vertices[indices[i + 1]].position;
+                const glm::vec3& p2 = vertices[indices[i + 2]].position;
+                points.push_back(p0);
+                points.push_back(p1);
+                points.push_back(p2);
+
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float length = glm::length(normal);
+                // degenerate triangles don't face anywhere
+                if (length > 0.0f) {
+                        normals.push_back(normal / length);
+                        axis += normal / length;
+                }
+        }
+
+        compute_sphere(&points.data()->x, points.size(), sizeof(glm::vec3), meshlet.center, meshlet.radius);
+
+        // a cutoff of 1 never passes the cull test
+        meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.coneCutoff = 1.0f;
+
+        float axisLength = glm::length(axis);
+        if (axisLength > 0.0f) {
+                axis /= axisLength;
+                float minDot = 1.0f;
+                for (const glm::vec3& normal : normals) {
+                        minDot = std::min(minDot, glm::dot(normal, axis));
+                }
+                meshlet.coneAxis = axis;
+                // with a spread past ~85 degrees some triangle always faces the camera
+                if (minDot > 0.1f) {
+                        meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+                }
+        }
+
+        return meshlet;
+}
+
+}
+
+std::vector<Meshlet> build_meshlets(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount)
+{
+        std::vector<Meshlet> meshlets;
+
+        // marks the vertices used by the meshlet being built
+        std::vector<uint32_t> usedBy(vertices.size(), UINT32_MAX);
+        uint32_t meshletId = 0;
+        uint32_t firstIndex = 0;
+        size_t vertexCount = 0;
+
+        const uint32_t triangleIndexCount = static_cast<uint32_t>(indexCount - indexCount % 3);
+        for (uint32_t i = 0; i < triangleIndexCount; i += 3) {
+                size_t newVertices = 0;
+                for (int c = 0; c < 3; c++) {
+                        newVertices += usedBy[indices[i + c]] != meshletId;
+                }
+                // corners repeating within the triangle are counted twice
+                // above, which only ever makes the check stricter
+                size_t triangleCount = (i - firstIndex) / 3;
+                if (vertexCount + newVertices > MESHLET_MAX_VERTICES || triangleCount + 1 > MESHLET_MAX_TRIANGLES) {
+                        meshlets.push_back(finish_meshlet(vertices, indices, firstIndex, i - firstIndex));
+                        meshletId++;
+                        firstIndex = i;
+                        vertexCount = 0;
+                }
+
+                for (int c = 0; c < 3; c++) {
+                        uint32_t index = indices[i + c];
+                        if (usedBy[index] != meshletId) {
+                                usedBy[index] = meshletId;
+                                vertexCount++;
+                        }
+                }
+        }
+
+        if (firstIndex < triangleIndexCount) {
+                meshlets.push_back(finish_meshlet(vertices, indices, firstIndex, triangleIndexCount - firstIndex));
+        }
+
+        return meshlets;
+}
+
+void cull_meshlets(const std::vector<Meshlet>& meshlets, const glm::mat4& modelViewProj, const glm::vec3& cameraPosition,
+        std::vector<IndexRange>& visible, MeshletCullStats& stats)
+{
+        // frustum planes in model space
+        const Frustum frustum = extract_frustum(modelViewProj);
+
+        stats.total += meshlets.size();
+
+        const size_t firstRange = visible.size();
+        for (const Meshlet& meshlet : meshlets) {
+                if (!sphere_in_frustum(frustum, meshlet.center, meshlet.radius)) {
+                        continue;
+                }
+
+                glm::vec3 toCenter = meshlet.center - cameraPosition;
+                if (glm::dot(toCenter, meshlet.coneAxis) >= meshlet.coneCutoff * glm::length(toCenter) + meshlet.radius) {
+                        continue;
+                }
+
+                stats.visible++;
+
+                // extend the last range when this meshlet follows it directly
+                if (visible.size() > firstRange && visible.back().firstIndex + visible.back().indexCount == meshlet.firstIndex) {
+                        visible.back().indexCount += meshlet.indexCount;
+                } else {
+                        visible.push_back({ meshlet.firstIndex, meshlet.indexCount });
+                }
+        }
+}
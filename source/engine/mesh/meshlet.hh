@@ -0,0 +1,48 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+// A cluster of up to MESHLET_MAX_VERTICES vertices / MESHLET_MAX_TRIANGLES
+// triangles, stored as a contiguous range of the mesh index buffer so it can
+// be drawn with a plain vkCmdDrawIndexed.
+struct Meshlet {
+        // bounding sphere, model space
+        glm::vec3 center;
+        float radius;
+
+        // normal cone, the cluster faces away from the camera when
+        // dot(center - camera, coneAxis) >= coneCutoff * |center - camera| + radius
+        glm::vec3 coneAxis;
+        float coneCutoff;
+
+        uint32_t firstIndex;
+        uint32_t indexCount;
+};
+
+constexpr size_t MESHLET_MAX_VERTICES = 64;
+constexpr size_t MESHLET_MAX_TRIANGLES = 124;
+
+struct IndexRange {
+        uint32_t firstIndex;
+        uint32_t indexCount;
+};
+
+struct MeshletCullStats {
+        size_t total = 0;
+        size_t visible = 0;
+};
+
+// Splits the triangle list into meshlets, keeping the triangle order.
+std::vector<Meshlet> build_meshlets(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount);
+
+// Appends the index ranges of the meshlets that are inside the frustum of
+// modelViewProj and not facing away from cameraPosition (in model space).
+// Neighbouring visible meshlets are merged into one range.
+void cull_meshlets(const std::vector<Meshlet>& meshlets, const glm::mat4& modelViewProj, const glm::vec3& cameraPosition,
+        std::vector<IndexRange>& visible, MeshletCullStats& stats);
@@ -0,0 +1,444 @@
+#include "obj_parser.hh"
+#include "mapped_file.hh"
+#include "thread_pool.hh"
+#include "vfs.hh"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+
+namespace {
+
+enum CornerFlags : uint8_t {
+        POSITION_IN_CHUNK = 1 << 0,
+        NORMAL_IN_CHUNK = 1 << 1,
+        HAS_NORMAL = 1 << 2,
+};
+
+// One corner of a face, with 0 based indices. Negative obj indices count back
+// from the records parsed so far, so they are stored relative to the start of
+// their chunk (flagged with *_IN_CHUNK) until the chunk offsets are known.
+struct Corner {
+        int32_t position;
+        int32_t normal;
+        uint8_t flags;
+};
+
+struct Chunk {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec3> normals;
+        std::vector<Corner> corners; // three per triangle
+        bool failed = false;
+};
+
+inline bool is_space(char c)
+{
+        return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skip_space(const char* p, const char* end)
+{
+        while (p < end && is_space(*p)) {
+                p++;
+        }
+        return p;
+}
+
+// Float parser for the plain decimal notation obj exporters write, way faster
+// than strtof as it doesn't care about locales, hex floats or inf/nan.
+const char* parse_float(const char* p, const char* end, float& out)
+{
+        static const double powers[] = {
+                1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+                1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+        };
+
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+                negative = *p == '-';
+                p++;
+        }
+
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        const char* start = p;
+
+        while (p < end && *p >= '0' && *p <= '9') {
+                // past 19 digits only the magnitude matters
+                if (digits < 19) {
+                        mantissa = mantissa * 10 + (*p - '0');
+                        digits += mantissa != 0;
+                } else {
+                        exponent++;
+                }
+                p++;
+        }
+        if (p < end && *p == '.') {
+                p++;
+                while (p < end && *p >= '0' && *p <= '9') {
+                        if (digits < 19) {
+                                mantissa = mantissa * 10 + (*p - '0');
+                                digits += mantissa != 0;
+                                exponent--;
+                        }
+                        p++;
+                }
+        }
+        if (p == start) {
+                return nullptr;
+        }
+        if (p < end && (*p == 'e' || *p == 'E')) {
+                p++;
+                bool negativeExponent = false;
+                if (p < end && (*p == '-' || *p == '+')) {
+                        negativeExponent = *p == '-';
+                        p++;
+                }
+                int value = 0;
+                while (p < end && *p >= '0' && *p <= '9') {
+                        value = std::min(value * 10 + (*p - '0'), 1000);
+                        p++;
+                }
+                exponent += negativeExponent ? -value : value;
+        }
+
+        double result = static_cast<double>(mantissa);
+        if (exponent < 0) {
+                result = -exponent <= 22 ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+        } else if (exponent > 0) {
+                result = exponent <= 22 ? result * powers[exponent] : result * std::pow(10.0, exponent);
+        }
+
+        out = static_cast<float>(negative ? -result : result);
+        return p;
+}
+
+const char* parse_int(const char* p, const char* end, int32_t& out)
+{
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+                negative = *p == '-';
+                p++;
+        }
+        const char* start = p;
+        int32_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+                value = value * 10 + (*p - '0');
+                p++;
+        }
+        if (p == start) {
+                return nullptr;
+        }
+        out = negative ? -value : value;
+        return p;
+}
+
+const char* parse_vec3(const char* p, const char* end, glm::vec3& out)
+{
+        for (int i = 0; i < 3; i++) {
+                p = skip_space(p, end);
+                p = parse_float(p, end, out[i]);
+                if (!p) {
+                        return nullptr;
+                }
+        }
+        return p;
+}
+
+// turns an obj index (1 based, negative = relative to the end) into a 0 based
+// one, returns true if it is relative to the chunk start
+inline bool decode_index(int32_t index, size_t localCount, int32_t& out)
+{
+        if (index > 0) {
+                out = index - 1;
+                return false;
+        }
+        out = static_cast<int32_t>(localCount) + index;
+        return true;
+}
+
+// parses one face corner: v, v/vt, v//vn or v/vt/vn
+const char* parse_corner(const char* p, const char* end, const Chunk& chunk, Corner& corner)
+{
+        int32_t value;
+        p = parse_int(p, end, value);
+        if (!p || value == 0) {
+                return nullptr;
+        }
+        corner.flags = 0;
+        corner.normal = 0;
+        if (decode_index(value, chunk.positions.size(), corner.position)) {
+                corner.flags |= POSITION_IN_CHUNK;
+        }
+
+        if (p < end && *p == '/') {
+                p++;
+                // texture coordinates aren't used, skip them
+                if (p < end && *p != '/') {
+                        p = parse_int(p, end, value);
+                        if (!p) {
+                                return nullptr;
+                        }
+                }
+                if (p < end && *p == '/') {
+                        p++;
+                        p = parse_int(p, end, value);
+                        if (!p || value == 0) {
+                                return nullptr;
+                        }
+                        corner.flags |= HAS_NORMAL;
+                        if (decode_index(value, chunk.normals.size(), corner.normal)) {
+                                corner.flags |= NORMAL_IN_CHUNK;
+                        }
+                }
+        }
+        return p;
+}
+
+void parse_chunk(const char* p, const char* end, Chunk& chunk)
+{
+        while (p < end) {
+                // memchr is vectorised by the c library, which makes finding
+                // the line ends the cheap part of the parse
+                const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', end - p));
+                if (!lineEnd) {
+                        lineEnd = end;
+                }
+
+                const char* line = skip_space(p, lineEnd);
+                p = lineEnd + 1;
+
+                if (lineEnd - line < 2) {
+                        continue;
+                }
+
+                if (line[0] == 'v' && is_space(line[1])) {
+                        glm::vec3 position;
+                        if (!parse_vec3(line + 2, lineEnd, position)) {
+                                chunk.failed = true;
+                                return;
+                        }
+                        chunk.positions.push_back(position);
+                } else if (line[0] == 'v' && line[1] == 'n' && lineEnd - line > 2 && is_space(line[2])) {
+                        glm::vec3 normal;
+                        if (!parse_vec3(line + 3, lineEnd, normal)) {
+                                chunk.failed = true;
+                                return;
+                        }
+                        chunk.normals.push_back(normal);
+                } else if (line[0] == 'f' && is_space(line[1])) {
+                        // polygons are triangulated as a fan while they are
+                        // parsed, so they can have any number of corners
+                        Corner first, previous, corner;
+                        int count = 0;
+                        const char* q = skip_space(line + 2, lineEnd);
+                        while (q < lineEnd) {
+                                q = parse_corner(q, lineEnd, chunk, corner);
+                                if (!q) {
+                                        chunk.failed = true;
+                                        return;
+                                }
+                                if (count == 0) {
+                                        first = corner;
+                                } else if (count >= 2) {
+                                        chunk.corners.push_back(first);
+                                        chunk.corners.push_back(previous);
+                                        chunk.corners.push_back(corner);
+                                }
+                                previous = corner;
+                                count++;
+                                q = skip_space(q, lineEnd);
+                        }
+                }
+                // everything else (vt, o, g, s, usemtl, comments) is ignored
+        }
+}
+
+}
+
+namespace obj {
+
+bool parse(const char* filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+        VfsFile file;
+        if (!Vfs::global().read(filename, file)) {
+                std::cerr << "ERROR: failed to open " << filename << std::endl;
+                return false;
+        }
+        return parse(file.data, file.size, vertices, indices);
+}
+
+bool parse(const uint8_t* data, size_t size, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices)
+{
+        const char* begin = reinterpret_cast<const char*>(data);
+        const char* end = begin + size;
+
+        // at least a megabyte per chunk, small files aren't worth splitting
+        ThreadPool& pool = ThreadPool::global();
+        constexpr size_t MIN_CHUNK_SIZE = 1 << 20;
+        size_t chunkCount = std::clamp<size_t>(size / MIN_CHUNK_SIZE, 1, pool.size() * 4);
+
+        // move every split point forward to the next line start
+        std::vector<const char*> splits { begin };
+        for (size_t i = 1; i < chunkCount; i++) {
+                const char* split = std::max(begin + size * i / chunkCount, splits.back());
+                const char* newline = static_cast<const char*>(std::memchr(split, '\n', end - split));
+                splits.push_back(newline ? newline + 1 : end);
+        }
+        splits.push_back(end);
+
+        std::vector<Chunk> chunks(chunkCount);
+        pool.parallel_for(chunkCount, [&](size_t i) {
+                parse_chunk(splits[i], splits[i + 1], chunks[i]);
+        });
+
+        size_t positionCount = 0, normalCount = 0, cornerCount = 0;
+        std::vector<size_t> positionBase(chunkCount), normalBase(chunkCount);
+        for (size_t i = 0; i < chunkCount; i++) {
+                if (chunks[i].failed) {
+                        std::cerr << "ERROR: malformed obj record" << std::endl;
+                        return false;
+                }
+                positionBase[i] = positionCount;
+                normalBase[i] = normalCount;
+                positionCount += chunks[i].positions.size();
+                normalCount += chunks[i].normals.size();
+                cornerCount += chunks[i].corners.size();
+        }
+
+        std::vector<glm::vec3> positions, normals;
+        positions.reserve(positionCount);
+        normals.reserve(normalCount);
+        for (Chunk& chunk : chunks) {
+                positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+                normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+                chunk.positions = {};
+                chunk.normals = {};
+        }
+
+        // Corners referencing the same position/normal pair share a vertex.
+        // Keying on the indices instead of the values skips hashing floats.
+        vertices.clear();
+        indices.clear();
+        indices.reserve(cornerCount);
+        std::unordered_map<uint64_t, uint32_t> uniqueVertices;
+        uniqueVertices.reserve(cornerCount / 4);
+
+        for (size_t c = 0; c < chunkCount; c++) {
+                for (Corner corner : chunks[c].corners) {
+                        int64_t position = corner.position;
+                        if (corner.flags & POSITION_IN_CHUNK) {
+                                position += positionBase[c];
+                        }
+                        int64_t normal = -1;
+                        if (corner.flags & HAS_NORMAL) {
+                                normal = corner.normal;
+                                if (corner.flags & NORMAL_IN_CHUNK) {
+                                        normal += normalBase[c];
+                                }
+                                if (normal < 0) {
+                                        std::cerr << "ERROR: obj face index out of range" << std::endl;
+                                        return false;
+                                }
+                        }
+
+                        if (position < 0 || position >= static_cast<int64_t>(positionCount) || normal >= static_cast<int64_t>(normalCount)) {
+                                std::cerr << "ERROR: obj face index out of range" << std::endl;
+                                return false;
+                        }
+
+                        uint64_t key = (static_cast<uint64_t>(position) << 32) | static_cast<uint32_t>(normal);
+                        auto [it, inserted] = uniqueVertices.try_emplace(key, static_cast<uint32_t>(vertices.size()));
+                        if (inserted) {
+                                Vertex vertex;
+                                vertex.position = positions[position];
+                                vertex.normals = normal >= 0 ? normals[normal] : glm::vec3(0.0f);
+                                // we are setting the vertex color as the vertex normal. This is just for display purposes
+                                vertex.color = vertex.normals;
+                                vertices.push_back(vertex);
+                        }
+                        indices.push_back(it->second);
+                }
+        }
+
+        return true;
+}
+
+bool write_synthetic(const char* filename, uint32_t gridSize)
+{
+        if (gridSize == 0) {
+                return false;
+        }
+        FILE* file = std::fopen(filename, "wb");
+        if (!file) {
+                return false;
+        }
+
+        for (uint32_t y = 0; y <= gridSize; y++) {
+                for (uint32_t x = 0; x <= gridSize; x++) {
+                        float fx = static_cast<float>(x) / gridSize;
+                        float fy = static_cast<float>(y) / gridSize;
+                        std::fprintf(file, "v %f %f %f\n", fx, std::sin(fx * 6.2831f) * std::cos(fy * 6.2831f) * 0.1f, fy);
+                }
+        }
+        std::fprintf(file, "vn 0.000000 1.000000 0.000000\n");
+
+        const uint32_t row = gridSize + 1;
+        for (uint32_t y = 0; y < gridSize; y++) {
+                for (uint32_t x = 0; x < gridSize; x++) {
+                        uint32_t a = y * row + x + 1;
+                        uint32_t b = a + 1;
+                        uint32_t c = a + row;
+                        uint32_t d = c + 1;
+                        std::fprintf(file, "f %u//1 %u//1 %u//1\nf %u//1 %u//1 %u//1\n", a, c, b, b, c, d);
+                }
+        }
+
+        return std::fclose(file) == 0;
+}
+
+void benchmark(const char* filename, int iterations)
+{
+        iterations = std::max(iterations, 1);
+        MappedFile file;
+        if (!file.open(filename)) {
+                std::cerr << "ERROR: failed to open " << filename << std::endl;
+                return;
+        }
+        const double megabytes = file.size() / (1024.0 * 1024.0);
+
+        auto measure = [&](auto&& load) {
+                double best = 1e30;
+                for (int i = 0; i < iterations; i++) {
+                        auto start = std::chrono::high_resolution_clock::now();
+                        load();
+                        std::chrono::duration<double> elapsed = std::chrono::high_resolution_clock::now() - start;
+                        best = std::min(best, elapsed.count());
+                }
+                return best;
+        };
+
+        size_t tinyobjVertices = 0, parserVertices = 0;
+        double tinyobjTime = measure([&]() {
+                Mesh mesh;
+                mesh.load_from_obj_tinyobj(filename);
+                tinyobjVertices = mesh._vertices.size();
+        });
+        double parserTime = measure([&]() {
+                std::vector<Vertex> vertices;
+                std::vector<uint32_t> indices;
+                parse(filename, vertices, indices);
+                parserVertices = vertices.size();
+        });
+
+        std::printf("%s (%.1f MB)\n", filename, megabytes);
+        std::printf("  tinyobj:   %8.2f ms %8.1f MB/s, %zu vertices\n", tinyobjTime * 1000.0, megabytes / tinyobjTime, tinyobjVertices);
+        std::printf("  obj::parse %8.2f ms %8.1f MB/s, %zu vertices, %u threads\n", parserTime * 1000.0, megabytes / parserTime, parserVertices, ThreadPool::global().size());
+}
+
+}
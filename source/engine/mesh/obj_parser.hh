@@ -0,0 +1,24 @@
+#pragma once
+
+#include "mesh.hh"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// In-tree obj reader used instead of tinyobj. The file is mapped, split into
+// line aligned chunks and the v/vn/f records of every chunk are parsed on the
+// thread pool, the results are then merged into indexed vertices.
+namespace obj {
+
+bool parse(const char* filename, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+bool parse(const uint8_t* data, size_t size, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices);
+
+// Writes a grid of gridSize * gridSize quads (two triangles each) with normals.
+// False for an empty grid.
+bool write_synthetic(const char* filename, uint32_t gridSize);
+
+// Prints the MB/s of the tinyobj loader and of obj::parse on the given file.
+void benchmark(const char* filename, int iterations = 5);
+
+}
@@ -0,0 +1,326 @@
+#include "optimize.hh"
+#include "mesh.hh"
+
+#include <algorithm>
+#include <cmath>
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t indexCount, size_t vertexCount, size_t cacheSize)
+{
+        VertexCacheStats stats { 0.0f, 0.0f };
+        if (indexCount < 3 || vertexCount == 0) {
+                return stats;
+        }
+
+        // timestamp of when every vertex entered the cache
+        std::vector<size_t> cachedAt(vertexCount, 0);
+        size_t time = cacheSize + 1;
+        size_t misses = 0;
+
+        for (size_t i = 0; i < indexCount; i++) {
+                uint32_t index = indices[i];
+                if (time - cachedAt[index] > cacheSize) {
+                        cachedAt[index] = time++;
+                        misses++;
+                }
+        }
+
+        stats.acmr = static_cast<float>(misses) / (indexCount / 3);
+        stats.atvr = static_cast<float>(misses) / vertexCount;
+        return stats;
+}
+
+namespace {
+
+constexpr size_t SCORE_CACHE_SIZE = 32;
+constexpr float CACHE_DECAY_POWER = 1.5f;
+constexpr float LAST_TRIANGLE_SCORE = 0.75f;
+constexpr float VALENCE_BOOST_SCALE = 2.0f;
+constexpr float VALENCE_BOOST_POWER = 0.5f;
+
+float vertex_score(int cachePosition, uint32_t remainingTriangles)
+{
+        if (remainingTriangles == 0) {
+                return -1.0f;
+        }
+
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+                if (cachePosition < 3) {
+                        // the vertices of the last triangle get a fixed score so
+                        // the next triangle doesn't just reuse the same edge
+                        score = LAST_TRIANGLE_SCORE;
+                } else {
+                        float scaler = 1.0f / (SCORE_CACHE_SIZE - 3);
+                        score = std::pow(1.0f - (cachePosition - 3) * scaler, CACHE_DECAY_POWER);
+                }
+        }
+
+        // prefer vertices with few triangles left so they don't get stranded
+        score += VALENCE_BOOST_SCALE * std::pow(static_cast<float>(remainingTriangles), -VALENCE_BOOST_POWER);
+        return score;
+}
+
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+{
+        const size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0) {
+                return;
+        }
+
+        // triangles around every vertex
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+                offsets[indices[i] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+                offsets[v + 1] += offsets[v];
+        }
+        std::vector<uint32_t> adjacency(triangleCount * 3);
+        std::vector<uint32_t> remaining(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+                uint32_t v = indices[i];
+                adjacency[offsets[v] + remaining[v]++] = static_cast<uint32_t>(i / 3);
+        }
+
+        std::vector<int> cachePosition(vertexCount, -1);
+        std::vector<float> vertexScores(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++) {
+                vertexScores[v] = vertex_score(-1, remaining[v]);
+        }
+
+        std::vector<float> triangleScores(triangleCount);
+        std::vector<bool> emitted(triangleCount, false);
+        for (size_t t = 0; t < triangleCount; t++) {
+                triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+        }
+
+        std::vector<uint32_t> output;
+        output.reserve(triangleCount * 3);
+
+        // LRU cache, three extra slots for the vertices pushed out by a triangle
+        uint32_t cache[SCORE_CACHE_SIZE + 3];
+        size_t cacheCount = 0;
+
+        size_t fallbackCursor = 0;
+        int64_t bestTriangle = -1;
+        float bestScore = -1.0f;
+        for (size_t t = 0; t < triangleCount; t++) {
+                if (triangleScores[t] > bestScore) {
+                        bestScore = triangleScores[t];
+                        bestTriangle = t;
+                }
+        }
+
+        while (bestTriangle >= 0) {
+                const uint32_t* triangle = &indices[bestTriangle * 3];
+                output.insert(output.end(), triangle, triangle + 3);
+                emitted[bestTriangle] = true;
+
+                // move the triangle's vertices to the front of the cache
+                uint32_t newCache[SCORE_CACHE_SIZE + 3];
+                size_t newCount = 0;
+                for (int c = 0; c < 3; c++) {
+                        newCache[newCount++] = triangle[c];
+                }
+                for (size_t i = 0; i < cacheCount; i++) {
+                        uint32_t v = cache[i];
+                        if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                                newCache[newCount++] = v;
+                        }
+                }
+
+                // the triangle is no longer pending for its vertices
+                for (int c = 0; c < 3; c++) {
+                        uint32_t v = triangle[c];
+                        uint32_t* begin = &adjacency[offsets[v]];
+                        uint32_t* end = begin + remaining[v];
+                        uint32_t* it = std::find(begin, end, static_cast<uint32_t>(bestTriangle));
+                        if (it != end) {
+                                std::swap(*it, *(end - 1));
+                                remaining[v]--;
+                        }
+                }
+
+                // rescore everything in the cache, including the vertices that
+                // just fell out of it
+                for (size_t i = 0; i < newCount; i++) {
+                        uint32_t v = newCache[i];
+                        cachePosition[v] = i < SCORE_CACHE_SIZE ? static_cast<int>(i) : -1;
+                        float score = vertex_score(cachePosition[v], remaining[v]);
+                        float delta = score - vertexScores[v];
+                        vertexScores[v] = score;
+                        for (uint32_t k = offsets[v]; k < offsets[v] + remaining[v]; k++) {
+                                triangleScores[adjacency[k]] += delta;
+                        }
+                }
+
+                cacheCount = std::min(newCount, SCORE_CACHE_SIZE);
+                std::copy(newCache, newCache + cacheCount, cache);
+
+                // the next triangle is the best one touching the cache
+                bestTriangle = -1;
+                bestScore = -1.0f;
+                for (size_t i = 0; i < cacheCount; i++) {
+                        uint32_t v = cache[i];
+                        for (uint32_t k = offsets[v]; k < offsets[v] + remaining[v]; k++) {
+                                uint32_t t = adjacency[k];
+                                if (triangleScores[t] > bestScore) {
+                                        bestScore = triangleScores[t];
+                                        bestTriangle = t;
+                                }
+                        }
+                }
+
+                // nothing left around the cache, continue at the next
+                // triangle that hasn't been emitted yet
+                if (bestTriangle < 0) {
+                        while (fallbackCursor < triangleCount && emitted[fallbackCursor]) {
+                                fallbackCursor++;
+                        }
+                        if (fallbackCursor < triangleCount) {
+                                bestTriangle = fallbackCursor;
+                        }
+                }
+        }
+
+        std::copy(output.begin(), output.end(), indices);
+}
+
+void optimize_overdraw(uint32_t* indices, size_t indexCount, const std::vector<Vertex>& vertices, float threshold)
+{
+        const size_t triangleCount = indexCount / 3;
+        if (triangleCount == 0) {
+                return;
+        }
+
+        // Hard boundaries: triangles where all three vertices miss the cache,
+        // the cache effectively starts over there so cutting costs nothing.
+        // Both passes share the timestamps, moving time on by more than the
+        // cache size makes every older stamp a miss without clearing them.
+        std::vector<size_t> cachedAt(vertices.size(), 0);
+        size_t time = VERTEX_CACHE_SIZE + 1;
+        std::vector<uint32_t> clusterStarts;
+        for (size_t t = 0; t < triangleCount; t++) {
+                int misses = 0;
+                for (int c = 0; c < 3; c++) {
+                        uint32_t index = indices[t * 3 + c];
+                        if (time - cachedAt[index] > VERTEX_CACHE_SIZE) {
+                                cachedAt[index] = time++;
+                                misses++;
+                        }
+                }
+                if (misses == 3 || t == 0) {
+                        clusterStarts.push_back(static_cast<uint32_t>(t));
+                }
+        }
+
+        // Soft boundaries: split the hard clusters further as long as every
+        // piece on its own stays within threshold of the overall ACMR.
+        const float targetAcmr = analyze_vertex_cache(indices, indexCount, vertices.size()).acmr * threshold;
+        std::vector<uint32_t> clusters;
+        for (size_t c = 0; c < clusterStarts.size(); c++) {
+                uint32_t begin = clusterStarts[c];
+                uint32_t end = c + 1 < clusterStarts.size() ? clusterStarts[c + 1] : static_cast<uint32_t>(triangleCount);
+                clusters.push_back(begin);
+
+                time += VERTEX_CACHE_SIZE + 1;
+                size_t misses = 0;
+                uint32_t pieceStart = begin;
+                for (uint32_t t = begin; t < end; t++) {
+                        for (int k = 0; k < 3; k++) {
+                                uint32_t index = indices[t * 3 + k];
+                                if (time - cachedAt[index] > VERTEX_CACHE_SIZE) {
+                                        cachedAt[index] = time++;
+                                        misses++;
+                                }
+                        }
+                        uint32_t pieceTriangles = t - pieceStart + 1;
+                        // small pieces aren't worth sorting separately
+                        if (pieceTriangles >= 32 && t + 1 < end && static_cast<float>(misses) / pieceTriangles <= targetAcmr) {
+                                clusters.push_back(t + 1);
+                                pieceStart = t + 1;
+                                misses = 0;
+                                time += VERTEX_CACHE_SIZE + 1;
+                        }
+                }
+        }
+
+        // mesh centroid, area weighted
+        glm::vec3 meshCentroid { 0.0f };
+        float meshArea = 0.0f;
+        for (size_t t = 0; t < triangleCount; t++) {
+                const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+                const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+                const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+                float area = glm::length(glm::cross(p1 - p0, p2 - p0));
+                meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+                meshArea += area;
+        }
+        if (meshArea > 0.0f) {
+                meshCentroid /= meshArea;
+        }
+
+        // clusters facing away from the centroid are likely to occlude the
+        // others, so they are drawn first
+        struct SortKey {
+                float key;
+                uint32_t cluster;
+        };
+        std::vector<SortKey> keys(clusters.size());
+        for (size_t c = 0; c < clusters.size(); c++) {
+                uint32_t begin = clusters[c];
+                uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(triangleCount);
+
+                glm::vec3 centroid { 0.0f }, normal { 0.0f };
+                float area = 0.0f;
+                for (uint32_t t = begin; t < end; t++) {
+                        const glm::vec3& p0 = vertices[indices[t * 3 + 0]].position;
+                        const glm::vec3& p1 = vertices[indices[t * 3 + 1]].position;
+                        const glm::vec3& p2 = vertices[indices[t * 3 + 2]].position;
+                        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+                        float a = glm::length(n);
+                        centroid += (p0 + p1 + p2) * (a / 3.0f);
+                        normal += n;
+                        area += a;
+                }
+                if (area > 0.0f) {
+                        centroid /= area;
+                }
+                float normalLength = glm::length(normal);
+                if (normalLength > 0.0f) {
+                        normal /= normalLength;
+                }
+                keys[c] = { glm::dot(centroid - meshCentroid, normal), static_cast<uint32_t>(c) };
+        }
+        std::stable_sort(keys.begin(), keys.end(), [](const SortKey& l, const SortKey& r) { return l.key > r.key; });
+
+        std::vector<uint32_t> output;
+        output.reserve(triangleCount * 3);
+        for (const SortKey& key : keys) {
+                uint32_t begin = clusters[key.cluster];
+                uint32_t end = key.cluster + 1 < clusters.size() ? clusters[key.cluster + 1] : static_cast<uint32_t>(triangleCount);
+                output.insert(output.end(), indices + begin * 3, indices + end * 3);
+        }
+        std::copy(output.begin(), output.end(), indices);
+}
+
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, uint32_t* indices, size_t indexCount)
+{
+        std::vector<uint32_t> remap(vertices.size(), UINT32_MAX);
+        std::vector<Vertex> reordered;
+        reordered.reserve(vertices.size());
+
+        for (size_t i = 0; i < indexCount; i++) {
+                uint32_t& index = indices[i];
+                if (remap[index] == UINT32_MAX) {
+                        remap[index] = static_cast<uint32_t>(reordered.size());
+                        reordered.push_back(vertices[index]);
+                }
+                index = remap[index];
+        }
+
+        // vertices no index refers to are dropped
+        vertices = std::move(reordered);
+}
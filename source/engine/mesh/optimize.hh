@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+// Post-transform cache efficiency of an index buffer, simulated with a FIFO
+// cache. ACMR = vertex shader invocations per triangle (0.5 is ideal for a
+// regular grid, 3 is no reuse at all), ATVR = invocations per vertex (1 is
+// ideal).
+struct VertexCacheStats {
+        float acmr;
+        float atvr;
+};
+
+constexpr size_t VERTEX_CACHE_SIZE = 16;
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t indexCount, size_t vertexCount,
+        size_t cacheSize = VERTEX_CACHE_SIZE);
+
+// Reorders triangles for the post-transform cache (Tom Forsyth's linear speed
+// vertex cache optimization).
+void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount);
+
+// Splits the cache optimized order into clusters where the cache restarts
+// anyway and sorts those so the outward facing ones come first, which lets
+// the depth test reject more of the rest (Tipsify style). threshold is how
+// much the ACMR may grow to get more clusters.
+void optimize_overdraw(uint32_t* indices, size_t indexCount, const std::vector<Vertex>& vertices, float threshold = 1.05f);
+
+// Reorders the vertices into first use order so vertex fetches walk memory
+// linearly, the indices are remapped to match.
+void optimize_vertex_fetch(std::vector<Vertex>& vertices, uint32_t* indices, size_t indexCount);
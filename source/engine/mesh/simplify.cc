@@ -0,0 +1,340 @@
+#include "simplify.hh"
+#include "mesh.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// symmetric 4x4 matrix, upper triangle
+struct Quadric {
+        double a00 = 0, a01 = 0, a02 = 0, a03 = 0;
+        double a11 = 0, a12 = 0, a13 = 0;
+        double a22 = 0, a23 = 0;
+        double a33 = 0;
+        // total area of the planes, turns the sum back into a distance
+        double weight = 0;
+
+        void add(const Quadric& q)
+        {
+                a00 += q.a00;
+                a01 += q.a01;
+                a02 += q.a02;
+                a03 += q.a03;
+                a11 += q.a11;
+                a12 += q.a12;
+                a13 += q.a13;
+                a22 += q.a22;
+                a23 += q.a23;
+                a33 += q.a33;
+                weight += q.weight;
+        }
+
+        // squared distance of p to the planes, weighted
+        double evaluate(const glm::vec3& p) const
+        {
+                double x = p.x, y = p.y, z = p.z;
+                double result = a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x
+                        + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y
+                        + a22 * z * z + 2 * a23 * z
+                        + a33;
+                return std::max(result, 0.0);
+        }
+
+        // mean squared distance of p to the planes
+        double error(const glm::vec3& p) const
+        {
+                return weight > 0.0 ? evaluate(p) / weight : 0.0;
+        }
+
+        static Quadric plane(double a, double b, double c, double d, double weight)
+        {
+                Quadric q;
+                q.a00 = weight * a * a;
+                q.a01 = weight * a * b;
+                q.a02 = weight * a * c;
+                q.a03 = weight * a * d;
+                q.a11 = weight * b * b;
+                q.a12 = weight * b * c;
+                q.a13 = weight * b * d;
+                q.a22 = weight * c * c;
+                q.a23 = weight * c * d;
+                q.a33 = weight * d * d;
+                q.weight = weight;
+                return q;
+        }
+};
+
+struct Collapse {
+        uint32_t from;
+        uint32_t to;
+        double cost;
+};
+
+uint32_t resolve(std::vector<uint32_t>& remap, uint32_t v)
+{
+        while (remap[v] != v) {
+                remap[v] = remap[remap[v]];
+                v = remap[v];
+        }
+        return v;
+}
+
+// how different the attributes of two vertices are
+float attribute_distance(const Vertex& a, const Vertex& b)
+{
+        glm::vec3 normal = a.normals - b.normals;
+        glm::vec3 color = a.color - b.color;
+        return glm::dot(normal, normal) + glm::dot(color, color);
+}
+
+}
+
+std::vector<uint32_t> simplify_mesh(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount,
+        size_t targetIndexCount, float& error)
+{
+        error = 0.0f;
+        const size_t vertexCount = vertices.size();
+
+        // weld vertices that only differ in their attributes, the first vertex
+        // with a position stands in for all of them
+        std::vector<uint32_t> remap(vertexCount);
+        {
+                struct PositionHash {
+                        size_t operator()(const glm::vec3& p) const
+                        {
+                                uint32_t bits[3];
+                                std::memcpy(bits, &p, sizeof(bits));
+                                return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+                        }
+                };
+                std::unordered_map<glm::vec3, uint32_t, PositionHash> positions;
+                positions.reserve(vertexCount);
+                for (uint32_t v = 0; v < vertexCount; v++) {
+                        remap[v] = positions.try_emplace(vertices[v].position, v).first->second;
+                }
+        }
+
+        // the vertices welded into every position, so a corner that moves to
+        // another position can pick the one with its own attributes there
+        std::vector<uint32_t> weldOffsets(vertexCount + 1, 0);
+        std::vector<uint32_t> welded(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+                weldOffsets[remap[v] + 1]++;
+        }
+        for (size_t v = 0; v < vertexCount; v++) {
+                weldOffsets[v + 1] += weldOffsets[v];
+        }
+        {
+                std::vector<uint32_t> fill(weldOffsets.begin(), weldOffsets.end() - 1);
+                for (uint32_t v = 0; v < vertexCount; v++) {
+                        welded[fill[remap[v]]++] = v;
+                }
+        }
+        auto closest_vertex = [&](uint32_t corner, uint32_t position) {
+                uint32_t best = welded[weldOffsets[position]];
+                float bestDistance = INFINITY;
+                for (uint32_t k = weldOffsets[position]; k < weldOffsets[position + 1]; k++) {
+                        float distance = attribute_distance(vertices[corner], vertices[welded[k]]);
+                        if (distance < bestDistance) {
+                                best = welded[k];
+                                bestDistance = distance;
+                        }
+                }
+                return best;
+        };
+
+        // The welded positions are only used for the adjacency, the quadrics
+        // and the collapses. corners keeps the vertex every corner of result
+        // is drawn with, so normal and color seams survive.
+        std::vector<uint32_t> result(indexCount);
+        std::vector<uint32_t> corners(indices, indices + indexCount);
+        for (size_t i = 0; i < indexCount; i++) {
+                result[i] = remap[indices[i]];
+        }
+
+        // quadrics of the planes around every vertex, area weighted
+        std::vector<Quadric> quadrics(vertexCount);
+        for (size_t i = 0; i + 2 < result.size(); i += 3) {
+                const glm::vec3& p0 = vertices[result[i + 0]].position;
+                const glm::vec3& p1 = vertices[result[i + 1]].position;
+                const glm::vec3& p2 = vertices[result[i + 2]].position;
+                glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+                float length = glm::length(normal);
+                if (length == 0.0f) {
+                        continue;
+                }
+                normal /= length;
+                Quadric q = Quadric::plane(normal.x, normal.y, normal.z, -glm::dot(normal, p0), length * 0.5);
+                for (int c = 0; c < 3; c++) {
+                        quadrics[result[i + c]].add(q);
+                }
+        }
+
+        // vertices on an open edge (used by one triangle only) never move
+        std::vector<bool> locked(vertexCount, false);
+        {
+                std::unordered_map<uint64_t, uint32_t> edges;
+                edges.reserve(result.size());
+                for (size_t i = 0; i + 2 < result.size(); i += 3) {
+                        for (int e = 0; e < 3; e++) {
+                                uint32_t a = result[i + e], b = result[i + (e + 1) % 3];
+                                uint64_t key = (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+                                edges[key]++;
+                        }
+                }
+                for (const auto& [key, count] : edges) {
+                        if (count == 1) {
+                                locked[key >> 32] = true;
+                                locked[key & 0xffffffff] = true;
+                        }
+                }
+        }
+
+        // Positions welded from several vertices are on a seam, their
+        // attributes differ between the sides. They only move along the seam,
+        // otherwise the triangles of one side would spread over the other.
+        auto can_move = [&](uint32_t from, uint32_t to) {
+                const bool seam = weldOffsets[from + 1] - weldOffsets[from] > 1;
+                return !locked[from] && (!seam || weldOffsets[to + 1] - weldOffsets[to] > 1);
+        };
+
+        std::vector<uint32_t> collapseRemap(vertexCount);
+        for (uint32_t v = 0; v < vertexCount; v++) {
+                collapseRemap[v] = v;
+        }
+
+        std::vector<Collapse> collapses;
+        std::vector<bool> touched(vertexCount);
+        // triangles around every vertex, rebuilt each pass
+        std::vector<uint32_t> triangleOffsets(vertexCount + 1);
+        std::vector<uint32_t> vertexTriangles;
+        double maxCost = 0.0;
+
+        while (result.size() > targetIndexCount) {
+                const size_t triangleCount = result.size() / 3;
+
+                std::fill(triangleOffsets.begin(), triangleOffsets.end(), 0);
+                for (uint32_t index : result) {
+                        triangleOffsets[index + 1]++;
+                }
+                for (size_t v = 0; v < vertexCount; v++) {
+                        triangleOffsets[v + 1] += triangleOffsets[v];
+                }
+                vertexTriangles.resize(result.size());
+                {
+                        std::vector<uint32_t> fill(triangleOffsets.begin(), triangleOffsets.end() - 1);
+                        for (size_t i = 0; i < result.size(); i++) {
+                                vertexTriangles[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+                        }
+                }
+
+                // cheapest direction of every edge
+                collapses.clear();
+                for (size_t t = 0; t < triangleCount; t++) {
+                        for (int e = 0; e < 3; e++) {
+                                uint32_t a = result[t * 3 + e], b = result[t * 3 + (e + 1) % 3];
+                                // every interior edge shows up twice, keep one
+                                if (a > b) {
+                                        continue;
+                                }
+                                Quadric q = quadrics[a];
+                                q.add(quadrics[b]);
+                                double costAB = can_move(a, b) ? q.error(vertices[b].position) : INFINITY;
+                                double costBA = can_move(b, a) ? q.error(vertices[a].position) : INFINITY;
+                                if (std::isinf(costAB) && std::isinf(costBA)) {
+                                        continue;
+                                }
+                                if (costAB <= costBA) {
+                                        collapses.push_back({ a, b, costAB });
+                                } else {
+                                        collapses.push_back({ b, a, costBA });
+                                }
+                        }
+                }
+                if (collapses.empty()) {
+                        break;
+                }
+                std::sort(collapses.begin(), collapses.end(), [](const Collapse& l, const Collapse& r) { return l.cost < r.cost; });
+
+                // every collapse removes about two triangles
+                size_t budget = (result.size() - targetIndexCount) / 6 + 1;
+                size_t performed = 0;
+                std::fill(touched.begin(), touched.end(), false);
+
+                for (const Collapse& collapse : collapses) {
+                        if (performed >= budget) {
+                                break;
+                        }
+                        if (touched[collapse.from] || touched[collapse.to]) {
+                                continue;
+                        }
+
+                        // reject the collapse if a triangle around the moving
+                        // vertex would flip over
+                        const glm::vec3& target = vertices[collapse.to].position;
+                        bool flips = false;
+                        for (uint32_t k = triangleOffsets[collapse.from]; k < triangleOffsets[collapse.from + 1] && !flips; k++) {
+                                const uint32_t* triangle = &result[vertexTriangles[k] * 3];
+                                if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                                        continue;
+                                }
+                                glm::vec3 p[3], moved[3];
+                                for (int c = 0; c < 3; c++) {
+                                        p[c] = vertices[triangle[c]].position;
+                                        moved[c] = triangle[c] == collapse.from ? target : p[c];
+                                }
+                                glm::vec3 before = glm::cross(p[1] - p[0], p[2] - p[0]);
+                                glm::vec3 after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+                                flips = glm::dot(before, after) <= 0.0f;
+                        }
+                        if (flips) {
+                                continue;
+                        }
+
+                        collapseRemap[collapse.from] = collapse.to;
+                        quadrics[collapse.to].add(quadrics[collapse.from]);
+                        maxCost = std::max(maxCost, collapse.cost);
+
+                        // the triangles around both vertices changed, keep them
+                        // out of this pass
+                        for (uint32_t v : { collapse.from, collapse.to }) {
+                                for (uint32_t k = triangleOffsets[v]; k < triangleOffsets[v + 1]; k++) {
+                                        const uint32_t* triangle = &result[vertexTriangles[k] * 3];
+                                        touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+                                }
+                        }
+                        performed++;
+                }
+
+                if (performed == 0) {
+                        break;
+                }
+
+                // apply the collapses and drop the triangles that degenerated,
+                // the corners that moved take the closest vertex of their
+                // new position
+                size_t write = 0;
+                for (size_t i = 0; i + 2 < result.size(); i += 3) {
+                        uint32_t moved[3];
+                        for (int c = 0; c < 3; c++) {
+                                moved[c] = resolve(collapseRemap, result[i + c]);
+                        }
+                        if (moved[0] == moved[1] || moved[1] == moved[2] || moved[0] == moved[2]) {
+                                continue;
+                        }
+                        for (int c = 0; c < 3; c++) {
+                                corners[write] = moved[c] == result[i + c] ? corners[i + c] : closest_vertex(corners[i + c], moved[c]);
+                                result[write++] = moved[c];
+                        }
+                }
+                result.resize(write);
+                corners.resize(write);
+        }
+
+        error = static_cast<float>(std::sqrt(maxCost));
+
+        return corners;
+}
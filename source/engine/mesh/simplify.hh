@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+// Quadric error metric simplification (Garland & Heckbert) by collapsing
+// edges onto existing vertices, so the result indexes the same vertex buffer.
+// Vertices sharing a position are welded while simplifying, open borders are
+// kept in place and seams only move along the seam. Every corner keeps its
+// own vertex, or the one with the closest normal and color at the position
+// it collapsed to. Returns the new index list, error receives the largest
+// collapse error as a distance in model units.
+std::vector<uint32_t> simplify_mesh(const std::vector<Vertex>& vertices, const uint32_t* indices, size_t indexCount,
+        size_t targetIndexCount, float& error);
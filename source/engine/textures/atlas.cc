@@ -0,0 +1,404 @@
+#include "atlas.hh"
+#include "hash.hh"
+#include "json.hh"
+#include "mapped_file.hh"
+#include "texture_cook.hh"
+#include "thread_pool.hh"
+#include "vfs.hh"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <numeric>
+#include <sstream>
+
+// the implementation lives with the texture cooking
+#include <stb_image.h>
+
+namespace atlas {
+
+namespace {
+
+uint32_t align(uint32_t value, uint32_t alignment)
+{
+        return (value + alignment - 1) / alignment * alignment;
+}
+
+struct Source {
+        size_t index;
+        uint32_t width;
+        uint32_t height;
+        std::vector<uint8_t> pixels;
+        bool opaque;
+};
+
+// The texels of every member with their borders, the border repeats the
+// texture like the sampler would. It covers the whole aligned cell, whatever
+// is left of it would end up in the smaller levels of the member otherwise.
+// The rest stays transparent black, or opaque black so opaque pages stay BC1.
+std::vector<uint8_t> compose(const std::vector<const Source*>& sources, const std::vector<Rect>& rects, const Rect& size, bool opaque)
+{
+        std::vector<uint8_t> page(size_t(size.width) * size.height * 4, 0);
+        if (opaque) {
+                for (size_t i = 3; i < page.size(); i += 4) {
+                        page[i] = 255;
+                }
+        }
+
+        const int32_t border = static_cast<int32_t>(ATLAS_PADDING);
+        ThreadPool::global().parallel_for(sources.size(), [&](size_t i) {
+                const Source& source = *sources[i];
+                const Rect& rect = rects[i];
+                const int32_t width = static_cast<int32_t>(source.width);
+                const int32_t height = static_cast<int32_t>(source.height);
+                const int32_t cellWidth = static_cast<int32_t>(align(source.width + 2 * ATLAS_PADDING, ATLAS_PADDING));
+                const int32_t cellHeight = static_cast<int32_t>(align(source.height + 2 * ATLAS_PADDING, ATLAS_PADDING));
+                for (int32_t y = -border; y < cellHeight - border; y++) {
+                        const int32_t sourceY = (y % height + height) % height;
+                        uint8_t* row = page.data() + ((rect.y + y) * size_t(size.width) + rect.x) * 4;
+                        for (int32_t x = -border; x < cellWidth - border; x++) {
+                                const int32_t sourceX = (x % width + width) % width;
+                                const uint8_t* texel = source.pixels.data() + (size_t(sourceY) * width + sourceX) * 4;
+                                std::copy(texel, texel + 4, row + x * 4);
+                        }
+                }
+        });
+        return page;
+}
+
+std::string page_file(const std::vector<uint8_t>& pixels, const Rect& size, bool compressed)
+{
+        const uint32_t settings[] = { VERSION, texture_cook::VERSION, size.width, size.height, compressed };
+        const uint64_t key = hash64(settings, sizeof(settings), hash64(pixels.data(), pixels.size()));
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016" PRIx64 ".ktx2", key);
+        return name;
+}
+
+// a whole number of at most ATLAS_MAX_SIZE, which nothing in a page exceeds
+bool read_size(const json::Value& value, const char* key, uint32_t& size)
+{
+        const double number = value.number(key, -1.0);
+        if (!(number >= 0.0 && number <= ATLAS_MAX_SIZE) || number != static_cast<uint32_t>(number)) {
+                return false;
+        }
+        size = static_cast<uint32_t>(number);
+        return true;
+}
+
+void write_string(std::ostream& out, const std::string& value)
+{
+        out << '"';
+        for (char c : value) {
+                if (c == '"' || c == '\\') {
+                        out << '\\';
+                }
+                out << c;
+        }
+        out << '"';
+}
+
+}
+
+bool pack(const std::vector<Rect>& sizes, uint32_t padding, uint32_t maxSize, std::vector<Rect>& rects, std::vector<uint32_t>& pages,
+        std::vector<Rect>& pageSizes)
+{
+        rects.assign(sizes.size(), Rect {});
+        pages.assign(sizes.size(), UINT32_MAX);
+        pageSizes.clear();
+
+        // the cells the textures take with their borders
+        std::vector<Rect> cells(sizes.size());
+        for (size_t i = 0; i < sizes.size(); i++) {
+                cells[i].width = align(sizes[i].width + 2 * padding, padding);
+                cells[i].height = align(sizes[i].height + 2 * padding, padding);
+                if (cells[i].width > maxSize || cells[i].height > maxSize) {
+                        return false;
+                }
+        }
+
+        std::vector<size_t> remaining(sizes.size());
+        std::iota(remaining.begin(), remaining.end(), 0);
+        std::sort(remaining.begin(), remaining.end(), [&](size_t l, size_t r) {
+                return cells[l].height != cells[r].height ? cells[l].height > cells[r].height : cells[l].width > cells[r].width;
+        });
+
+        while (!remaining.empty()) {
+                // start at the square the remaining cells would fill
+                uint64_t area = 0;
+                uint32_t widest = 0;
+                for (size_t i : remaining) {
+                        area += uint64_t(cells[i].width) * cells[i].height;
+                        widest = std::max(widest, cells[i].width);
+                }
+                uint32_t pageSize = std::max(std::bit_ceil(widest), 1u);
+                while (pageSize < maxSize && uint64_t(pageSize) * pageSize < area) {
+                        pageSize *= 2;
+                }
+
+                std::vector<size_t> placed, left;
+                uint32_t usedHeight = 0;
+                while (true) {
+                        placed.clear();
+                        left.clear();
+                        uint32_t x = 0, y = 0, shelfHeight = 0;
+                        for (size_t i : remaining) {
+                                if (x + cells[i].width > pageSize) {
+                                        y += shelfHeight;
+                                        x = 0;
+                                        shelfHeight = 0;
+                                }
+                                if (y + cells[i].height > pageSize) {
+                                        left.push_back(i);
+                                        continue;
+                                }
+                                rects[i] = { x + padding, y + padding, sizes[i].width, sizes[i].height };
+                                x += cells[i].width;
+                                shelfHeight = std::max(shelfHeight, cells[i].height);
+                                placed.push_back(i);
+                        }
+                        usedHeight = y + shelfHeight;
+                        // shelves waste some space, the square may be too small
+                        if (left.empty() || pageSize >= maxSize) {
+                                break;
+                        }
+                        pageSize *= 2;
+                }
+
+                // the last page is often only partly used
+                const uint32_t page = static_cast<uint32_t>(pageSizes.size());
+                pageSizes.push_back({ 0, 0, pageSize, std::bit_ceil(usedHeight) });
+                for (size_t i : placed) {
+                        pages[i] = page;
+                }
+                remaining.swap(left);
+        }
+        return true;
+}
+
+bool bake(const std::vector<std::string>& sources, const std::vector<std::string>& names, const std::string& directory, Manifest& manifest)
+{
+        // only the headers of the big ones are read, the small ones are
+        // hashed for the key
+        std::vector<VfsFile> files(sources.size());
+        std::vector<uint64_t> hashes(sources.size(), 0);
+        ThreadPool::global().parallel_for(sources.size(), [&](size_t i) {
+                VfsFile file;
+                int width, height, channels;
+                if (!Vfs::global().read(sources[i].c_str(), file) || file.size > INT_MAX
+                        || !stbi_info_from_memory(file.data, static_cast<int>(file.size), &width, &height, &channels)
+                        || static_cast<uint32_t>(std::max(width, height)) > ATLAS_MAX_TEXTURE_SIZE) {
+                        return;
+                }
+                hashes[i] = hash64(file.data, file.size);
+                files[i] = std::move(file);
+        });
+
+        const uint32_t settings[] = { VERSION, texture_cook::VERSION, ATLAS_MAX_TEXTURE_SIZE, ATLAS_MAX_SIZE, ATLAS_PADDING };
+        uint64_t key = hash64(settings, sizeof(settings));
+        for (size_t i = 0; i < sources.size(); i++) {
+                if (files[i].data) {
+                        key = hash64(names[i].data(), names[i].size(), key);
+                        key = hash64(&hashes[i], sizeof(hashes[i]), key);
+                }
+        }
+
+        // the pages of the last bake are still good when nothing changed
+        const std::filesystem::path manifestPath = std::filesystem::path(directory) / ATLAS_MANIFEST;
+        if (read_manifest(manifestPath.string().c_str(), manifest) && manifest.key == key) {
+                std::error_code error;
+                bool complete = true;
+                for (const Page& page : manifest.pages) {
+                        complete = complete && std::filesystem::exists(std::filesystem::path(directory) / page.compressedFile, error)
+                                && std::filesystem::exists(std::filesystem::path(directory) / page.uncompressedFile, error);
+                }
+                if (complete) {
+                        return true;
+                }
+        }
+        manifest.pages.clear();
+        manifest.key = key;
+
+        std::vector<Source> decoded(sources.size());
+        std::vector<uint8_t> small(sources.size(), 0);
+        ThreadPool::global().parallel_for(sources.size(), [&](size_t i) {
+                const VfsFile& file = files[i];
+                if (!file.data) {
+                        return;
+                }
+                int width, height, channels;
+                stbi_uc* pixels = stbi_load_from_memory(file.data, static_cast<int>(file.size), &width, &height, &channels, STBI_rgb_alpha);
+                if (!pixels) {
+                        return;
+                }
+
+                Source& source = decoded[i];
+                source.index = i;
+                source.width = static_cast<uint32_t>(width);
+                source.height = static_cast<uint32_t>(height);
+                source.pixels.assign(pixels, pixels + size_t(width) * height * 4);
+                stbi_image_free(pixels);
+                source.opaque = true;
+                for (size_t texel = 3; texel < source.pixels.size() && source.opaque; texel += 4) {
+                        source.opaque = source.pixels[texel] == 255;
+                }
+                small[i] = 1;
+        });
+
+        // opaque pages become BC1, the others BC7, so those are the formats
+        struct PendingPage {
+                Page page;
+                std::vector<uint8_t> pixels;
+        };
+        std::vector<PendingPage> pending;
+        for (bool opaque : { true, false }) {
+                std::vector<const Source*> group;
+                std::vector<Rect> sizes;
+                for (size_t i = 0; i < sources.size(); i++) {
+                        if (small[i] && decoded[i].opaque == opaque) {
+                                group.push_back(&decoded[i]);
+                                sizes.push_back({ 0, 0, decoded[i].width, decoded[i].height });
+                        }
+                }
+                // a single texture gains nothing from a page
+                if (group.size() < 2) {
+                        continue;
+                }
+
+                std::vector<Rect> rects, pageSizes;
+                std::vector<uint32_t> pages;
+                if (!pack(sizes, ATLAS_PADDING, ATLAS_MAX_SIZE, rects, pages, pageSizes)) {
+                        return false;
+                }
+                for (uint32_t page = 0; page < pageSizes.size(); page++) {
+                        std::vector<const Source*> members;
+                        std::vector<Rect> memberRects;
+                        PendingPage& out = pending.emplace_back();
+                        out.page.width = pageSizes[page].width;
+                        out.page.height = pageSizes[page].height;
+                        out.page.opaque = opaque;
+                        for (size_t i = 0; i < group.size(); i++) {
+                                if (pages[i] == page) {
+                                        members.push_back(group[i]);
+                                        memberRects.push_back(rects[i]);
+                                        out.page.members.push_back({ names[group[i]->index], rects[i] });
+                                }
+                        }
+                        out.pixels = compose(members, memberRects, pageSizes[page], opaque);
+                        out.page.compressedFile = page_file(out.pixels, pageSizes[page], true);
+                        out.page.uncompressedFile = page_file(out.pixels, pageSizes[page], false);
+                }
+        }
+
+        // both flavors of every page, the compression goes wide inside too
+        std::atomic<bool> cooked { true };
+        ThreadPool::global().parallel_for(pending.size() * 2, [&](size_t job) {
+                const PendingPage& page = pending[job / 2];
+                const bool compressed = job % 2 == 0;
+                const std::string path = (std::filesystem::path(directory) / (compressed ? page.page.compressedFile : page.page.uncompressedFile)).string();
+                std::error_code error;
+                if (std::filesystem::exists(path, error)) {
+                        return;
+                }
+                const std::string name = "atlas page " + std::to_string(job / 2);
+                if (!texture_cook::cook_pixels(page.pixels.data(), page.page.width, page.page.height, path.c_str(), compressed, ATLAS_LEVELS,
+                            name.c_str())) {
+                        cooked = false;
+                }
+        });
+
+        for (PendingPage& page : pending) {
+                manifest.pages.push_back(std::move(page.page));
+        }
+        return cooked;
+}
+
+bool write_manifest(const char* path, const Manifest& manifest)
+{
+        std::ostringstream out;
+        char key[32];
+        std::snprintf(key, sizeof(key), "%016" PRIx64, manifest.key);
+        out << "{\n  \"version\": " << VERSION << ",\n  \"key\": \"" << key << "\",\n  \"pages\": [";
+        for (size_t page = 0; page < manifest.pages.size(); page++) {
+                const Page& p = manifest.pages[page];
+                out << (page > 0 ? "," : "") << "\n    {\n      \"compressed\": ";
+                write_string(out, p.compressedFile);
+                out << ",\n      \"uncompressed\": ";
+                write_string(out, p.uncompressedFile);
+                out << ",\n      \"width\": " << p.width << ", \"height\": " << p.height << ", \"opaque\": " << (p.opaque ? "true" : "false")
+                    << ",\n      \"members\": [";
+                for (size_t member = 0; member < p.members.size(); member++) {
+                        const Member& m = p.members[member];
+                        out << (member > 0 ? "," : "") << "\n        { \"name\": ";
+                        write_string(out, m.name);
+                        out << ", \"x\": " << m.rect.x << ", \"y\": " << m.rect.y << ", \"width\": " << m.rect.width
+                            << ", \"height\": " << m.rect.height << " }";
+                }
+                out << "\n      ]\n    }";
+        }
+        out << "\n  ]\n}\n";
+
+        const std::string text = out.str();
+        return write_file_atomically(path, [&](std::ostream& file) {
+                file.write(text.data(), text.size());
+                return file.good();
+        });
+}
+
+bool read_manifest(const char* path, Manifest& manifest)
+{
+        VfsFile file;
+        json::Value root;
+        if (!Vfs::global().read(path, file) || !json::parse(reinterpret_cast<const char*>(file.data), file.size, root)
+                || root.number("version") != VERSION) {
+                return false;
+        }
+        const json::Value* pages = root.find("pages");
+        if (!pages || !pages->is_array()) {
+                return false;
+        }
+
+        manifest.pages.clear();
+        const json::Value* key = root.find("key");
+        manifest.key = key ? std::strtoull(key->as_string().c_str(), nullptr, 16) : 0;
+        for (size_t i = 0; i < pages->size(); i++) {
+                const json::Value& value = (*pages)[i];
+                const json::Value* compressed = value.find("compressed");
+                const json::Value* uncompressed = value.find("uncompressed");
+                const json::Value* members = value.find("members");
+                const json::Value* opaque = value.find("opaque");
+                if (!compressed || !uncompressed || !members || !members->is_array()) {
+                        return false;
+                }
+
+                // the engine divides by the page size for the uv rects
+                Page& page = manifest.pages.emplace_back();
+                page.compressedFile = compressed->as_string();
+                page.uncompressedFile = uncompressed->as_string();
+                if (!read_size(value, "width", page.width) || !read_size(value, "height", page.height) || page.width == 0
+                        || page.height == 0) {
+                        return false;
+                }
+                page.opaque = opaque && opaque->as_bool(true);
+                for (size_t j = 0; j < members->size(); j++) {
+                        const json::Value& member = (*members)[j];
+                        const json::Value* name = member.find("name");
+                        Member& out = page.members.emplace_back();
+                        if (!name || !name->is_string() || !read_size(member, "x", out.rect.x) || !read_size(member, "y", out.rect.y)
+                                || !read_size(member, "width", out.rect.width) || !read_size(member, "height", out.rect.height)
+                                || out.rect.width == 0 || out.rect.height == 0 || out.rect.x + out.rect.width > page.width
+                                || out.rect.y + out.rect.height > page.height) {
+                                return false;
+                        }
+                        out.name = name->as_string();
+                }
+        }
+        return true;
+}
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// textures with both sides up to this size go into atlases
+constexpr uint32_t ATLAS_MAX_TEXTURE_SIZE = 256;
+constexpr uint32_t ATLAS_MAX_SIZE = 2048;
+// Border around every texture, filled with the texels it wraps around to up
+// to the next multiple of it. The textures are aligned to it as well, so the
+// first levels never mix two textures, the chain stops at the level where
+// the border is one texel wide.
+constexpr uint32_t ATLAS_PADDING = 8;
+constexpr uint32_t ATLAS_LEVELS = std::bit_width(ATLAS_PADDING);
+// written next to the pages
+constexpr const char* ATLAS_MANIFEST = "atlases.json";
+
+// Import time packing of small textures into shared pages. Every texture of
+// a page has the same format, a page is cooked in both the BC and the RGBA8
+// flavor like single textures are. The manifest tells the engine where each
+// source ended up, the meshes have no texture coordinates to remap yet, so
+// the rect is applied in the shader.
+namespace atlas {
+
+// bump when the pages or the manifest change
+constexpr uint32_t VERSION = 2;
+
+struct Rect {
+        uint32_t x = 0;
+        uint32_t y = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+};
+
+struct Member {
+        // relative to the asset root
+        std::string name;
+        // without the border
+        Rect rect;
+};
+
+struct Page {
+        // relative to the manifest
+        std::string compressedFile;
+        std::string uncompressedFile;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        bool opaque = true;
+        std::vector<Member> members;
+};
+
+struct Manifest {
+        std::vector<Page> pages;
+        // hash of the settings and of the names and contents of the textures
+        // that were small enough, bake() keeps a manifest with the same key
+        uint64_t key = 0;
+};
+
+// Shelf packs the sizes, tallest first, every one grown by padding on each
+// side and aligned to it. Pages are powers of two of at most maxSize, a page
+// that is full starts the next one. rects get the area inside the border.
+// False when a size doesn't fit into maxSize at all.
+bool pack(const std::vector<Rect>& sizes, uint32_t padding, uint32_t maxSize, std::vector<Rect>& rects, std::vector<uint32_t>& pages,
+        std::vector<Rect>& pageSizes);
+
+// Decodes the sources that are small enough, packs them by format and cooks
+// the pages into directory, the ones that exist already are kept. names are
+// what the manifest lists them as. When the ATLAS_MANIFEST in directory has
+// the key of the small sources and its pages exist, that manifest is returned
+// and nothing is decoded or composed.
+bool bake(const std::vector<std::string>& sources, const std::vector<std::string>& names, const std::string& directory, Manifest& manifest);
+
+bool write_manifest(const char* path, const Manifest& manifest);
+// false when there is no manifest, it is from another version, or a page or
+// rect in it is empty or outside its page
+bool read_manifest(const char* path, Manifest& manifest);
+
+}
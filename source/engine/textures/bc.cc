@@ -0,0 +1,391 @@
+#include "bc.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define BC_SSE 1
+#endif
+
+namespace bc {
+
+namespace {
+
+// a 4x4 block, RGBA in 0..255
+struct Block {
+        float texels[16][4];
+};
+
+// Up to 16 candidate colors, one array per channel so four candidates are
+// compared at once. count is a multiple of 4.
+struct Palette {
+        alignas(16) float channels[4][16];
+        uint32_t count;
+};
+
+// BC7 interpolation weights of the 4 bit indices
+constexpr uint32_t BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// LSB first bit stream of one 128 bit block
+struct BlockWriter {
+        uint8_t* out;
+        uint32_t position = 0;
+
+        void write(uint32_t value, uint32_t count)
+        {
+                for (uint32_t i = 0; i < count; i++, position++) {
+                        if ((value >> i) & 1) {
+                                out[position / 8] |= static_cast<uint8_t>(1u << (position % 8));
+                        }
+                }
+        }
+};
+
+void load_block(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, Block& block)
+{
+        for (uint32_t y = 0; y < 4; y++) {
+                const uint32_t row = std::min(blockY * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++) {
+                        const uint32_t column = std::min(blockX * 4 + x, width - 1);
+                        const uint8_t* texel = rgba + (size_t(row) * width + column) * 4;
+                        for (uint32_t c = 0; c < 4; c++) {
+                                block.texels[y * 4 + x][c] = texel[c];
+                        }
+                }
+        }
+}
+
+// index of the palette entry closest to texel
+uint32_t nearest(const Palette& palette, const float texel[4])
+{
+        float best = FLT_MAX;
+        uint32_t bestIndex = 0;
+#ifdef BC_SSE
+        const __m128 r = _mm_set1_ps(texel[0]);
+        const __m128 g = _mm_set1_ps(texel[1]);
+        const __m128 b = _mm_set1_ps(texel[2]);
+        const __m128 a = _mm_set1_ps(texel[3]);
+        for (uint32_t i = 0; i < palette.count; i += 4) {
+                __m128 d = _mm_sub_ps(_mm_load_ps(palette.channels[0] + i), r);
+                __m128 distance = _mm_mul_ps(d, d);
+                d = _mm_sub_ps(_mm_load_ps(palette.channels[1] + i), g);
+                distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+                d = _mm_sub_ps(_mm_load_ps(palette.channels[2] + i), b);
+                distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+                d = _mm_sub_ps(_mm_load_ps(palette.channels[3] + i), a);
+                distance = _mm_add_ps(distance, _mm_mul_ps(d, d));
+
+                alignas(16) float distances[4];
+                _mm_store_ps(distances, distance);
+                for (uint32_t j = 0; j < 4; j++) {
+                        if (distances[j] < best) {
+                                best = distances[j];
+                                bestIndex = i + j;
+                        }
+                }
+        }
+#else
+        for (uint32_t i = 0; i < palette.count; i++) {
+                float distance = 0.0f;
+                for (uint32_t c = 0; c < 4; c++) {
+                        float d = palette.channels[c][i] - texel[c];
+                        distance += d * d;
+                }
+                if (distance < best) {
+                        best = distance;
+                        bestIndex = i;
+                }
+        }
+#endif
+        return bestIndex;
+}
+
+// Line through the block's first channelCount channels that the endpoints
+// are picked on: through the mean along the principal axis of the
+// covariance, shortened by inset of its length on both ends.
+void fit_endpoints(const Block& block, uint32_t channelCount, float inset, float low[4], float high[4])
+{
+        float mean[4] = {};
+        for (const float* texel : block.texels) {
+                for (uint32_t c = 0; c < channelCount; c++) {
+                        mean[c] += texel[c] / 16.0f;
+                }
+        }
+
+        float covariance[4][4] = {};
+        for (const float* texel : block.texels) {
+                for (uint32_t i = 0; i < channelCount; i++) {
+                        for (uint32_t j = 0; j < channelCount; j++) {
+                                covariance[i][j] += (texel[i] - mean[i]) * (texel[j] - mean[j]);
+                        }
+                }
+        }
+
+        // power iteration, starting from the column of the largest variance
+        uint32_t largest = 0;
+        for (uint32_t c = 1; c < channelCount; c++) {
+                if (covariance[c][c] > covariance[largest][largest]) {
+                        largest = c;
+                }
+        }
+        float axis[4] = {};
+        for (uint32_t c = 0; c < channelCount; c++) {
+                axis[c] = covariance[c][largest];
+        }
+        for (int iteration = 0; iteration < 8; iteration++) {
+                float next[4] = {};
+                float scale = 0.0f;
+                for (uint32_t i = 0; i < channelCount; i++) {
+                        for (uint32_t j = 0; j < channelCount; j++) {
+                                next[i] += covariance[i][j] * axis[j];
+                        }
+                        scale = std::max(scale, std::abs(next[i]));
+                }
+                if (scale == 0.0f) {
+                        break;
+                }
+                for (uint32_t c = 0; c < channelCount; c++) {
+                        axis[c] = next[c] / scale;
+                }
+        }
+        float length = 0.0f;
+        for (uint32_t c = 0; c < channelCount; c++) {
+                length += axis[c] * axis[c];
+        }
+        length = std::sqrt(length);
+
+        // flat blocks end up with both endpoints on the mean
+        float minT = 0.0f;
+        float maxT = 0.0f;
+        if (length > 0.0f) {
+                for (uint32_t c = 0; c < channelCount; c++) {
+                        axis[c] /= length;
+                }
+                minT = FLT_MAX;
+                maxT = -FLT_MAX;
+                for (const float* texel : block.texels) {
+                        float t = 0.0f;
+                        for (uint32_t c = 0; c < channelCount; c++) {
+                                t += (texel[c] - mean[c]) * axis[c];
+                        }
+                        minT = std::min(minT, t);
+                        maxT = std::max(maxT, t);
+                }
+                const float range = (maxT - minT) * inset;
+                minT += range;
+                maxT -= range;
+        }
+
+        for (uint32_t c = 0; c < 4; c++) {
+                low[c] = c < channelCount ? std::clamp(mean[c] + axis[c] * minT, 0.0f, 255.0f) : 0.0f;
+                high[c] = c < channelCount ? std::clamp(mean[c] + axis[c] * maxT, 0.0f, 255.0f) : 0.0f;
+        }
+}
+
+uint16_t to_565(const float color[4])
+{
+        uint32_t r = static_cast<uint32_t>(std::lround(color[0] * 31.0f / 255.0f));
+        uint32_t g = static_cast<uint32_t>(std::lround(color[1] * 63.0f / 255.0f));
+        uint32_t b = static_cast<uint32_t>(std::lround(color[2] * 31.0f / 255.0f));
+        return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+}
+
+void from_565(uint16_t packed, float color[3])
+{
+        uint32_t r = (packed >> 11) & 31;
+        uint32_t g = (packed >> 5) & 63;
+        uint32_t b = packed & 31;
+        color[0] = static_cast<float>((r << 3) | (r >> 2));
+        color[1] = static_cast<float>((g << 2) | (g >> 4));
+        color[2] = static_cast<float>((b << 3) | (b >> 2));
+}
+
+// the 8 byte BC1 color block, always in 4 color mode
+void encode_color(const Block& block, uint8_t* out)
+{
+        float low[4], high[4];
+        fit_endpoints(block, 3, 1.0f / 16.0f, low, high);
+
+        uint16_t color0 = to_565(high);
+        uint16_t color1 = to_565(low);
+        if (color0 < color1) {
+                std::swap(color0, color1);
+        }
+
+        // equal endpoints decode as color0 with all indices 0
+        uint32_t indices = 0;
+        if (color0 != color1) {
+                float end0[3], end1[3];
+                from_565(color0, end0);
+                from_565(color1, end1);
+
+                Palette palette {};
+                palette.count = 4;
+                for (uint32_t c = 0; c < 3; c++) {
+                        palette.channels[c][0] = end0[c];
+                        palette.channels[c][1] = end1[c];
+                        palette.channels[c][2] = (2.0f * end0[c] + end1[c]) / 3.0f;
+                        palette.channels[c][3] = (end0[c] + 2.0f * end1[c]) / 3.0f;
+                }
+                for (uint32_t i = 0; i < 16; i++) {
+                        const float* texel = block.texels[i];
+                        const float color[4] = { texel[0], texel[1], texel[2], 0.0f };
+                        indices |= nearest(palette, color) << (2 * i);
+                }
+        }
+
+        out[0] = static_cast<uint8_t>(color0);
+        out[1] = static_cast<uint8_t>(color0 >> 8);
+        out[2] = static_cast<uint8_t>(color1);
+        out[3] = static_cast<uint8_t>(color1 >> 8);
+        for (uint32_t i = 0; i < 4; i++) {
+                out[4 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+}
+
+// the 8 byte BC3 alpha block in 8 level mode, the extremes stay exact
+void encode_alpha(const Block& block, uint8_t* out)
+{
+        uint8_t minAlpha = 255;
+        uint8_t maxAlpha = 0;
+        for (const float* texel : block.texels) {
+                minAlpha = std::min(minAlpha, static_cast<uint8_t>(texel[3]));
+                maxAlpha = std::max(maxAlpha, static_cast<uint8_t>(texel[3]));
+        }
+
+        uint64_t indices = 0;
+        if (minAlpha != maxAlpha) {
+                Palette palette {};
+                palette.count = 8;
+                palette.channels[3][0] = maxAlpha;
+                palette.channels[3][1] = minAlpha;
+                for (uint32_t i = 2; i < 8; i++) {
+                        palette.channels[3][i] = ((8 - i) * maxAlpha + (i - 1) * minAlpha) / 7.0f;
+                }
+                for (uint32_t i = 0; i < 16; i++) {
+                        const float alpha[4] = { 0.0f, 0.0f, 0.0f, block.texels[i][3] };
+                        indices |= uint64_t(nearest(palette, alpha)) << (3 * i);
+                }
+        }
+
+        out[0] = maxAlpha;
+        out[1] = minAlpha;
+        for (uint32_t i = 0; i < 6; i++) {
+                out[2 + i] = static_cast<uint8_t>(indices >> (8 * i));
+        }
+}
+
+// 7 bits per channel plus a p-bit shared by all four channels
+void quantize_mode6(const float color[4], uint32_t quantized[4], uint32_t& pBit)
+{
+        float bestError = FLT_MAX;
+        for (uint32_t p = 0; p < 2; p++) {
+                uint32_t candidate[4];
+                float error = 0.0f;
+                for (uint32_t c = 0; c < 4; c++) {
+                        candidate[c] = static_cast<uint32_t>(std::clamp(std::lround((color[c] - p) / 2.0f), 0l, 127l));
+                        float d = static_cast<float>((candidate[c] << 1) | p) - color[c];
+                        error += d * d;
+                }
+                if (error < bestError) {
+                        bestError = error;
+                        pBit = p;
+                        std::copy(candidate, candidate + 4, quantized);
+                }
+        }
+}
+
+// BC7 mode 6: one subset, RGBA endpoints, 4 bit indices
+void encode_bc7(const Block& block, uint8_t* out)
+{
+        float low[4], high[4];
+        fit_endpoints(block, 4, 1.0f / 32.0f, low, high);
+
+        uint32_t endpoints[2][4];
+        uint32_t pBits[2];
+        quantize_mode6(high, endpoints[0], pBits[0]);
+        quantize_mode6(low, endpoints[1], pBits[1]);
+
+        Palette palette {};
+        palette.count = 16;
+        for (uint32_t c = 0; c < 4; c++) {
+                const uint32_t end0 = (endpoints[0][c] << 1) | pBits[0];
+                const uint32_t end1 = (endpoints[1][c] << 1) | pBits[1];
+                for (uint32_t i = 0; i < 16; i++) {
+                        palette.channels[c][i] = static_cast<float>(((64 - BC7_WEIGHTS[i]) * end0 + BC7_WEIGHTS[i] * end1 + 32) >> 6);
+                }
+        }
+
+        uint32_t indices[16];
+        for (uint32_t i = 0; i < 16; i++) {
+                indices[i] = nearest(palette, block.texels[i]);
+        }
+
+        // the first index only has 3 bits, its top bit has to be 0
+        if (indices[0] & 8) {
+                std::swap(endpoints[0], endpoints[1]);
+                std::swap(pBits[0], pBits[1]);
+                for (uint32_t& index : indices) {
+                        index = 15 - index;
+                }
+        }
+
+        std::fill(out, out + 16, 0);
+        BlockWriter writer { out };
+        writer.write(1 << 6, 7);
+        for (uint32_t c = 0; c < 4; c++) {
+                writer.write(endpoints[0][c], 7);
+                writer.write(endpoints[1][c], 7);
+        }
+        writer.write(pBits[0], 1);
+        writer.write(pBits[1], 1);
+        writer.write(indices[0], 3);
+        for (uint32_t i = 1; i < 16; i++) {
+                writer.write(indices[i], 4);
+        }
+}
+
+}
+
+size_t block_size(BlockFormat format)
+{
+        return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+size_t compressed_size(BlockFormat format, uint32_t width, uint32_t height)
+{
+        return size_t((width + 3) / 4) * ((height + 3) / 4) * block_size(format);
+}
+
+void compress(const uint8_t* rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t* out)
+{
+        const uint32_t blocksX = (width + 3) / 4;
+        const uint32_t blocksY = (height + 3) / 4;
+        const size_t blockBytes = block_size(format);
+
+        ThreadPool::global().parallel_for(blocksY, [&](size_t blockY) {
+                uint8_t* row = out + blockY * blocksX * blockBytes;
+                Block block;
+                for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+                        load_block(rgba, width, height, blockX, static_cast<uint32_t>(blockY), block);
+                        uint8_t* dst = row + blockX * blockBytes;
+                        switch (format) {
+                        case BlockFormat::BC1:
+                                encode_color(block, dst);
+                                break;
+                        case BlockFormat::BC3:
+                                encode_alpha(block, dst);
+                                encode_color(block, dst + 8);
+                                break;
+                        case BlockFormat::BC7:
+                                encode_bc7(block, dst);
+                                break;
+                        }
+                }
+        });
+}
+
+}
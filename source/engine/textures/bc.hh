@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Block compression of RGBA8 images into the BCn formats every desktop gpu
+// samples directly. Endpoints come from the principal axis of each 4x4 block,
+// the index search is SSE where available. BC7 only uses mode 6 (one subset,
+// RGBA endpoints, 16 levels), which is already well above BC1/BC3 quality.
+//
+// Partial blocks at the right and bottom edges repeat the last texels.
+namespace bc {
+
+enum class BlockFormat : uint32_t {
+        // opaque RGB, 8 bytes per block
+        BC1 = 0,
+        // BC1 color with a separate 8 level alpha block, 16 bytes per block
+        BC3 = 1,
+        // RGBA, 16 bytes per block
+        BC7 = 2,
+};
+
+size_t block_size(BlockFormat format);
+// bytes of a width x height image in format
+size_t compressed_size(BlockFormat format, uint32_t width, uint32_t height);
+
+// Compresses tightly packed RGBA8 texels into out, which has to hold
+// compressed_size() bytes. Block rows are spread over the thread pool.
+void compress(const uint8_t* rgba, uint32_t width, uint32_t height, BlockFormat format, uint8_t* out);
+
+}
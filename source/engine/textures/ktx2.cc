@@ -0,0 +1,252 @@
+#include "ktx2.hh"
+#include "mapped_file.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+namespace ktx2 {
+
+namespace {
+
+constexpr uint8_t IDENTIFIER[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+
+struct Header {
+        uint8_t identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+};
+static_assert(sizeof(Header) == 80);
+
+struct LevelIndex {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+};
+
+// Khronos Data Format color models and channels of the BC formats
+constexpr uint32_t MODEL_RGBSDA = 1;
+constexpr uint32_t MODEL_BC1A = 128;
+constexpr uint32_t MODEL_BC3 = 130;
+constexpr uint32_t MODEL_BC7 = 134;
+constexpr uint32_t CHANNEL_RED = 0;
+constexpr uint32_t CHANNEL_GREEN = 1;
+constexpr uint32_t CHANNEL_BLUE = 2;
+constexpr uint32_t CHANNEL_ALPHA = 15;
+// alpha is never sRGB encoded
+constexpr uint32_t SAMPLE_LINEAR = 0x10;
+constexpr uint32_t CHANNEL_COLOR = 0;
+constexpr uint32_t CHANNEL_BC1A_ALPHA = 1;
+constexpr uint32_t CHANNEL_BC3_ALPHA = 15;
+constexpr uint32_t PRIMARIES_BT709 = 1;
+constexpr uint32_t TRANSFER_LINEAR = 1;
+constexpr uint32_t TRANSFER_SRGB = 2;
+
+bool is_srgb(VkFormat format)
+{
+        return format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+                || format == VK_FORMAT_BC3_SRGB_BLOCK || format == VK_FORMAT_BC7_SRGB_BLOCK || format == VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+uint64_t level_size(VkFormat format, uint32_t width, uint32_t height, uint32_t level)
+{
+        const uint64_t levelWidth = std::max(width >> level, 1u);
+        const uint64_t levelHeight = std::max(height >> level, 1u);
+        const uint64_t blockExtent = block_extent(format);
+        return ((levelWidth + blockExtent - 1) / blockExtent) * ((levelHeight + blockExtent - 1) / blockExtent) * block_size(format);
+}
+
+// The basic data format descriptor the spec requires, one sample per
+// channel, or per compressed channel block.
+std::vector<uint32_t> data_format_descriptor(VkFormat format)
+{
+        struct Sample {
+                uint32_t channel;
+                uint32_t bitOffset;
+                uint32_t bitLength;
+        };
+        uint32_t model;
+        std::vector<Sample> samples;
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+                model = MODEL_RGBSDA;
+                samples = { { CHANNEL_RED, 0, 8 }, { CHANNEL_GREEN, 8, 8 }, { CHANNEL_BLUE, 16, 8 },
+                        { CHANNEL_ALPHA | (is_srgb(format) ? SAMPLE_LINEAR : 0), 24, 8 } };
+                break;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                model = MODEL_BC1A;
+                samples = { { CHANNEL_COLOR, 0, 64 } };
+                break;
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                model = MODEL_BC1A;
+                samples = { { CHANNEL_BC1A_ALPHA, 0, 64 } };
+                break;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+                model = MODEL_BC3;
+                samples = { { CHANNEL_BC3_ALPHA, 0, 64 }, { CHANNEL_COLOR, 64, 64 } };
+                break;
+        default:
+                model = MODEL_BC7;
+                samples = { { CHANNEL_COLOR, 0, 128 } };
+                break;
+        }
+
+        const uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+        std::vector<uint32_t> words;
+        words.push_back(4 + blockSize);
+        // vendor and descriptor type 0, version 2
+        words.push_back(0);
+        words.push_back(2 | (blockSize << 16));
+        words.push_back(model | (PRIMARIES_BT709 << 8) | ((is_srgb(format) ? TRANSFER_SRGB : TRANSFER_LINEAR) << 16));
+        // texel block dimensions, stored as dimension - 1
+        const uint32_t blockExtent = block_extent(format) - 1;
+        words.push_back(blockExtent | (blockExtent << 8));
+        words.push_back(block_size(format));
+        words.push_back(0);
+        for (const Sample& sample : samples) {
+                words.push_back(sample.bitOffset | ((sample.bitLength - 1) << 16) | (sample.channel << 24));
+                words.push_back(0);
+                words.push_back(0);
+                // the largest value of the sample, all bits for the blocks
+                words.push_back(sample.bitLength < 32 ? (1u << sample.bitLength) - 1 : UINT32_MAX);
+        }
+        return words;
+}
+
+}
+
+uint32_t block_size(VkFormat format)
+{
+        switch (format) {
+        case VK_FORMAT_R8G8B8A8_UNORM:
+        case VK_FORMAT_R8G8B8A8_SRGB:
+                return 4;
+        case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+        case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+        case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                return 8;
+        case VK_FORMAT_BC3_UNORM_BLOCK:
+        case VK_FORMAT_BC3_SRGB_BLOCK:
+        case VK_FORMAT_BC7_UNORM_BLOCK:
+        case VK_FORMAT_BC7_SRGB_BLOCK:
+                return 16;
+        default:
+                return 0;
+        }
+}
+
+uint32_t block_extent(VkFormat format)
+{
+        return format == VK_FORMAT_R8G8B8A8_UNORM || format == VK_FORMAT_R8G8B8A8_SRGB ? 1 : 4;
+}
+
+bool parse(const uint8_t* data, size_t size, Image& image)
+{
+        Header header;
+        if (size < sizeof(header)) {
+                return false;
+        }
+        std::memcpy(&header, data, sizeof(header));
+        if (std::memcmp(header.identifier, IDENTIFIER, sizeof(IDENTIFIER)) != 0) {
+                return false;
+        }
+
+        const VkFormat format = static_cast<VkFormat>(header.vkFormat);
+        // no arrays, cubes, volumes, supercompression or runtime generated
+        // mips (levelCount 0)
+        if (block_size(format) == 0 || header.pixelWidth == 0 || header.pixelHeight == 0 || header.pixelDepth != 0
+                || header.layerCount > 1 || header.faceCount != 1 || header.supercompressionScheme != 0 || header.levelCount == 0
+                || header.levelCount > 32 || (std::max(header.pixelWidth, header.pixelHeight) >> (header.levelCount - 1)) == 0) {
+                return false;
+        }
+        if (header.levelCount > (size - sizeof(header)) / sizeof(LevelIndex)) {
+                return false;
+        }
+
+        image.format = format;
+        image.width = header.pixelWidth;
+        image.height = header.pixelHeight;
+        image.levels.clear();
+        for (uint32_t level = 0; level < header.levelCount; level++) {
+                LevelIndex index;
+                std::memcpy(&index, data + sizeof(header) + level * sizeof(index), sizeof(index));
+                if (index.byteOffset > size || index.byteLength > size - index.byteOffset
+                        || index.byteLength != level_size(format, image.width, image.height, level)) {
+                        return false;
+                }
+                image.levels.push_back({ data + index.byteOffset, index.byteLength });
+        }
+        return true;
+}
+
+bool write(const char* filename, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels)
+{
+        const uint32_t blockSize = block_size(format);
+        if (blockSize == 0 || levels.empty()) {
+                return false;
+        }
+        for (size_t level = 0; level < levels.size(); level++) {
+                if (levels[level].size() != level_size(format, width, height, static_cast<uint32_t>(level))) {
+                        return false;
+                }
+        }
+
+        const std::vector<uint32_t> dfd = data_format_descriptor(format);
+
+        Header header {};
+        std::memcpy(header.identifier, IDENTIFIER, sizeof(IDENTIFIER));
+        header.vkFormat = format;
+        header.typeSize = 1;
+        header.pixelWidth = width;
+        header.pixelHeight = height;
+        header.faceCount = 1;
+        header.levelCount = static_cast<uint32_t>(levels.size());
+        header.dfdByteOffset = static_cast<uint32_t>(sizeof(Header) + levels.size() * sizeof(LevelIndex));
+        header.dfdByteLength = static_cast<uint32_t>(dfd.size() * sizeof(uint32_t));
+
+        // the smallest level comes first in the file, every level aligned to
+        // the block size (which is a multiple of 4 already)
+        std::vector<LevelIndex> index(levels.size());
+        uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+        for (size_t level = levels.size(); level-- > 0;) {
+                offset = (offset + blockSize - 1) / blockSize * blockSize;
+                index[level].byteOffset = offset;
+                index[level].byteLength = levels[level].size();
+                index[level].uncompressedByteLength = levels[level].size();
+                offset += levels[level].size();
+        }
+
+        std::vector<uint8_t> blob(offset, 0);
+        std::memcpy(blob.data(), &header, sizeof(header));
+        std::memcpy(blob.data() + sizeof(header), index.data(), index.size() * sizeof(LevelIndex));
+        std::memcpy(blob.data() + header.dfdByteOffset, dfd.data(), header.dfdByteLength);
+        for (size_t level = 0; level < levels.size(); level++) {
+                std::memcpy(blob.data() + index[level].byteOffset, levels[level].data(), levels[level].size());
+        }
+
+        return write_file_atomically(filename, [&](std::ostream& file) {
+                file.write(reinterpret_cast<const char*>(blob.data()), blob.size());
+                return file.good();
+        });
+}
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+// KTX2 textures: single 2D images with their whole mip chain, without
+// supercompression. BC1/BC3/BC7 and RGBA8 only, the level data is exactly
+// what vkCmdCopyBufferToImage wants, so the reader just hands out views into
+// the file bytes.
+namespace ktx2 {
+
+struct Level {
+        const uint8_t* data;
+        uint64_t size;
+};
+
+struct Image {
+        VkFormat format;
+        uint32_t width;
+        uint32_t height;
+        // level 0 first
+        std::vector<Level> levels;
+};
+
+// bytes per texel block (4x4 for BC, single texels for RGBA8), 0 for
+// unsupported formats
+uint32_t block_size(VkFormat format);
+// width and height of a texel block
+uint32_t block_extent(VkFormat format);
+
+// false for anything but a valid 2D texture in a supported format
+bool parse(const uint8_t* data, size_t size, Image& image);
+
+// levels[0] is the full size image, every further level half the one before
+bool write(const char* filename, VkFormat format, uint32_t width, uint32_t height, const std::vector<std::vector<uint8_t>>& levels);
+
+}
@@ -0,0 +1,177 @@
+#include "texture_cook.hh"
+#include "bc.hh"
+#include "hash.hh"
+#include "ktx2.hh"
+#include "thread_pool.hh"
+#include "vfs.hh"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cinttypes>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+namespace texture_cook {
+
+namespace {
+
+float srgb_to_linear(float value)
+{
+        return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+uint8_t linear_to_srgb(float value)
+{
+        value = std::clamp(value, 0.0f, 1.0f);
+        value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        return static_cast<uint8_t>(std::lround(value * 255.0f));
+}
+
+// every 8 bit sRGB value in linear space
+const std::array<float, 256>& srgb_table()
+{
+        static const std::array<float, 256> table = [] {
+                std::array<float, 256> values;
+                for (size_t i = 0; i < values.size(); i++) {
+                        values[i] = srgb_to_linear(i / 255.0f);
+                }
+                return values;
+        }();
+        return table;
+}
+
+}
+
+std::string entry_path(const char* source, bool compressed, const std::string& directory)
+{
+        uint64_t key;
+        if (!Vfs::global().content_hash(source, key)) {
+                return {};
+        }
+        const uint32_t settings[] = { VERSION, compressed };
+        key = hash64(settings, sizeof(settings), key);
+
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016" PRIx64 ".ktx2", key);
+        return (std::filesystem::path(directory) / name).string();
+}
+
+std::string find_or_cook(const char* source, bool compressed, const std::string& directory)
+{
+        const std::string cookedPath = entry_path(source, compressed, directory);
+        if (cookedPath.empty() || (!Vfs::global().exists(cookedPath.c_str()) && !cook(source, cookedPath.c_str(), compressed))) {
+                return {};
+        }
+        return cookedPath;
+}
+
+bool cook(const char* source, const char* cookedPath, bool compressed)
+{
+        VfsFile file;
+        if (!Vfs::global().read(source, file) || file.size > INT_MAX) {
+                std::cerr << "ERROR: failed to read " << source << std::endl;
+                return false;
+        }
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load_from_memory(file.data, static_cast<int>(file.size), &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels) {
+                std::cerr << "ERROR: failed to decode " << source << ": " << stbi_failure_reason() << std::endl;
+                return false;
+        }
+
+        bool cooked = cook_pixels(pixels, static_cast<uint32_t>(width), static_cast<uint32_t>(height), cookedPath, compressed, 0, source);
+        stbi_image_free(pixels);
+        return cooked;
+}
+
+bool cook_pixels(const uint8_t* pixels, uint32_t width, uint32_t height, const char* cookedPath, bool compressed, uint32_t maxLevels,
+        const char* name)
+{
+        auto start = std::chrono::high_resolution_clock::now();
+
+        const size_t texelCount = size_t(width) * height;
+        bool opaque = true;
+        for (size_t i = 0; i < texelCount && opaque; i++) {
+                opaque = pixels[i * 4 + 3] == 255;
+        }
+        // BC1 is half the size, but only BC7 keeps a smooth alpha
+        const bc::BlockFormat blockFormat = opaque ? bc::BlockFormat::BC1 : bc::BlockFormat::BC7;
+        VkFormat format = opaque ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
+        if (!compressed) {
+                format = VK_FORMAT_R8G8B8A8_SRGB;
+        }
+
+        // the level being compressed, and its linear copy the next level is
+        // filtered from
+        std::vector<uint8_t> rgba(pixels, pixels + texelCount * 4);
+        std::vector<float> linear(texelCount * 4);
+        const std::array<float, 256>& table = srgb_table();
+        for (size_t i = 0; i < linear.size(); i++) {
+                linear[i] = i % 4 == 3 ? rgba[i] / 255.0f : table[rgba[i]];
+        }
+
+        std::vector<std::vector<uint8_t>> levels;
+        uint32_t levelWidth = width;
+        uint32_t levelHeight = height;
+        while (true) {
+                if (compressed) {
+                        std::vector<uint8_t>& level = levels.emplace_back(bc::compressed_size(blockFormat, levelWidth, levelHeight));
+                        bc::compress(rgba.data(), levelWidth, levelHeight, blockFormat, level.data());
+                } else {
+                        levels.push_back(rgba);
+                }
+                if ((levelWidth == 1 && levelHeight == 1) || levels.size() == maxLevels) {
+                        break;
+                }
+
+                // 2x2 box filter, the last row or column of odd sizes is
+                // only sampled by the texels next to it
+                const uint32_t nextWidth = std::max(levelWidth / 2, 1u);
+                const uint32_t nextHeight = std::max(levelHeight / 2, 1u);
+                std::vector<float> next(size_t(nextWidth) * nextHeight * 4);
+                rgba.resize(next.size());
+                ThreadPool::global().parallel_for(nextHeight, [&](size_t y) {
+                        for (uint32_t x = 0; x < nextWidth; x++) {
+                                const size_t dst = (y * nextWidth + x) * 4;
+                                for (uint32_t c = 0; c < 4; c++) {
+                                        float sum = 0.0f;
+                                        for (uint32_t dy = 0; dy < 2; dy++) {
+                                                const size_t row = std::min<size_t>(y * 2 + dy, levelHeight - 1);
+                                                for (uint32_t dx = 0; dx < 2; dx++) {
+                                                        const size_t column = std::min<size_t>(x * 2 + dx, levelWidth - 1);
+                                                        sum += linear[(row * levelWidth + column) * 4 + c];
+                                                }
+                                        }
+                                        const float value = sum / 4.0f;
+                                        next[dst + c] = value;
+                                        rgba[dst + c] = c == 3 ? static_cast<uint8_t>(std::lround(value * 255.0f)) : linear_to_srgb(value);
+                                }
+                        }
+                });
+                linear.swap(next);
+                levelWidth = nextWidth;
+                levelHeight = nextHeight;
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(std::filesystem::path(cookedPath).parent_path(), error);
+        if (!ktx2::write(cookedPath, format, width, height, levels)) {
+                std::cerr << "ERROR: failed to write " << cookedPath << std::endl;
+                return false;
+        }
+
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        std::cout << (name ? name : cookedPath) << ": cooked " << width << "x" << height << " " << (!compressed ? "RGBA8" : opaque ? "BC1" : "BC7") << " with "
+                  << levels.size() << " mips in " << elapsed.count() << "ms" << std::endl;
+        return true;
+}
+
+}
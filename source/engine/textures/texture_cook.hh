@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// relative to the working directory, like the texture paths
+constexpr const char* TEXTURE_CACHE_DIRECTORY = "cache/textures";
+
+// Offline half of the texture path: source images (anything stb_image reads)
+// become block compressed KTX2 files with a full mip chain, or plain RGBA8
+// ones for devices without BC support. Entries are keyed by the source
+// contents like the mesh cache, so they never go stale.
+namespace texture_cook {
+
+// bump when the cooked output changes
+constexpr uint32_t VERSION = 1;
+
+// Path of the KTX2 for source in directory, whether it exists or not. Empty
+// when the source can't be read.
+std::string entry_path(const char* source, bool compressed = true, const std::string& directory = TEXTURE_CACHE_DIRECTORY);
+
+// entry_path, cooking the entry first when it doesn't exist yet. Empty when
+// the source can't be read or cooked. This is the cache miss path of every
+// texture loader.
+std::string find_or_cook(const char* source, bool compressed = true, const std::string& directory = TEXTURE_CACHE_DIRECTORY);
+
+// Decodes source as sRGB color, filters the mips in linear space and writes
+// them to cookedPath as BC1 when every texel is opaque, BC7 otherwise, or as
+// RGBA8 when not compressed.
+bool cook(const char* source, const char* cookedPath, bool compressed = true);
+
+// cook() for already decoded sRGB RGBA8 texels. The chain stops after
+// maxLevels when that isn't 0. name only shows up in the log.
+bool cook_pixels(const uint8_t* pixels, uint32_t width, uint32_t height, const char* cookedPath, bool compressed,
+        uint32_t maxLevels = 0, const char* name = nullptr);
+
+}
@@ -1,68 +1,314 @@
 #include "textures.hh"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <climits>
+#include <cstring>
 #include <iostream>
 #include <vulkan/vulkan_core.h>
 
 #include "initializers.hh"
+#include "ktx2.hh"
+#include "texture_cook.hh"
+#include "thread_pool.hh"
 #include "types.hh"
+#include "vfs.hh"
 
-#define STB_IMAGE_IMPLEMENTATION
+// the implementation lives with the texture cooking
 #include <stb_image.h>
 
-bool vkutil::load_image_from_file(VulkanEngine& engine, const char* file, AllocatedImage& outImage)
-{
-        int textureHeight, textureWidth, textureChannels;
-        // Load in the image as RGBA and store the provided in the said variables
-        stbi_uc* pixels = stbi_load(file, &textureWidth, &textureHeight, &textureChannels, STBI_rgb_alpha);
+namespace {
+
+// One texture on its way from the file to the gpu. Only the header is read
+// up front, the texels go into the staging memory once it's handed out.
+struct PendingTexture {
+        VfsFile file;
+        // a cooked KTX2, otherwise the file is decoded to RGBA8
+        bool compressed = false;
+        ktx2::Image ktx;
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        VkExtent3D extent {};
+        // the levels that come from the cpu, the rest are blitted on the gpu
+        std::vector<VkDeviceSize> levelSizes;
+        std::vector<void*> staging;
+        Texture texture {};
+};
 
-        if (!pixels) {
-                std::cerr << "Failed to load texture." << std::endl;
+bool read_source(const char* file, PendingTexture& pending)
+{
+        int width, height, channels;
+        if (!Vfs::global().read(file, pending.file) || pending.file.size > INT_MAX
+                || !stbi_info_from_memory(pending.file.data, static_cast<int>(pending.file.size), &width, &height, &channels)) {
+                std::cerr << "Failed to load texture " << file << std::endl;
                 return false;
         }
 
-        void* pixels_ptr;
-        // Times 4 in order to have 4 bytes per pixel.
-        VkDeviceSize imageSize = textureHeight * textureHeight * 4;
+        pending.compressed = false;
         // Exactly matches the format that the image is being imported in
-        VkFormat imageFormat = VK_FORMAT_R8G8B8A8_SRGB;
-
-        // Allocate temp. buffer to upload texture data
-        AllocatedBuffer stagingBuffer = engine.create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_COPY);
+        pending.format = VK_FORMAT_R8G8B8A8_SRGB;
+        pending.extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1 };
+        // Times 4 in order to have 4 bytes per pixel.
+        pending.levelSizes = { static_cast<VkDeviceSize>(width) * height * 4 };
+        return true;
+}
 
-        // Copy data to buffer
-        void* data;
-        vmaMapMemory(engine._allocator, stagingBuffer._allocation, &data);
+bool read_ktx2(const VulkanEngine& engine, const char* file, PendingTexture& pending)
+{
+        if (!Vfs::global().read(file, pending.file) || !ktx2::parse(pending.file.data, pending.file.size, pending.ktx)) {
+                std::cerr << "Failed to load texture " << file << std::endl;
+                return false;
+        }
 
-        memcpy(data, pixels_ptr, static_cast<size_t>(imageSize));
+        VkFormatProperties formatProperties;
+        vkGetPhysicalDeviceFormatProperties(engine._chosen_GPU, pending.ktx.format, &formatProperties);
+        if (!engine._textureCompressionBC || !(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT)) {
+                return false;
+        }
 
-        vmaUnmapMemory(engine._allocator, stagingBuffer._allocation);
+        pending.compressed = true;
+        pending.format = pending.ktx.format;
+        pending.extent = { pending.ktx.width, pending.ktx.height, 1 };
+        pending.levelSizes.clear();
+        for (const ktx2::Level& level : pending.ktx.levels) {
+                pending.levelSizes.push_back(level.size);
+        }
+        return true;
+}
 
-        // The image isn't needed anymore
-        stbi_image_free(pixels);
+// the cooked BC version when the device takes it, cooked on a miss
+bool read_texture(const VulkanEngine& engine, const char* file, PendingTexture& pending)
+{
+        if (engine._textureCompressionBC) {
+                const std::string cookedPath = texture_cook::find_or_cook(file);
+                if (!cookedPath.empty() && read_ktx2(engine, cookedPath.c_str(), pending)) {
+                        return true;
+                }
+                std::cerr << "No compressed version of " << file << ", uploading it uncompressed." << std::endl;
+        }
+        return read_source(file, pending);
+}
 
-        // The part where the image is created
-        VkExtent3D imageExtent;
-        imageExtent.width = textureWidth;
-        imageExtent.height = textureHeight;
-        imageExtent.depth = 1;
+void create_image(VulkanEngine& engine, PendingTexture& pending)
+{
+        uint32_t mipLevels = static_cast<uint32_t>(pending.levelSizes.size());
+        VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if (!pending.compressed) {
+                // Halving down to 1x1, the mips are blitted from level 0 on
+                // the gpu. Every desktop gpu can filter blits of this format,
+                // the rest gets just the one level.
+                VkFormatProperties formatProperties;
+                vkGetPhysicalDeviceFormatProperties(engine._chosen_GPU, pending.format, &formatProperties);
+                const VkFormatFeatureFlags blitFeatures = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+                if ((formatProperties.optimalTilingFeatures & blitFeatures) == blitFeatures) {
+                        mipLevels = std::bit_width(std::max(pending.extent.width, pending.extent.height));
+                        usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+                }
+        }
 
-        VkImageCreateInfo dimg_info = vkinit::create_image_info(imageFormat, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent, VK_SAMPLE_COUNT_1_BIT);
+        VkImageCreateInfo dimg_info = vkinit::create_image_info(pending.format, usage, pending.extent, VK_SAMPLE_COUNT_1_BIT);
+        dimg_info.mipLevels = mipLevels;
 
-        AllocatedImage newImage;
         VmaAllocationCreateInfo allocatedImageInfo {};
         allocatedImageInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-        vmaCreateImage(engine._allocator, &dimg_info, &allocatedImageInfo, &newImage._image, &newImage._allocation, nullptr);
+        VK_CHECK(vmaCreateImage(engine._allocator, &dimg_info, &allocatedImageInfo, &pending.texture.image._image,
+                &pending.texture.image._allocation, nullptr));
+        pending.texture.mipLevels = mipLevels;
+}
 
-        engine.immediate_submit([&](VkCommandBuffer cmd) {
-                VkImageSubresourceRange range;
-                range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+// ring bytes the levels take when staged back to back, the ones bigger than
+// the ring get staging buffers of their own
+VkDeviceSize ring_bytes(const UploadManager& uploads, const PendingTexture& pending)
+{
+        VkDeviceSize bytes = 0;
+        for (VkDeviceSize size : pending.levelSizes) {
+                if (size <= uploads.ring_size()) {
+                        bytes += size + UPLOAD_STAGING_ALIGNMENT;
+                }
+        }
+        return bytes;
+}
 
-                range.baseArrayLayer = 0;
-                range.layerCount = 1;
+// copies the levels of a KTX2 or decodes the image into the staging memory,
+// safe to call from any thread
+bool fill(const char* file, PendingTexture& pending)
+{
+        if (pending.compressed) {
+                // the blocks are already laid out like the copy wants them
+                for (size_t level = 0; level < pending.staging.size(); level++) {
+                        memcpy(pending.staging[level], pending.ktx.levels[level].data, pending.levelSizes[level]);
+                }
+                return true;
+        }
+
+        int textureHeight, textureWidth, textureChannels;
+        // Load in the image as RGBA and store the provided in the said variables
+        stbi_uc* pixels = stbi_load_from_memory(pending.file.data, static_cast<int>(pending.file.size), &textureWidth, &textureHeight,
+                &textureChannels, STBI_rgb_alpha);
 
-                range.baseMipLevel = 0;
-                range.levelCount = 1;
+        const size_t imageSize = static_cast<size_t>(pending.levelSizes[0]);
+        if (!pixels || static_cast<uint32_t>(textureWidth) != pending.extent.width || static_cast<uint32_t>(textureHeight) != pending.extent.height) {
+                // the copy is recorded either way, it uploads black
+                std::cerr << "Failed to decode texture " << file << std::endl;
+                memset(pending.staging[0], 0, imageSize);
+                stbi_image_free(pixels);
+                return false;
+        }
+        memcpy(pending.staging[0], pixels, imageSize);
+
+        // The image isn't needed anymore
+        stbi_image_free(pixels);
+        pending.file = {};
+        return true;
+}
+
+// The view over every level and the sampler, everything is destroyed with
+// the engine
+void finish_texture(VulkanEngine& engine, PendingTexture& pending)
+{
+        Texture& texture = pending.texture;
+        VkImageViewCreateInfo viewInfo = vkinit::create_image_view_info(pending.format, texture.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+        viewInfo.subresourceRange.levelCount = texture.mipLevels;
+        VK_CHECK(vkCreateImageView(engine._device, &viewInfo, nullptr, &texture.imageView));
+
+        VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR);
+        samplerInfo.maxLod = static_cast<float>(texture.mipLevels);
+        VK_CHECK(vkCreateSampler(engine._device, &samplerInfo, nullptr, &texture.sampler));
+
+        engine._mainDeletionQueue.push_function([=, &engine]() {
+                vkDestroySampler(engine._device, texture.sampler, nullptr);
+                vkDestroyImageView(engine._device, texture.imageView, nullptr);
+                vmaDestroyImage(engine._allocator, texture.image._image, texture.image._allocation);
         });
+}
+
+// Creates the images of the read textures and stages them in waves that fit
+// into what's left of the ring. A wave is filled on the thread pool before
+// the next staging may wrap the ring and reuse its memory.
+bool upload(VulkanEngine& engine, const std::vector<std::string>& files, std::vector<PendingTexture>& pending, const std::vector<uint8_t>& read)
+{
+        UploadManager& uploads = engine._uploads;
+        std::atomic<bool> filled { true };
+        std::vector<size_t> wave;
+        auto fill_wave = [&]() {
+                ThreadPool::global().parallel_for(wave.size(), [&](size_t i) {
+                        if (!fill(files[wave[i]].c_str(), pending[wave[i]])) {
+                                filled = false;
+                        }
+                });
+                wave.clear();
+        };
+
+        for (size_t i = 0; i < pending.size(); i++) {
+                if (!read[i]) {
+                        continue;
+                }
+                PendingTexture& texture = pending[i];
+                create_image(engine, texture);
 
+                const VkDeviceSize bytes = ring_bytes(uploads, texture);
+                if (bytes > uploads.ring_space()) {
+                        // start over at the front of the ring, the wave has
+                        // to be in it before that
+                        fill_wave();
+                        uploads.flush();
+                        uploads.wait_idle();
+                }
+
+                if (!texture.compressed) {
+                        texture.staging = { uploads.stage_image(texture.texture.image._image, texture.extent, texture.levelSizes[0],
+                                texture.texture.mipLevels) };
+                } else {
+                        // the levels only fit one at a time, they are
+                        // copied in right away
+                        const bool oneByOne = bytes > uploads.ring_size();
+                        for (uint32_t level = 0; level < texture.levelSizes.size(); level++) {
+                                VkExtent3D levelExtent { std::max(texture.extent.width >> level, 1u), std::max(texture.extent.height >> level, 1u), 1 };
+                                void* staging = uploads.stage_image_level(texture.texture.image._image, level, levelExtent, texture.levelSizes[level]);
+                                if (oneByOne) {
+                                        memcpy(staging, texture.ktx.levels[level].data, texture.levelSizes[level]);
+                                }
+                                texture.staging.push_back(staging);
+                        }
+                        if (oneByOne) {
+                                continue;
+                        }
+                }
+                wave.push_back(i);
+        }
+        fill_wave();
+
+        for (size_t i = 0; i < pending.size(); i++) {
+                if (read[i]) {
+                        finish_texture(engine, pending[i]);
+                }
+        }
+        return filled;
+}
+
+bool load_single(VulkanEngine& engine, const char* file, PendingTexture& texture, bool read, Texture& outTexture)
+{
+        std::vector<PendingTexture> pending(1);
+        pending[0] = std::move(texture);
+        if (!read || !upload(engine, { file }, pending, { 1 })) {
+                return false;
+        }
+        outTexture = pending[0].texture;
         return true;
-};
+}
+
+}
+
+bool vkutil::load_image_from_file(VulkanEngine& engine, const char* file, Texture& outTexture)
+{
+        PendingTexture texture;
+        bool read = read_source(file, texture);
+        return load_single(engine, file, texture, read, outTexture);
+}
+
+bool vkutil::load_ktx2_from_file(VulkanEngine& engine, const char* file, Texture& outTexture)
+{
+        PendingTexture texture;
+        bool read = read_ktx2(engine, file, texture);
+        return load_single(engine, file, texture, read, outTexture);
+}
+
+bool vkutil::load_texture(VulkanEngine& engine, const char* file, Texture& outTexture)
+{
+        PendingTexture texture;
+        bool read = read_texture(engine, file, texture);
+        return load_single(engine, file, texture, read, outTexture);
+}
+
+bool vkutil::load_textures(VulkanEngine& engine, const std::vector<std::string>& files, std::vector<Texture>& outTextures)
+{
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // the headers, and the cooking of the textures that miss the cache
+        std::vector<PendingTexture> pending(files.size());
+        std::vector<uint8_t> read(files.size());
+        ThreadPool::global().parallel_for(files.size(), [&](size_t i) {
+                read[i] = read_texture(engine, files[i].c_str(), pending[i]);
+        });
+
+        bool loaded = upload(engine, files, pending, read);
+        // every copy in one submission
+        engine._uploads.flush();
+
+        outTextures.assign(files.size(), Texture {});
+        size_t count = 0;
+        for (size_t i = 0; i < files.size(); i++) {
+                if (read[i]) {
+                        outTextures[i] = pending[i].texture;
+                        count++;
+                } else {
+                        loaded = false;
+                }
+        }
+
+        std::chrono::duration<float, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+        std::cout << "Loaded " << count << " of " << files.size() << " textures in " << elapsed.count() << "ms on "
+                  << ThreadPool::global().size() << " threads" << std::endl;
+        return loaded;
+}
@@ -3,6 +3,28 @@
 #include "engine.hh"
 #include "types.hh"
 
+#include <string>
+#include <vector>
+
 namespace vkutil {
-bool load_image_from_file(VulkanEngine& engine, const char* file, AllocatedImage& outImage);
+// Loads an image file as an sRGB texture with a full mip chain, the view and
+// sampler cover every level. The texels are uploaded with the next flush of
+// the engine's uploads and the mips generated in the frame after it, the
+// texture is destroyed with the engine.
+bool load_image_from_file(VulkanEngine& engine, const char* file, Texture& outTexture);
+
+// Uploads the precompressed mip chain of a KTX2 file as is. Fails when the
+// device can't sample its format.
+bool load_ktx2_from_file(VulkanEngine& engine, const char* file, Texture& outTexture);
+
+// The cooked BC version of the image when the device supports BC, cooking it
+// first on a cache miss, the uncompressed path otherwise.
+bool load_texture(VulkanEngine& engine, const char* file, Texture& outTexture);
+
+// load_texture for many files at once. The files are read, cooked and
+// decoded on the thread pool straight into the upload ring, and all of the
+// copies are flushed together at the end. outTextures gets one entry per
+// file, the ones that can't be read stay empty and the ones that fail to
+// decode come out black.
+bool load_textures(VulkanEngine& engine, const std::vector<std::string>& files, std::vector<Texture>& outTextures);
 }
@@ -0,0 +1,139 @@
+#include "async_submit.hh"
+
+#include "initializers.hh"
+
+void AsyncSubmitter::init(VkDevice device, VkQueue queue, uint32_t queueFamily)
+{
+        _device = device;
+        _queue = queue;
+        _queueFamily = queueFamily;
+
+        VkSemaphoreTypeCreateInfo timelineInfo {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        timelineInfo.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphoreInfo {};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphoreInfo.pNext = &timelineInfo;
+        VK_CHECK(vkCreateSemaphore(_device, &semaphoreInfo, nullptr, &_timeline));
+        _lastValue = 0;
+}
+
+void AsyncSubmitter::destroy()
+{
+        if (_device == nullptr) {
+                return;
+        }
+
+        wait_idle();
+
+        // destroying the pools frees their command buffers
+        for (auto& [thread, commands] : _pools) {
+                vkDestroyCommandPool(_device, commands->pool, nullptr);
+        }
+        _pools.clear();
+
+        vkDestroySemaphore(_device, _timeline, nullptr);
+        _device = nullptr;
+}
+
+AsyncSubmitter::ThreadCommands& AsyncSubmitter::thread_commands()
+{
+        std::lock_guard<std::mutex> lock(_poolsMutex);
+
+        std::unique_ptr<ThreadCommands>& commands = _pools[std::this_thread::get_id()];
+        if (!commands) {
+                commands = std::make_unique<ThreadCommands>();
+                VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(
+                        _queueFamily, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+                VK_CHECK(vkCreateCommandPool(_device, &poolInfo, nullptr, &commands->pool));
+        }
+        return *commands;
+}
+
+SubmitToken AsyncSubmitter::submit(const std::function<void(VkCommandBuffer)>& function)
+{
+        // only this thread ever touches its pool, so recording needs no lock
+        ThreadCommands& commands = thread_commands();
+
+        uint64_t completed = 0;
+        VK_CHECK(vkGetSemaphoreCounterValue(_device, _timeline, &completed));
+        while (!commands.inFlight.empty() && commands.inFlight.front().first <= completed) {
+                commands.free.push_back(commands.inFlight.front().second);
+                commands.inFlight.pop_front();
+        }
+
+        VkCommandBuffer cmd;
+        if (!commands.free.empty()) {
+                cmd = commands.free.back();
+                commands.free.pop_back();
+        } else {
+                VkCommandBufferAllocateInfo allocInfo = vkinit::command_buffer_allocate_info(commands.pool);
+                VK_CHECK(vkAllocateCommandBuffers(_device, &allocInfo, &cmd));
+        }
+
+        // beginning implicitly resets the recycled buffer
+        VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+        VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+        function(cmd);
+        VK_CHECK(vkEndCommandBuffer(cmd));
+
+        SubmitToken token;
+        {
+                std::lock_guard<std::mutex> lock(_queueMutex);
+                token.value = _lastValue + 1;
+
+                VkTimelineSemaphoreSubmitInfo timelineInfo {};
+                timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+                timelineInfo.signalSemaphoreValueCount = 1;
+                timelineInfo.pSignalSemaphoreValues = &token.value;
+
+                VkSubmitInfo submit = vkinit::sumbit_info(&cmd);
+                submit.pNext = &timelineInfo;
+                submit.signalSemaphoreCount = 1;
+                submit.pSignalSemaphores = &_timeline;
+                VK_CHECK(vkQueueSubmit(_queue, 1, &submit, nullptr));
+
+                _lastValue = token.value;
+        }
+
+        commands.inFlight.emplace_back(token.value, cmd);
+        return token;
+}
+
+bool AsyncSubmitter::is_complete(SubmitToken token) const
+{
+        if (!token.valid()) {
+                return true;
+        }
+
+        uint64_t completed = 0;
+        VK_CHECK(vkGetSemaphoreCounterValue(_device, _timeline, &completed));
+        return completed >= token.value;
+}
+
+void AsyncSubmitter::wait(SubmitToken token) const
+{
+        if (!token.valid()) {
+                return;
+        }
+
+        VkSemaphoreWaitInfo waitInfo {};
+        waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        waitInfo.semaphoreCount = 1;
+        waitInfo.pSemaphores = &_timeline;
+        waitInfo.pValues = &token.value;
+        VK_CHECK(vkWaitSemaphores(_device, &waitInfo, UINT64_MAX));
+}
+
+void AsyncSubmitter::wait_idle() const
+{
+        wait(last_token());
+}
+
+SubmitToken AsyncSubmitter::last_token() const
+{
+        std::lock_guard<std::mutex> lock(_queueMutex);
+        return { _lastValue };
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "types.hh"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Completion token of an AsyncSubmitter submission, the timeline value the
+// submission signals once it finished.
+struct SubmitToken {
+        uint64_t value = 0;
+
+        // the default token stands for "nothing to wait for"
+        bool valid() const { return value != 0; }
+};
+
+// Records one off command buffers, submits them to its queue without waiting
+// and hands back a token to poll or wait on when the result is actually
+// needed. Every submission signals the next
+// value of a timeline semaphore, so other queues can wait for it on the gpu.
+//
+// Callable from any thread, every thread records from its own command pool
+// and the command buffers are recycled once their submission finished.
+class AsyncSubmitter {
+public:
+        void init(VkDevice device, VkQueue queue, uint32_t queueFamily);
+        void destroy();
+
+        SubmitToken submit(const std::function<void(VkCommandBuffer)>& function);
+
+        bool is_complete(SubmitToken token) const;
+        void wait(SubmitToken token) const;
+        // waits for everything submitted so far
+        void wait_idle() const;
+
+        SubmitToken last_token() const;
+        VkSemaphore timeline() const { return _timeline; }
+        VkQueue queue() const { return _queue; }
+        uint32_t queue_family() const { return _queueFamily; }
+
+        // The queue is externally synchronized, anything else submitting or
+        // presenting on it has to hold this lock.
+        std::unique_lock<std::mutex> lock_queue() { return std::unique_lock<std::mutex>(_queueMutex); }
+
+private:
+        struct ThreadCommands {
+                VkCommandPool pool = nullptr;
+                std::vector<VkCommandBuffer> free;
+                // command buffers still executing, with their timeline value
+                std::deque<std::pair<uint64_t, VkCommandBuffer>> inFlight;
+        };
+
+        // the calling thread's pool, created on first use
+        ThreadCommands& thread_commands();
+
+        VkDevice _device = nullptr;
+        VkQueue _queue = nullptr;
+        uint32_t _queueFamily = 0;
+
+        VkSemaphore _timeline = nullptr;
+        // guards the queue and _lastValue, values have to be signalled in
+        // submission order
+        mutable std::mutex _queueMutex;
+        uint64_t _lastValue = 0;
+
+        std::mutex _poolsMutex;
+        std::unordered_map<std::thread::id, std::unique_ptr<ThreadCommands>> _pools;
+};
@@ -0,0 +1,112 @@
+#include "bindless.hh"
+#include "initializers.hh"
+
+void BindlessDescriptors::init(VkDevice device, uint32_t framesInFlight)
+{
+        _device = device;
+
+        VkDescriptorSetLayoutBinding bindings[2] = {
+                vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0),
+                vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, VK_SHADER_STAGE_FRAGMENT_BIT, 1),
+        };
+        bindings[0].descriptorCount = BINDLESS_MAX_BUFFERS;
+        bindings[1].descriptorCount = BINDLESS_MAX_TEXTURES;
+
+        // update after bind pools get the much higher descriptor limits
+        const VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+        VkDescriptorBindingFlags flags[2] = { bindingFlags, bindingFlags };
+
+        VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo {};
+        flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+        flagsInfo.bindingCount = 2;
+        flagsInfo.pBindingFlags = flags;
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.pNext = &flagsInfo;
+        layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+        layoutInfo.bindingCount = 2;
+        layoutInfo.pBindings = bindings;
+        VK_CHECK(vkCreateDescriptorSetLayout(_device, &layoutInfo, nullptr, &_layout));
+
+        VkDescriptorPoolSize sizes[2] = {
+                { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, BINDLESS_MAX_BUFFERS * framesInFlight },
+                { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, BINDLESS_MAX_TEXTURES * framesInFlight },
+        };
+        VkDescriptorPoolCreateInfo poolInfo {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+        poolInfo.maxSets = framesInFlight;
+        poolInfo.poolSizeCount = 2;
+        poolInfo.pPoolSizes = sizes;
+        VK_CHECK(vkCreateDescriptorPool(_device, &poolInfo, nullptr, &_pool));
+
+        std::vector<VkDescriptorSetLayout> layouts(framesInFlight, _layout);
+        VkDescriptorSetAllocateInfo allocInfo {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = _pool;
+        allocInfo.descriptorSetCount = framesInFlight;
+        allocInfo.pSetLayouts = layouts.data();
+        _sets.resize(framesInFlight);
+        VK_CHECK(vkAllocateDescriptorSets(_device, &allocInfo, _sets.data()));
+
+        _pending.assign(framesInFlight, {});
+}
+
+void BindlessDescriptors::destroy()
+{
+        // the sets go with the pool
+        vkDestroyDescriptorPool(_device, _pool, nullptr);
+        vkDestroyDescriptorSetLayout(_device, _layout, nullptr);
+        _sets.clear();
+        _pending.clear();
+}
+
+void BindlessDescriptors::set_buffer(uint32_t slot, VkBuffer buffer, VkDeviceSize range)
+{
+        for (uint32_t frameIndex = 0; frameIndex < _pending.size(); frameIndex++) {
+                set_frame_buffer(frameIndex, slot, buffer, range);
+        }
+}
+
+void BindlessDescriptors::set_texture(uint32_t slot, const Texture& texture)
+{
+        if (slot >= BINDLESS_MAX_TEXTURES) {
+                return;
+        }
+        for (std::vector<Write>& pending : _pending) {
+                pending.push_back({ 1, slot, {}, { texture.sampler, texture.imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL } });
+        }
+}
+
+void BindlessDescriptors::set_frame_buffer(uint32_t frameIndex, uint32_t slot, VkBuffer buffer, VkDeviceSize range)
+{
+        if (slot >= BINDLESS_MAX_BUFFERS) {
+                return;
+        }
+        _pending[frameIndex].push_back({ 0, slot, { buffer, 0, range }, {} });
+}
+
+void BindlessDescriptors::update(uint32_t frameIndex)
+{
+        std::vector<Write>& pending = _pending[frameIndex];
+        if (pending.empty()) {
+                return;
+        }
+
+        // later writes to a slot win, vkUpdateDescriptorSets applies them
+        // in order
+        std::vector<VkWriteDescriptorSet> writes;
+        writes.reserve(pending.size());
+        for (Write& write : pending) {
+                VkWriteDescriptorSet descriptorWrite = write.binding == 0
+                        ? vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, _sets[frameIndex], &write.buffer, 0)
+                        : vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, _sets[frameIndex], &write.image, 1);
+                descriptorWrite.dstArrayElement = write.slot;
+                writes.push_back(descriptorWrite);
+        }
+        vkUpdateDescriptorSets(_device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        pending.clear();
+}
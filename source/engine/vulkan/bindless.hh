@@ -0,0 +1,57 @@
+#pragma once
+
+#include "types.hh"
+
+#include <vector>
+
+// array sizes of the bindless set, well below the update after bind limits
+// of every gpu with descriptor indexing
+constexpr uint32_t BINDLESS_MAX_BUFFERS = 256;
+constexpr uint32_t BINDLESS_MAX_TEXTURES = 4096;
+// the object buffer of the frame
+constexpr uint32_t BINDLESS_OBJECT_BUFFER = 0;
+// sampled by objects without a texture, or whose texture isn't resident yet
+constexpr uint32_t BINDLESS_DEFAULT_TEXTURE = 0;
+
+// One descriptor set per frame in flight with an array of storage buffers
+// (binding 0) and one of sampled textures (binding 1). Shaders index into
+// them, so the sets are bound once per frame no matter how many buffers and
+// textures the draws use.
+//
+// A set may still be in use by the frame before, so changes are queued for
+// every set and written by update() once the frame owning the set is done.
+// The arrays are partially bound, slots nobody wrote are fine as long as no
+// shader reads them.
+class BindlessDescriptors {
+public:
+        void init(VkDevice device, uint32_t framesInFlight);
+        void destroy();
+
+        VkDescriptorSetLayout layout() const { return _layout; }
+        VkDescriptorSet set(uint32_t frameIndex) const { return _sets[frameIndex]; }
+
+        // the same buffer or texture in the slot of every frame's set
+        void set_buffer(uint32_t slot, VkBuffer buffer, VkDeviceSize range);
+        void set_texture(uint32_t slot, const Texture& texture);
+        // a buffer only the set of frameIndex sees
+        void set_frame_buffer(uint32_t frameIndex, uint32_t slot, VkBuffer buffer, VkDeviceSize range);
+
+        // Writes the queued changes of the frame's set. Call after the
+        // frame's fence and before the set is bound.
+        void update(uint32_t frameIndex);
+
+private:
+        struct Write {
+                uint32_t binding;
+                uint32_t slot;
+                VkDescriptorBufferInfo buffer;
+                VkDescriptorImageInfo image;
+        };
+
+        VkDevice _device = VK_NULL_HANDLE;
+        VkDescriptorPool _pool = VK_NULL_HANDLE;
+        VkDescriptorSetLayout _layout = VK_NULL_HANDLE;
+        std::vector<VkDescriptorSet> _sets;
+        // per frame, in the order they were made
+        std::vector<std::vector<Write>> _pending;
+};
@@ -6,6 +6,7 @@
 
 #include "initializers.hh"
 #include "mesh.hh"
+#include "texture_cook.hh"
 #include "types.hh"
 
 #include <SDL.h>
@@ -16,6 +17,8 @@
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/transform.hpp>
 
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <iterator>
@@ -27,15 +30,20 @@ int newtime = 0;
 
 /*
     The descriptor set number 0 will be used for engine-global resources, and
-   bound once per frame. The descriptor set number 1 will be used for per-pass
-   resources, and bound once per pass. The descriptor set number 2 will be used
-   for material resources, and the number 3 will be used for per-object
-   resources. This way, the inner render loops will only be binding descriptor
-   sets 2 and 3, and performance will be high.
+   bound once per frame. The descriptor set number 1 is the bindless set with
+   every buffer and texture the shaders index into, also bound once per frame.
+   Materials and objects only carry indices into it, so the inner render loops
+   don't bind any descriptor sets at all.
 */
 
 //  Init (Main): SDL and all the vulkan components
 void VulkanEngine::init() {
+        // the assets come out of the pack when the baker wrote one, its
+        // entries are named relative to the build directory
+        if (std::filesystem::exists(ASSET_PACK_PATH)) {
+                Vfs::global().mount(ASSET_PACK_PATH, ".");
+        }
+
         // We initialize SDL and create a window with it.
 
         if (SDL_Init(SDL_INIT_VIDEO) < 0) {
@@ -61,11 +69,17 @@ void VulkanEngine::init() {
         init_default_renderpass();
         init_framebuffers();
         init_sync_structures();
+        init_uploads();
         init_descriptors();
         init_pipelines();
+        // the font upload runs on the gpu while the meshes load
+        init_imgui();
         load_meshes();
         init_scene();
-        init_imgui();
+
+        // the font pixels can go once they are on the gpu
+        _graphicsSubmitter.wait(_fontUpload);
+        ImGui_ImplVulkan_DestroyFontUploadObjects();
 
         // everything went fine
         _isInitialized = true;
@@ -104,6 +118,21 @@ void VulkanEngine::draw() {
         beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
 
+        // upload the meshes that finished loading and evict the ones over
+        // the budget, the fence above guarantees older frames are done
+        if (_meshStreamer.update(_frameNumber)) {
+                update_render_bounds();
+        }
+        // same for the mip levels of the textures
+        _textureStreamer.update(_frameNumber);
+        _uploads.flush();
+        // the frame before may still use the other set, this one is free
+        _bindless.update(_frameNumber % FRAME_OVERLAP);
+
+        // take over whatever finished uploading since the last frame, the
+        // submit below then waits for those copies on the gpu
+        uint64_t uploadWaitValue = _uploads.record_acquires(cmd);
+
         // make a clear-color from frame number. This will flash with a 120*pi
         // frame period.
         VkClearValue clearValue;
@@ -168,12 +197,24 @@ void VulkanEngine::draw() {
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
         submitInfo.pNext = nullptr;
 
-        VkPipelineStageFlags waitStage =
-            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        submitInfo.pWaitDstStageMask = &waitStage;
-
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = &get_current_frame()._presentSemaphore;
+        VkPipelineStageFlags waitStages[] = {
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT};
+        submitInfo.pWaitDstStageMask = waitStages;
+
+        // the upload timeline is only waited on in frames that use new data
+        VkSemaphore waitSemaphores[] = {get_current_frame()._presentSemaphore,
+                                        _uploads.timeline()};
+        // the value of the binary semaphore is ignored
+        uint64_t waitValues[] = {0, uploadWaitValue};
+        submitInfo.waitSemaphoreCount = uploadWaitValue > 0 ? 2 : 1;
+        submitInfo.pWaitSemaphores = waitSemaphores;
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo{};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = submitInfo.waitSemaphoreCount;
+        timelineInfo.pWaitSemaphoreValues = waitValues;
+        submitInfo.pNext = &timelineInfo;
 
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = &get_current_frame()._renderSemaphore;
@@ -181,6 +222,11 @@ void VulkanEngine::draw() {
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &cmd;
 
+        // other threads may submit to the graphics queue through
+        // _graphicsSubmitter, the queue has to be locked for the submit and
+        // the present
+        auto queueLock = _graphicsSubmitter.lock_queue();
+
         // submit the queue and execute it
         // renderfence will now block everything until this shit finishes
         // shitting
@@ -204,6 +250,7 @@ void VulkanEngine::draw() {
         presentInfo.pImageIndices = &swapchainImageIndex;
 
         auto result_present = vkQueuePresentKHR(_graphicsQueue, &presentInfo);
+        queueLock.unlock();
         if (result_present == VK_ERROR_OUT_OF_DATE_KHR ||
             result_present == VK_SUBOPTIMAL_KHR) {
                 _wasResized = true;
@@ -342,15 +389,35 @@ void VulkanEngine::init_vulkan() {
         SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
 
         // use VkBootstrap to detect the presence of neo
+        // timeline semaphores order the transfer queue against rendering
+        VkPhysicalDeviceVulkan12Features features12{};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.timelineSemaphore = VK_TRUE;
+        // bindless: runtime sized arrays of descriptors, indexed per object
+        // and updated while the other frame's set is in use
+        features12.runtimeDescriptorArray = VK_TRUE;
+        features12.descriptorBindingPartiallyBound = VK_TRUE;
+        features12.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        features12.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        features12.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+        features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
         vkb::PhysicalDeviceSelector selector{vkb_inst};
         vkb::PhysicalDevice physicalDevice =
             selector.set_minimum_version(1, 2)
                 .prefer_gpu_device_type(vkb::PreferredDeviceType::integrated)
                 .set_surface(_surface)
                 .add_required_extension("VK_KHR_shader_draw_parameters")
+                .set_required_features_12(features12)
                 .select()
                 .value();
 
+        // BC textures when there is support, desktop gpus all have it
+        VkPhysicalDeviceFeatures bcFeatures{};
+        bcFeatures.textureCompressionBC = VK_TRUE;
+        _textureCompressionBC =
+            physicalDevice.enable_features_if_present(bcFeatures);
+
         // Check if it's the real neo
         vkb::DeviceBuilder deviceBuilder{physicalDevice};
         VkPhysicalDeviceVulkan11Features feat{};
@@ -366,6 +433,31 @@ void VulkanEngine::init_vulkan() {
         _graphicsQueueFamily =
             vkbDevice.get_queue_index(vkb::QueueType::graphics).value();
 
+        // uploads go to a transfer only family when there is one, then any
+        // family besides graphics, and the graphics queue as the last resort
+        // (lavapipe and most integrated gpus only have the one family)
+        auto transferQueue =
+            vkbDevice.get_dedicated_queue(vkb::QueueType::transfer);
+        auto transferQueueIndex =
+            vkbDevice.get_dedicated_queue_index(vkb::QueueType::transfer);
+        if (!transferQueue.has_value()) {
+                transferQueue = vkbDevice.get_queue(vkb::QueueType::transfer);
+                transferQueueIndex =
+                    vkbDevice.get_queue_index(vkb::QueueType::transfer);
+        }
+        if (transferQueue.has_value()) {
+                _transferQueue = transferQueue.value();
+                _transferQueueFamily = transferQueueIndex.value();
+        } else {
+                _transferQueue = _graphicsQueue;
+                _transferQueueFamily = _graphicsQueueFamily;
+        }
+        std::cout << "Uploading on queue family " << _transferQueueFamily
+                  << (_transferQueueFamily == _graphicsQueueFamily
+                          ? " (shared with graphics)"
+                          : " (dedicated)")
+                  << std::endl;
+
         // init vulkanmemoryallocator
         VmaAllocatorCreateInfo allocatorInfo{};
         allocatorInfo.device = _device;
@@ -577,8 +669,6 @@ void VulkanEngine::init_commands() {
             vkinit::command_pool_create_info(
                 _graphicsQueueFamily,
                 VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
-        VkCommandPoolCreateInfo uploadCommandPoolInfo =
-            vkinit::command_pool_create_info(_graphicsQueueFamily);
 
         for (int i = 0; i < FRAME_OVERLAP; i++) {
                 VK_CHECK(vkCreateCommandPool(_device, &commandPoolInfo, nullptr,
@@ -596,13 +686,6 @@ void VulkanEngine::init_commands() {
                                              nullptr);
                 });
         }
-
-        VK_CHECK(vkCreateCommandPool(_device, &uploadCommandPoolInfo, nullptr,
-                                     &_uploadContext._commandPool));
-        _mainDeletionQueue.push_function([=]() {
-                vkDestroyCommandPool(_device, _uploadContext._commandPool,
-                                     nullptr);
-        });
 }
 
 //   Init (Render Pass): Init the renderpass
@@ -747,10 +830,6 @@ void VulkanEngine::init_sync_structures() {
         VkFenceCreateInfo fenceInfo =
             vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
 
-        VkFenceCreateInfo uploadFenceInfo{};
-        uploadFenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        uploadFenceInfo.pNext = nullptr;
-
         for (int i = 0; i < FRAME_OVERLAP; i++) {
 
                 VK_CHECK(vkCreateFence(_device, &fenceInfo, nullptr,
@@ -777,13 +856,46 @@ void VulkanEngine::init_sync_structures() {
                             _device, _frames[i]._presentSemaphore, nullptr);
                 });
         }
+}
 
-        VK_CHECK(vkCreateFence(_device, &uploadFenceInfo, nullptr,
-                               &_uploadContext._uploadFence));
+//  Init (Uploads): async submission on the graphics and transfer queues, and
+//  the staging ring shared by every asset upload
+void VulkanEngine::init_uploads() {
+        _graphicsSubmitter.init(_device, _graphicsQueue, _graphicsQueueFamily);
+        _mainDeletionQueue.push_function(
+            [=]() { _graphicsSubmitter.destroy(); });
+
+        // a queue can only have one submitter, it owns the queue lock
+        AsyncSubmitter* transferSubmitter = &_graphicsSubmitter;
+        if (_transferQueue != _graphicsQueue) {
+                _transferSubmitter.init(_device, _transferQueue,
+                                        _transferQueueFamily);
+                _mainDeletionQueue.push_function(
+                    [=]() { _transferSubmitter.destroy(); });
+                transferSubmitter = &_transferSubmitter;
+        }
 
-        _mainDeletionQueue.push_function([=]() {
-                vkDestroyFence(_device, _uploadContext._uploadFence, nullptr);
-        });
+        _uploads.init(_allocator, *transferSubmitter, _graphicsQueueFamily);
+        _mainDeletionQueue.push_function([=]() { _uploads.destroy(); });
+
+        // streamed textures are cooked for what the device can sample, a new
+        // image goes into its bindless slot, the one after the default texture
+        _textureStreamer.init(
+            _device, _allocator, _uploads, _textureCompressionBC,
+            [this](uint32_t image, const Texture& texture) {
+                    _bindless.set_texture(image + 1, texture);
+            },
+            FRAME_OVERLAP);
+        _mainDeletionQueue.push_function(
+            [=]() { _textureStreamer.destroy(); });
+
+        // the small textures the baker packed, served from their pages
+        const std::string manifest =
+            std::string(TEXTURE_CACHE_DIRECTORY) + "/" + ATLAS_MANIFEST;
+        if (Vfs::global().exists(manifest.c_str()) &&
+            !_textureStreamer.add_atlases(manifest.c_str(), "..")) {
+                std::cerr << "Failed to read " << manifest << std::endl;
+        }
 }
 
 //  Loader (Shader Module): Helper function to load the shader modules
@@ -791,32 +903,22 @@ void VulkanEngine::init_sync_structures() {
 //      in the second argument of the function
 bool VulkanEngine::load_shader_module(const char* filepath,
                                       VkShaderModule* outshaderModule) {
-        std::ifstream file(filepath, std::ios::ate | std::ios::binary);
-        if (!file.is_open()) {
+        // straight from the pack or the mapped file, both keep the words
+        // aligned
+        VfsFile file;
+        if (!Vfs::global().read(filepath, file) ||
+            file.size % sizeof(uint32_t) != 0) {
                 return false;
         }
 
-        // Find what the size of the file is by telling where the cursor is
-        // as we used std::ios::ate, the cursor will be at the end of the file
-        size_t fileSize = (size_t)file.tellg();
-        std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
-
-        // put the cursor back at the start of the file
-        // as now we need to read it
-        file.seekg(0);
-
-        // Read them bytes
-        file.read((char*)buffer.data(), fileSize);
-
-        file.close();
-
         VkShaderModuleCreateInfo shader_module_info{};
         shader_module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         shader_module_info.pNext = nullptr;
 
         // Supply vulkan with information about the file
-        shader_module_info.codeSize = buffer.size() * sizeof(uint32_t);
-        shader_module_info.pCode = buffer.data();
+        shader_module_info.codeSize = file.size;
+        shader_module_info.pCode =
+            reinterpret_cast<const uint32_t*>(file.data);
 
         VkShaderModule shaderModule;
         if (vkCreateShaderModule(_device, &shader_module_info, nullptr,
@@ -832,7 +934,7 @@ bool VulkanEngine::load_shader_module(const char* filepath,
 //  Init (Pipeline): Init the rendering pipeline(s) with
 //      everything that was setup
 void VulkanEngine::init_pipelines() {
-        VkShaderModule meshVertShader, colorMeshShader;
+        VkShaderModule meshVertShader, colorMeshShader, depthVertShader;
 
         if (!load_shader_module("../shaders/compiled/tri_mesh.vert.spv",
                                 &meshVertShader)) {
@@ -852,6 +954,15 @@ void VulkanEngine::init_pipelines() {
                           << std::endl;
         }
 
+        if (!load_shader_module("../shaders/compiled/depth_only.vert.spv",
+                                &depthVertShader)) {
+                std::cout << "Failed to create depth only vertex shader."
+                          << std::endl;
+        } else {
+                std::cout << "Successfully created depth only vertex shader."
+                          << std::endl;
+        }
+
         // not using any desc. sets or anything so it's good for now.
         VkPipelineLayoutCreateInfo pipeline_layout_info =
             vkinit::pipeline_layout_create_info();
@@ -913,22 +1024,13 @@ void VulkanEngine::init_pipelines() {
         // remove the old shaders and make way for the new ones. Liberal moment.
         pipelineBuilder._shaderStages.clear();
 
-        VkPushConstantRange pushConstantRange{};
-        pushConstantRange.offset = 0; // first member in struct
-        pushConstantRange.size = sizeof(MeshPushConstants);
-        pushConstantRange.stageFlags =
-            VK_SHADER_STAGE_VERTEX_BIT; // because the mesh shader is a vertex
-                                        // shader
-
-        // start with a default, empty layout info
+        // start with a default, empty layout info, the objects come from
+        // the object buffer so there are no push constants
         VkPipelineLayoutCreateInfo mesh_pipeline_layout_info =
             vkinit::pipeline_layout_create_info();
 
-        mesh_pipeline_layout_info.pushConstantRangeCount = 1;
-        mesh_pipeline_layout_info.pPushConstantRanges = &pushConstantRange;
-
         VkDescriptorSetLayout setLayouts[2] = {_globalSetLayout,
-                                               _objectSetLayout};
+                                               _bindless.layout()};
         mesh_pipeline_layout_info.setLayoutCount = 2;
         mesh_pipeline_layout_info.pSetLayouts = setLayouts;
 
@@ -951,105 +1053,239 @@ void VulkanEngine::init_pipelines() {
 
         create_material(_meshPipeline, _meshPipelineLayout, "defaultmaterial");
 
+        // same pipeline again, but reading PackedVertex. The vertex shader
+        // switches to decoding it through a specialization constant.
+        VertexInputDescription packedVertexDescription =
+            Vertex::get_vertex_input_desc(VertexFormat::Packed);
+        pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions =
+            packedVertexDescription.attributes.data();
+        pipelineBuilder._vertexInputInfo.vertexAttributeDescriptionCount =
+            packedVertexDescription.attributes.size();
+        pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions =
+            packedVertexDescription.bindings.data();
+        pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount =
+            packedVertexDescription.bindings.size();
+
+        VkBool32 packedVertices = VK_TRUE;
+        VkSpecializationMapEntry packedEntry{};
+        packedEntry.constantID = 0;
+        packedEntry.offset = 0;
+        packedEntry.size = sizeof(VkBool32);
+
+        VkSpecializationInfo packedSpecialization{};
+        packedSpecialization.mapEntryCount = 1;
+        packedSpecialization.pMapEntries = &packedEntry;
+        packedSpecialization.dataSize = sizeof(VkBool32);
+        packedSpecialization.pData = &packedVertices;
+        pipelineBuilder._shaderStages[0].pSpecializationInfo =
+            &packedSpecialization;
+
+        _packedMeshPipeline =
+            pipelineBuilder.build_pipeline(_device, _renderpass);
+
+        create_material(_packedMeshPipeline, _meshPipelineLayout,
+                        "packedmaterial");
+
+        // Both again for meshes with split off positions, the shader doesn't
+        // care which binding the attributes come from. Then the depth only
+        // pipelines, reading nothing but the position stream.
+        const VertexFormat formats[2] = {VertexFormat::Full,
+                                         VertexFormat::Packed};
+        for (VertexFormat format : formats) {
+                size_t index = static_cast<size_t>(format);
+                bool packed = format == VertexFormat::Packed;
+
+                VertexInputDescription splitDescription =
+                    Vertex::get_vertex_input_desc(format, VertexLayout::Split);
+                pipelineBuilder._vertexInputInfo.pVertexAttributeDescriptions =
+                    splitDescription.attributes.data();
+                pipelineBuilder._vertexInputInfo
+                    .vertexAttributeDescriptionCount =
+                    splitDescription.attributes.size();
+                pipelineBuilder._vertexInputInfo.pVertexBindingDescriptions =
+                    splitDescription.bindings.data();
+                pipelineBuilder._vertexInputInfo.vertexBindingDescriptionCount =
+                    splitDescription.bindings.size();
+                pipelineBuilder._shaderStages[0].pSpecializationInfo =
+                    packed ? &packedSpecialization : nullptr;
+
+                _splitMeshPipelines[index] =
+                    pipelineBuilder.build_pipeline(_device, _renderpass);
+                create_material(_splitMeshPipelines[index], _meshPipelineLayout,
+                                packed ? "packedsplitmaterial"
+                                       : "defaultsplitmaterial");
+        }
+
+        // no fragment shader and no color writes, only the depth buffer
+        PipelineBuilder depthBuilder = pipelineBuilder;
+        depthBuilder._shaderStages.clear();
+        depthBuilder._shaderStages.push_back(
+            vkinit::pipeline_shader_stage_create_info(
+                VK_SHADER_STAGE_VERTEX_BIT, depthVertShader));
+        depthBuilder._colorBlendAttachment.colorWriteMask = 0;
+
+        for (VertexFormat format : formats) {
+                size_t index = static_cast<size_t>(format);
+                bool packed = format == VertexFormat::Packed;
+
+                // packed positions are unorm, the model matrix scales them back
+                VertexInputDescription depthDescription =
+                    Vertex::get_vertex_input_desc(format,
+                                                  VertexLayout::PositionOnly);
+                depthBuilder._vertexInputInfo.pVertexAttributeDescriptions =
+                    depthDescription.attributes.data();
+                depthBuilder._vertexInputInfo.vertexAttributeDescriptionCount =
+                    depthDescription.attributes.size();
+                depthBuilder._vertexInputInfo.pVertexBindingDescriptions =
+                    depthDescription.bindings.data();
+                depthBuilder._vertexInputInfo.vertexBindingDescriptionCount =
+                    depthDescription.bindings.size();
+
+                _depthPipelines[index] =
+                    depthBuilder.build_pipeline(_device, _renderpass);
+                create_material(_depthPipelines[index], _meshPipelineLayout,
+                                packed ? "packeddepthmaterial"
+                                       : "defaultdepthmaterial");
+        }
+
         // destroy all shader modules, outside of the queue
         vkDestroyShaderModule(_device, meshVertShader, nullptr);
         vkDestroyShaderModule(_device, colorMeshShader, nullptr);
+        vkDestroyShaderModule(_device, depthVertShader, nullptr);
 
         _mainDeletionQueue.push_function([=]() {
-                // destroy the 2 pipelines we have created
+                // destroy the pipelines we have created
                 vkDestroyPipeline(_device, _meshPipeline, nullptr);
+                vkDestroyPipeline(_device, _packedMeshPipeline, nullptr);
+                for (size_t i = 0; i < 2; i++) {
+                        vkDestroyPipeline(_device, _splitMeshPipelines[i],
+                                          nullptr);
+                        vkDestroyPipeline(_device, _depthPipelines[i], nullptr);
+                }
 
                 // destroy the pipeline layout that they use
                 vkDestroyPipelineLayout(_device, _meshPipelineLayout, nullptr);
         });
 }
 
-//  Loader (Meshes): get the meshes, upload to the GPU and send to the scene
+//  Loader (Meshes): register the meshes with the streamer, only the ones
+//  built in code are uploaded here, the models load once they are visible
 void VulkanEngine::load_meshes() {
+        Mesh triangle;
         // make the array 3 vertices long
-        _triangleMesh._vertices.resize(3);
+        triangle._vertices.resize(3);
 
         // vertex positions
-        _triangleMesh._vertices[0].position = {0.5f, 0.5f, 0.0f};
-        _triangleMesh._vertices[1].position = {-0.5f, 0.5f, 0.0f};
-        _triangleMesh._vertices[2].position = {0.f, -0.5f, 0.0f};
+        triangle._vertices[0].position = {0.5f, 0.5f, 0.0f};
+        triangle._vertices[1].position = {-0.5f, 0.5f, 0.0f};
+        triangle._vertices[2].position = {0.f, -0.5f, 0.0f};
 
         // She's like a rainbow!
-        _triangleMesh._vertices[0].color = {0.1f, 1.0f, 0.1f};
-        _triangleMesh._vertices[1].color = {1.0f, 1.0f, 0.1f};
-        _triangleMesh._vertices[2].color = {0.1f, 0.1f, 1.0f};
+        triangle._vertices[0].color = {0.1f, 1.0f, 0.1f};
+        triangle._vertices[1].color = {1.0f, 1.0f, 0.1f};
+        triangle._vertices[2].color = {0.1f, 0.1f, 1.0f};
 
         // we don't care about the vertex normals
 
-        _carMesh.load_from_obj("../models/suzanne.obj");
-        _monkeyMesh.load_from_obj("../models/suzanne_2.obj");
-
-        upload_mesh(_triangleMesh);
-        upload_mesh(_monkeyMesh);
-        upload_mesh(_carMesh);
-
-        _meshes["monkey"] = _monkeyMesh;
-        _meshes["triangle"] = _triangleMesh;
-        _meshes["car"] = _carMesh;
+        triangle._indices = {0, 1, 2};
+        triangle.compute_bounds();
+
+        // grey unit cube standing in for meshes that are still loading
+        Mesh placeholder;
+        placeholder._vertices.resize(8);
+        for (int i = 0; i < 8; i++) {
+                Vertex& vertex = placeholder._vertices[i];
+                vertex.position = {i & 1 ? 0.5f : -0.5f, i & 2 ? 0.5f : -0.5f,
+                                   i & 4 ? 0.5f : -0.5f};
+                vertex.normals = glm::normalize(vertex.position);
+                vertex.color = {0.5f, 0.5f, 0.5f};
+        }
+        placeholder._indices = {0, 2, 1, 1, 2, 3, 4, 5, 6, 5, 7, 6,
+                                0, 1, 4, 1, 5, 4, 2, 6, 3, 3, 6, 7,
+                                0, 4, 2, 2, 4, 6, 1, 3, 5, 3, 7, 5};
+        placeholder.compute_bounds();
+
+        // every mesh is uploaded into these two buffers
+        _geometryArena.init(_allocator, GEOMETRY_VERTEX_CAPACITY,
+                            GEOMETRY_INDEX_CAPACITY);
+        _mainDeletionQueue.push_function([=]() { _geometryArena.destroy(); });
+
+        _meshStreamer.init(
+            _allocator, _geometryArena,
+            [this](Mesh& mesh) { upload_mesh(mesh); }, FRAME_OVERLAP);
+        // runs before the arena is destroyed, waits for the running loads
+        _mainDeletionQueue.push_function([=]() { _meshStreamer.destroy(); });
+
+        // the copies are batched and submitted together by end_phase
+        _uploads.begin_phase("meshes");
+        _placeholderMesh =
+            _meshStreamer.add("placeholder", std::move(placeholder));
+        _meshStreamer.add("triangle", std::move(triangle));
+        _uploads.end_phase();
+
+        // cooked versions of the models are used when they are up to date
+        // the models are stored packed, the triangle is too small to care.
+        // Their positions get a stream of their own for the depth prepass.
+        _meshStreamer.add("car", "../models/suzanne.obj", VertexFormat::Packed,
+                          true);
+        _meshStreamer.add("monkey", "../models/suzanne_2.obj",
+                          VertexFormat::Packed, true);
 }
 
 //  Helper for Loader (Meshes): Upload the given mesh to the GPU memory
 void VulkanEngine::upload_mesh(Mesh& mesh) {
-        const size_t bufferSize = mesh._vertices.size() * sizeof(Vertex);
-        // allocate staging buffer
-        VkBufferCreateInfo stagingBufferInfo{};
-        stagingBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        stagingBufferInfo.pNext = nullptr;
-
-        stagingBufferInfo.size = bufferSize;
-        stagingBufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-
-        VmaAllocationCreateInfo vmaallocInfo{};
-        vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-
-        AllocatedBuffer stagingBuffer;
-
-        VK_CHECK(vmaCreateBuffer(_allocator, &stagingBufferInfo, &vmaallocInfo,
-                                 &stagingBuffer._buffer,
-                                 &stagingBuffer._allocation, nullptr));
-
-        void* data;
-        vmaMapMemory(_allocator, stagingBuffer._allocation, &data);
-        std::memcpy(data, mesh._vertices.data(),
-                    mesh._vertices.size() * sizeof(Vertex));
-        vmaUnmapMemory(_allocator, stagingBuffer._allocation);
-
-        VkBufferCreateInfo vertexBufferInfo{};
-        vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        vertexBufferInfo.pNext = nullptr;
-
-        vertexBufferInfo.size = bufferSize;
-
-        vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                                 VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-
-        vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-        VK_CHECK(vmaCreateBuffer(_allocator, &vertexBufferInfo, &vmaallocInfo,
-                                 &mesh._vertexBuffer._buffer,
-                                 &mesh._vertexBuffer._allocation, nullptr));
-
-        immediate_submit([=](VkCommandBuffer cmd) {
-                VkBufferCopy copy;
-                copy.dstOffset = 0;
-                copy.srcOffset = 0;
-                copy.size = bufferSize;
-                vkCmdCopyBuffer(cmd, stagingBuffer._buffer,
-                                mesh._vertexBuffer._buffer, 1, &copy);
-        });
+        // a mesh that failed to load has nothing to upload
+        if (mesh.vertex_count() == 0 || mesh.index_count() == 0) {
+                std::cout << "Skipping upload of an empty mesh." << std::endl;
+                return;
+        }
 
-        // add the destruction of mesh buffer to the deletion queue
-        _mainDeletionQueue.push_function([=]() {
-                vmaDestroyBuffer(_allocator, mesh._vertexBuffer._buffer,
-                                 mesh._vertexBuffer._allocation);
-        });
+        const size_t vertexBufferSize =
+            mesh.vertex_count() * mesh.attribute_stride();
+        const size_t indexBufferSize = mesh.index_count() * mesh.index_size();
+        // the split off positions go into the vertex buffer as well
+        const size_t positionBufferSize =
+            mesh._splitPositions ? mesh.vertex_count() * mesh.position_stride()
+                                 : 0;
+
+        // find the mesh a place in the arena, making room if it is full
+        while (!_geometryArena.allocate(
+            vertexBufferSize, mesh.attribute_stride(), indexBufferSize,
+            mesh._geometry, positionBufferSize, mesh.position_stride())) {
+                // pending copies still point at the old buffers and those are
+                // destroyed by the grow, so finish them (including the move
+                // to the graphics queue) and any frame using the buffers first
+                _uploads.flush();
+                _uploads.wait_idle();
+                _graphicsSubmitter.wait(submit_async([&](VkCommandBuffer cmd) {
+                        _uploads.record_acquires(cmd);
+                }));
+                vkDeviceWaitIdle(_device);
+                _geometryArena.grow(
+                    std::max(_geometryArena.vertex_ranges().capacity() * 2,
+                             _geometryArena.vertex_ranges().capacity() +
+                                 vertexBufferSize + positionBufferSize),
+                    std::max(_geometryArena.index_ranges().capacity() * 2,
+                             _geometryArena.index_ranges().capacity() +
+                                 indexBufferSize),
+                    [this](std::function<void(VkCommandBuffer)>&& function) {
+                            _graphicsSubmitter.wait(submit_async(function));
+                    });
+        }
 
-        vmaDestroyBuffer(_allocator, stagingBuffer._buffer,
-                         stagingBuffer._allocation);
+        // the copies only happen on the next flush, cooked meshes are
+        // copied straight out of their file mapping into the ring
+        mesh.write_vertices(_uploads.stage_buffer(
+            _geometryArena.vertex_buffer(), mesh._geometry.vertexOffset,
+            vertexBufferSize));
+        if (mesh._splitPositions) {
+                mesh.write_positions(_uploads.stage_buffer(
+                    _geometryArena.vertex_buffer(),
+                    mesh._geometry.positionOffset, positionBufferSize));
+        }
+        mesh.write_indices(_uploads.stage_buffer(_geometryArena.index_buffer(),
+                                                 mesh._geometry.indexOffset,
+                                                 indexBufferSize));
 }
 
 //  Helper (Materials): Create a material from the scene
@@ -1072,20 +1308,38 @@ Material* VulkanEngine::get_material(const std::string& name) {
                 return &(*item).second;
 }
 
-//  Helper (Meshes): Get a mesh from the scene
-Mesh* VulkanEngine::get_mesh(const std::string& name) {
-        auto item = _meshes.find(name);
-        if (item == _meshes.end())
-                return nullptr;
-        else
-                return &(*item).second;
+//  Helper (Materials): Get the default material able to read the vertex
+//  format and layout
+Material* VulkanEngine::get_material_for(VertexFormat format,
+                                         VertexLayout layout) {
+        std::string name =
+            format == VertexFormat::Packed ? "packed" : "default";
+        if (layout == VertexLayout::Split) {
+                name += "split";
+        } else if (layout == VertexLayout::PositionOnly) {
+                name += "depth";
+        }
+        return get_material(name + "material");
+}
+
+//  Helper (Meshes): Get the handle of a mesh from the scene
+MeshHandle VulkanEngine::get_mesh(const std::string& name) {
+        return _meshStreamer.find(name);
 }
 
 //  Helper (Scene)
 void VulkanEngine::init_scene() {
+        // the checker streams its mips in with the size it's drawn at, the
+        // small ones come out of the baked atlas when there is one
+        TextureHandle checker = _textureStreamer.add("../textures/checker.png");
+        TextureHandle stripes = _textureStreamer.add("../textures/stripes.png");
+        TextureHandle dots = _textureStreamer.add("../textures/dots.png");
+
         RenderObject monkey;
         monkey.mesh = get_mesh("monkey");
-        monkey.material = get_material("defaultmaterial");
+        // the format is known before the mesh is loaded
+        monkey.material = get_material_for(_meshStreamer.format(monkey.mesh),
+                                           _meshStreamer.layout(monkey.mesh));
         monkey.transformMatrix = glm::mat4{1.0f};
 
         glm::mat4 translation =
@@ -1094,13 +1348,16 @@ void VulkanEngine::init_scene() {
             glm::scale(glm::mat4{1.0f}, glm::vec3(0.5f, 0.5f, 0.5f));
 
         monkey.transformMatrix = translation * scale;
+        monkey.texture = stripes;
         // yo me wanna render monke hoot hoot
         _renderables.push_back(monkey);
 
         RenderObject car;
         car.mesh = get_mesh("car");
-        car.material = get_material("defaultmaterial");
+        car.material = get_material_for(_meshStreamer.format(car.mesh),
+                                        _meshStreamer.layout(car.mesh));
         car.transformMatrix = glm::mat4{1.0f};
+        car.texture = checker;
 
         _renderables.push_back(car);
 
@@ -1122,6 +1379,7 @@ void VulkanEngine::init_scene() {
                             glm::mat4{1.0f}, glm::vec3(0.2f, 0.2f, 0.2f));
 
                         triangles.transformMatrix = translation * scale;
+                        triangles.texture = dots;
 
                         // illuminati moment + triangle moment + didn't ask +
                         // who asked ... and so on
@@ -1129,6 +1387,9 @@ void VulkanEngine::init_scene() {
                 }
         }
 
+        // nothing is streamed in yet, the objects start out as placeholders
+        update_render_bounds();
+
         // std::sort(_renderables.begin(), _renderables.end(),
         //           [](RenderObject a, RenderObject b) {
         //               if (a.material == b.material) {
@@ -1141,6 +1402,15 @@ void VulkanEngine::init_scene() {
         //           });
 }
 
+//  Helper (Scene): Recompute the world bounds of the objects from the
+//  bounds of their meshes, which are known before the meshes are resident
+//  when they were cooked, so a mesh still loading is culled by its real size
+void VulkanEngine::update_render_bounds() {
+        for (RenderObject& object : _renderables) {
+                object.update_bounds(_meshStreamer.bounds(object.mesh));
+        }
+}
+
 //  Drawcall (Scene): Draw all the objects that are in provided to the provided
 //  command buffer
 void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject* first,
@@ -1171,6 +1441,9 @@ void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject* first,
         cameraData.rotation = rotation;
         cameraData.viewproj = projection * rotation * view;
 
+        // camera position in world space, used to cull back facing meshlets
+        glm::vec3 eye = glm::vec3(glm::inverse(rotation * view)[3]);
+
         // aaaaand set it over
         void* data;
         vmaMapMemory(_allocator, get_current_frame().cameraBuffer._allocation,
@@ -1199,78 +1472,250 @@ void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject* first,
         // SSBO = Shared Storage Buffer Object
         GPUObjectData* objectSSBO = (GPUObjectData*)objectData;
 
+        // objects outside the frustum don't count as visible, so their
+        // meshes are neither loaded nor kept resident
+        Frustum frustum = extract_frustum(cameraData.viewproj);
+        Mesh* placeholder = _meshStreamer.resident(_placeholderMesh);
+        Material* placeholderMaterial = get_material_for(placeholder->_format);
+        _drawnMeshes.assign(count, nullptr);
+
+        // the visible objects are packed at the front of the buffer, in
+        // order, so runs of them can be drawn instanced
+        uint32_t instance = 0;
         for (int i = 0; i < count; i++) {
                 RenderObject& object = first[i];
-                objectSSBO[i].modelMatrix = object.transformMatrix;
+                if (!sphere_in_frustum(frustum, object.worldBounds.center,
+                                       object.worldBounds.radius)) {
+                        continue;
+                }
+
+                Mesh* mesh = _meshStreamer.request(object.mesh, _frameNumber);
+                _drawnMeshes[i] = mesh ? mesh : placeholder;
+                GPUObjectData& gpuObject = objectSSBO[instance++];
+                // packed meshes need their positions scaled back first
+                gpuObject.modelMatrix =
+                    object.transformMatrix * _drawnMeshes[i]->vertex_transform();
+                // white until the texture has any level resident
+                const bool textured =
+                    _textureStreamer.resident(object.texture) != nullptr;
+                gpuObject.textureIndex =
+                    textured ? texture_slot(object.texture)
+                             : BINDLESS_DEFAULT_TEXTURE;
+                // where in its atlas page the texture is
+                gpuObject.uvRect = glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
+                if (textured) {
+                        const UvRect& rect =
+                            _textureStreamer.uv_rect(object.texture);
+                        gpuObject.uvRect =
+                            glm::vec4(rect.scale[0], rect.scale[1],
+                                      rect.offset[0], rect.offset[1]);
+                }
         }
 
         vmaUnmapMemory(_allocator,
                        get_current_frame().objectBuffer._allocation);
 
-        Mesh* lastMesh = nullptr;
+        // pick what to draw of every object up front, the depth prepass and
+        // the main pass have to rasterize exactly the same triangles
+        _drawRanges.clear();
+        instance = 0;
+        for (int i = 0; i < count; i++) {
+                RenderObject& object = first[i];
+                Mesh* mesh = _drawnMeshes[i];
+                if (mesh == nullptr) {
+                        continue;
+                }
+                const uint32_t objectInstance = instance++;
+
+                // pick the detail level from how big the mesh is on screen:
+                // one model unit covers scale * focal length / distance pixels
+                const Bounds& bounds = object.worldBounds;
+                float scale = std::max(
+                    {glm::length(glm::vec3(object.transformMatrix[0])),
+                     glm::length(glm::vec3(object.transformMatrix[1])),
+                     glm::length(glm::vec3(object.transformMatrix[2]))});
+                float distance =
+                    std::max(glm::length(bounds.center - eye) - bounds.radius,
+                             0.1f);
+                float pixelsPerUnit = scale * std::abs(projection[1][1]) *
+                                      (_windowExtent.height * 0.5f) / distance;
+                size_t level = mesh->select_lod(pixelsPerUnit);
+                _lodHistogram[level]++;
+
+                // the texture wants a texel for every pixel the mesh covers
+                if (object.texture.valid()) {
+                        _textureStreamer.request(
+                            object.texture,
+                            pixelsPerUnit * 2.0f * mesh->_bounds.radius,
+                            _frameNumber);
+                }
+
+                if (level > 0 || mesh->_meshlets.empty()) {
+                        MeshLod lod = mesh->lod(level);
+                        _drawRanges.push_back({static_cast<uint32_t>(i),
+                                               objectInstance, 1,
+                                               lod.firstIndex, lod.indexCount});
+                        continue;
+                }
+
+                // only draw the clusters facing the camera and inside the
+                // frustum, the culling happens in model space
+                glm::vec3 modelEye = glm::vec3(
+                    glm::inverse(object.transformMatrix) * glm::vec4(eye, 1.0f));
+                _visibleRanges.clear();
+                cull_meshlets(mesh->_meshlets,
+                              cameraData.viewproj * object.transformMatrix,
+                              modelEye, _visibleRanges, _meshletStats);
+
+                for (const IndexRange& range : _visibleRanges) {
+                        _drawRanges.push_back({static_cast<uint32_t>(i),
+                                               objectInstance, 1,
+                                               range.firstIndex,
+                                               range.indexCount});
+                }
+        }
+
+        // the placeholder has its own vertex format
+        auto material_of = [&](const DrawRange& draw) {
+                return _drawnMeshes[draw.object] == placeholder
+                           ? placeholderMaterial
+                           : first[draw.object].material;
+        };
+
+        // Batching: a draw of the same triangles of the same mesh with the
+        // same material as the one before, for the object right after it,
+        // becomes another instance of that draw. The vertex shaders find
+        // their object with gl_InstanceIndex, which starts at firstInstance.
+        size_t batched = 0;
+        for (size_t i = 0; i < _drawRanges.size(); i++) {
+                const DrawRange& draw = _drawRanges[i];
+                if (batched > 0) {
+                        DrawRange& last = _drawRanges[batched - 1];
+                        if (last.firstInstance + last.instanceCount ==
+                                draw.firstInstance &&
+                            _drawnMeshes[last.object] ==
+                                _drawnMeshes[draw.object] &&
+                            last.firstIndex == draw.firstIndex &&
+                            last.indexCount == draw.indexCount &&
+                            material_of(last) == material_of(draw)) {
+                                last.instanceCount++;
+                                continue;
+                        }
+                }
+                _drawRanges[batched++] = draw;
+        }
+        _drawRanges.resize(batched);
+
         Material* lastMaterial = nullptr;
+        // the index type is the only thing that can differ between meshes
+        VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
+
+        // every material shares the pipeline layout, so the sets stay bound
+        // across pipeline switches: the global data and the bindless set
+        uint32_t uniform_offset =
+            pad_uniform_buffer(sizeof(GPUSceneData)) * frameIndex;
+        VkDescriptorSet descriptorSets[2] = {
+            get_current_frame().globalDescriptorSet, _bindless.set(frameIndex)};
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                _meshPipelineLayout, 0, 2, descriptorSets, 1,
+                                &uniform_offset);
+
+        // only bind the pipeline if it doesnt match with the already bound one
+        auto bind_material = [&](Material* material) {
+                if (material == lastMaterial) {
+                        return;
+                }
+                vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                  material->pipeline);
+                lastMaterial = material;
+        };
+
+        // the meshes share the index buffer, but 16 and 32 bit indices need a
+        // rebind with the other type
+        auto bind_indices = [&](const Mesh* mesh) {
+                if (mesh->index_type() != lastIndexType) {
+                        lastIndexType = mesh->index_type();
+                        vkCmdBindIndexBuffer(cmd, _geometryArena.index_buffer(),
+                                             0, lastIndexType);
+                }
+        };
+
+        // all the geometry lives in the arena, bind it once for the frame
+        VkBuffer vertexBuffer = _geometryArena.vertex_buffer();
+        VkDeviceSize vertexBufferOffset = 0;
+        vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &vertexBufferOffset);
+
+        // Depth prepass: the position streams are in the same buffer, so they
+        // are drawn straight from the binding above. Meshes without one are
+        // only depth tested in the main pass.
+        if (_depthPrepass) {
+                Material* depthMaterials[2] = {
+                    get_material_for(VertexFormat::Full,
+                                     VertexLayout::PositionOnly),
+                    get_material_for(VertexFormat::Packed,
+                                     VertexLayout::PositionOnly)};
+
+                for (const DrawRange& draw : _drawRanges) {
+                        Mesh* mesh = _drawnMeshes[draw.object];
+                        if (!mesh->_splitPositions) {
+                                continue;
+                        }
+
+                        bind_material(
+                            depthMaterials[static_cast<size_t>(mesh->_format)]);
+                        bind_indices(mesh);
+                        vkCmdDrawIndexed(cmd, draw.indexCount,
+                                         draw.instanceCount,
+                                         mesh->first_index() + draw.firstIndex,
+                                         mesh->position_offset(),
+                                         draw.firstInstance);
+                        _currentDrawCalls++;
+                }
+        }
 
         /*
         There is no need to rebind the same vertex buffer over and over between
-        draws, and the pipeline is the same, but we are pushing the constants on
-        every single call. The loop here is a lot higher performance that you
-        would think. This simple loop will render thousands and thousands of
-        objects with no issue. Binding pipeline is a expensive call, but drawing
-        the same object over and over with different push constants is very
-        fast.
+        draws, and the pipeline is the same. Binding pipeline is a expensive
+        call, but drawing the same object over and over is very fast.
             - VkGuide.
-      */
 
-        for (int i = 0; i < count; i++) {
-                RenderObject& object = first[i];
+        Repeated objects are batched into instanced draws above, so there is
+        not even that many draws left.
+      */
 
-                // only bind the pipeline if it doesnt match with the already
-                // bound one
-                if (object.material != lastMaterial) {
-                        vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                                          object.material->pipeline);
-                        lastMaterial = object.material;
-
-                        uint32_t uniform_offset =
-                            pad_uniform_buffer(sizeof(GPUSceneData)) *
-                            frameIndex;
-                        vkCmdBindDescriptorSets(
-                            cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            object.material->pipelineLayout, 0, 1,
-                            &get_current_frame().globalDescriptorSet, 1,
-                            &uniform_offset);
-
-                        // object data descriptor
-                        vkCmdBindDescriptorSets(
-                            cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            object.material->pipelineLayout, 1, 1,
-                            &get_current_frame().objectDescriptorSet, 0,
-                            nullptr);
+        // Meshes with split positions read two streams that sit at unrelated
+        // offsets, which vertexOffset can't express for both. They get the
+        // two bindings pointed at their ranges instead.
+        const Mesh* boundSplitMesh = nullptr;
+
+        for (const DrawRange& draw : _drawRanges) {
+                Mesh* mesh = _drawnMeshes[draw.object];
+                bind_material(material_of(draw));
+                bind_indices(mesh);
+
+                int32_t vertexOffset = mesh->vertex_offset();
+                if (mesh->_splitPositions) {
+                        if (mesh != boundSplitMesh) {
+                                VkBuffer buffers[2] = {vertexBuffer,
+                                                       vertexBuffer};
+                                VkDeviceSize offsets[2] = {
+                                    mesh->_geometry.positionOffset,
+                                    mesh->_geometry.vertexOffset};
+                                vkCmdBindVertexBuffers(cmd, 0, 2, buffers,
+                                                       offsets);
+                                boundSplitMesh = mesh;
+                        }
+                        vertexOffset = 0;
+                } else if (boundSplitMesh != nullptr) {
+                        vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer,
+                                               &vertexBufferOffset);
+                        boundSplitMesh = nullptr;
                 }
 
-                glm::mat4 model = object.transformMatrix;
-                // final render matrix, that we are calculating on the cpu
-                glm::mat4 mesh_matrix = model;
-
-                MeshPushConstants constants;
-                constants.render_matrix = mesh_matrix;
-
-                // upload the mesh to the gpu via pushconstants
-                vkCmdPushConstants(cmd, object.material->pipelineLayout,
-                                   VK_SHADER_STAGE_VERTEX_BIT, 0,
-                                   sizeof(MeshPushConstants), &constants);
-
-                // only bind the mesh if its a different one from last bind
-                if (object.mesh != lastMesh) {
-                        // bind the mesh vertex buffer with offset 0
-                        VkDeviceSize offset = 0;
-                        vkCmdBindVertexBuffers(
-                            cmd, 0, 1, &object.mesh->_vertexBuffer._buffer,
-                            &offset);
-                        lastMesh = object.mesh;
-                }
                 // we can now draw
-                vkCmdDraw(cmd, object.mesh->_vertices.size(), 1, 0, i);
+                vkCmdDrawIndexed(cmd, draw.indexCount, draw.instanceCount,
+                                 mesh->first_index() + draw.firstIndex,
+                                 vertexOffset, draw.firstInstance);
                 _currentDrawCalls++;
         }
 }
@@ -1327,8 +1772,7 @@ void VulkanEngine::init_descriptors() {
         std::vector<VkDescriptorPoolSize> sizes{
             // gimme 10 uniform buffer descriptors bro
             {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 10},
-            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10},
-            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 10}};
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 10}};
 
         VkDescriptorPoolCreateInfo descPoolInfo{};
         descPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
@@ -1364,20 +1808,9 @@ void VulkanEngine::init_descriptors() {
         vkCreateDescriptorSetLayout(_device, &setinfo, nullptr,
                                     &_globalSetLayout);
 
-        VkDescriptorSetLayoutBinding objectBind =
-            vkinit::descriptorset_layout_binding(
-                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_VERTEX_BIT,
-                0);
-
-        VkDescriptorSetLayoutCreateInfo setinfo2{};
-        setinfo2.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-        setinfo2.pNext = nullptr;
-        setinfo2.bindingCount = 1; // object
-        setinfo2.pBindings = &objectBind;
-        setinfo2.flags = 0;
-
-        vkCreateDescriptorSetLayout(_device, &setinfo2, nullptr,
-                                    &_objectSetLayout);
+        // the object buffers and every texture, set 1 of the mesh pipelines
+        _bindless.init(_device, FRAME_OVERLAP);
+        init_default_texture();
 
         const size_t sceneParamBufferSize =
             FRAME_OVERLAP * pad_uniform_buffer(sizeof(GPUSceneData));
@@ -1408,17 +1841,10 @@ void VulkanEngine::init_descriptors() {
                 vkAllocateDescriptorSets(_device, &allocInfo,
                                          &_frames[i].globalDescriptorSet);
 
-                // Allocate the descriptor created for the current frame
-                VkDescriptorSetAllocateInfo objSetAlloc{};
-                objSetAlloc.sType =
-                    VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-                objSetAlloc.pNext = nullptr;
-                objSetAlloc.descriptorSetCount = 1;
-                objSetAlloc.descriptorPool = _descriptorPool;
-                objSetAlloc.pSetLayouts = &_objectSetLayout;
-
-                vkAllocateDescriptorSets(_device, &objSetAlloc,
-                                         &_frames[i].objectDescriptorSet);
+                // the shaders find the frame's objects in the bindless set
+                _bindless.set_frame_buffer(i, BINDLESS_OBJECT_BUFFER,
+                                           _frames[i].objectBuffer._buffer,
+                                           sizeof(GPUObjectData) * MAX_OBJECTS);
 
                 VkDescriptorBufferInfo cameraInfo;
                 cameraInfo.buffer = _frames[i].cameraBuffer._buffer;
@@ -1430,11 +1856,6 @@ void VulkanEngine::init_descriptors() {
                 sceneInfo.offset = 0;
                 sceneInfo.range = sizeof(GPUSceneData);
 
-                VkDescriptorBufferInfo objectInfo;
-                objectInfo.buffer = _frames[i].objectBuffer._buffer;
-                objectInfo.offset = 0;
-                objectInfo.range = sizeof(GPUObjectData) * MAX_OBJECTS;
-
                 VkWriteDescriptorSet cameraWrite =
                     vkinit::write_descriptor_buffer(
                         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
@@ -1443,22 +1864,16 @@ void VulkanEngine::init_descriptors() {
                     vkinit::write_descriptor_buffer(
                         VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
                         _frames[i].globalDescriptorSet, &sceneInfo, 1);
-                VkWriteDescriptorSet objectWrite =
-                    vkinit::write_descriptor_buffer(
-                        VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-                        _frames[i].objectDescriptorSet, &objectInfo, 0);
 
-                VkWriteDescriptorSet setWrites[] = {cameraWrite, sceneWrite,
-                                                    objectWrite};
+                VkWriteDescriptorSet setWrites[] = {cameraWrite, sceneWrite};
 
-                vkUpdateDescriptorSets(_device, 3, setWrites, 0, nullptr);
+                vkUpdateDescriptorSets(_device, 2, setWrites, 0, nullptr);
         }
 
         _mainDeletionQueue.push_function([&]() {
                 vmaDestroyBuffer(_allocator, _sceneParamsBuffer._buffer,
                                  _sceneParamsBuffer._allocation);
-                vkDestroyDescriptorSetLayout(_device, _objectSetLayout,
-                                             nullptr);
+                _bindless.destroy();
                 vkDestroyDescriptorSetLayout(_device, _globalSetLayout,
                                              nullptr);
 
@@ -1475,38 +1890,63 @@ void VulkanEngine::init_descriptors() {
         });
 };
 
-void VulkanEngine::immediate_submit(
-    std::function<void(VkCommandBuffer)>&& function) {
-        // allocating the immediate command buffer
-        VkCommandBufferAllocateInfo immediateCommandBufferInfo =
-            vkinit::command_buffer_allocate_info(_uploadContext._commandPool);
-
-        // Allocate the command buffer
-        VkCommandBuffer cmd;
-        VK_CHECK(vkAllocateCommandBuffers(_device, &immediateCommandBufferInfo,
-                                          &cmd));
-
-        // begin recording the command buffer
-        VkCommandBufferBeginInfo cmdBeginInfo =
-            vkinit::command_buffer_begin_info(
-                VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
-        VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
-
-        // execute the function
-        function(cmd);
-
-        VK_CHECK(vkEndCommandBuffer(cmd));
+//  Init (Default Texture): the 1x1 white texture in the first bindless slot
+void VulkanEngine::init_default_texture() {
+        VkImageCreateInfo imageInfo = vkinit::create_image_info(
+            VK_FORMAT_R8G8B8A8_UNORM,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            {1, 1, 1}, VK_SAMPLE_COUNT_1_BIT);
 
-        VkSubmitInfo submit = vkinit::sumbit_info(&cmd);
+        VmaAllocationCreateInfo allocInfo{};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocInfo,
+                                &_defaultTexture.image._image,
+                                &_defaultTexture.image._allocation, nullptr));
+        _defaultTexture.mipLevels = 1;
+
+        // the first frame waits for the copy like for any other upload
+        const uint32_t white = 0xffffffff;
+        memcpy(_uploads.stage_image(_defaultTexture.image._image, {1, 1, 1},
+                                    sizeof(white)),
+               &white, sizeof(white));
+
+        VkImageViewCreateInfo viewInfo = vkinit::create_image_view_info(
+            VK_FORMAT_R8G8B8A8_UNORM, _defaultTexture.image._image,
+            VK_IMAGE_ASPECT_COLOR_BIT);
+        VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr,
+                                   &_defaultTexture.imageView));
+        VkSamplerCreateInfo samplerInfo =
+            vkinit::sampler_create_info(VK_FILTER_NEAREST);
+        VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr,
+                                 &_defaultTexture.sampler));
+
+        _bindless.set_texture(BINDLESS_DEFAULT_TEXTURE, _defaultTexture);
 
-        // submit command buffer to the queue and execute it
-        VK_CHECK(vkQueueSubmit(_graphicsQueue, 1, &submit,
-                               _uploadContext._uploadFence));
+        _mainDeletionQueue.push_function([=]() {
+                vkDestroySampler(_device, _defaultTexture.sampler, nullptr);
+                vkDestroyImageView(_device, _defaultTexture.imageView, nullptr);
+                vmaDestroyImage(_allocator, _defaultTexture.image._image,
+                                _defaultTexture.image._allocation);
+        });
+}
 
-        vkWaitForFences(_device, 1, &_uploadContext._uploadFence, true,
-                        9999999999);
-        vkResetFences(_device, 1, &_uploadContext._uploadFence);
+//  Helper (Textures): the bindless slot of a streamed texture's image, the
+//  slot after the default texture's for the first one. Textures in the same
+//  atlas page share it.
+uint32_t VulkanEngine::texture_slot(TextureHandle handle) const {
+        if (!handle.valid()) {
+                return BINDLESS_DEFAULT_TEXTURE;
+        }
+        uint32_t image = _textureStreamer.image(handle);
+        if (image + 1 >= BINDLESS_MAX_TEXTURES) {
+                return BINDLESS_DEFAULT_TEXTURE;
+        }
+        return image + 1;
+}
 
-        // clear the command pool for the next immediate submit
-        vkResetCommandPool(_device, _uploadContext._commandPool, 0);
+SubmitToken VulkanEngine::submit_async(
+    const std::function<void(VkCommandBuffer)>& function) {
+        // recorded on the calling thread, nothing waits unless the caller
+        // waits on the token
+        return _graphicsSubmitter.submit(function);
 }
@@ -11,31 +11,29 @@
 #include "VkBootstrap.h"
 #include "vk_mem_alloc.h"
 
+#include "async_submit.hh"
+#include "bindless.hh"
+#include "geometry_arena.hh"
 #include "mesh.hh"
+#include "mesh_streamer.hh"
+#include "texture_streamer.hh"
 #include "types.hh"
+#include "upload_manager.hh"
+#include "vfs.hh"
 
 #include <deque>
 #include <functional>
 #include <glm/glm.hpp>
 #include <iostream>
+#include <limits>
 #include <unordered_map>
 #include <vector>
 
-#define VK_CHECK(x)                                                            \
-    do {                                                                       \
-        VkResult err = x;                                                      \
-        if (err) {                                                             \
-            std::cout << "Detected Vulkan error: " << err << std::endl;        \
-            abort();                                                           \
-        }                                                                      \
-    } while (0)
-
 constexpr unsigned int FRAME_OVERLAP = 2;
 
-struct MeshPushConstants {
-    glm::vec4 data;
-    glm::mat4 render_matrix;
-};
+// starting size of the geometry arena, it doubles whenever a mesh doesn't fit
+constexpr VkDeviceSize GEOMETRY_VERTEX_CAPACITY = 64 * 1024 * 1024;
+constexpr VkDeviceSize GEOMETRY_INDEX_CAPACITY = 32 * 1024 * 1024;
 
 struct DeletionQueue {
     std::deque<std::function<void()>> deletors;
@@ -74,9 +72,39 @@ struct Material {
 };
 
 struct RenderObject {
-    Mesh* mesh;
+    // resolved through the mesh streamer every frame
+    MeshHandle mesh;
+    // invalid for untextured objects, streamed in at the size it's drawn at
+    TextureHandle texture;
     Material* material;
     glm::mat4 transformMatrix;
+    // bounds of the mesh in world space, also while it isn't resident,
+    // refresh with update_bounds() whenever the transform or what is known
+    // about the mesh changes
+    Bounds worldBounds;
+
+    // nullptr when the bounds of the mesh are unknown until it loads, the
+    // object then counts as visible from everywhere so it loads right away
+    void update_bounds(const Bounds* meshBounds) {
+        if (meshBounds == nullptr) {
+            glm::vec3 origin = glm::vec3(transformMatrix[3]);
+            worldBounds = {origin, origin, origin,
+                           std::numeric_limits<float>::infinity()};
+            return;
+        }
+        worldBounds = transform_bounds(*meshBounds, transformMatrix);
+    }
+};
+
+// One vkCmdDrawIndexed of instanceCount objects that are next to each other
+// in the object buffer, starting at firstInstance. object is the first one,
+// firstIndex is relative to its mesh.
+struct DrawRange {
+    uint32_t object;
+    uint32_t firstInstance;
+    uint32_t instanceCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
 };
 
 struct GPUCameraData {
@@ -96,11 +124,11 @@ struct GPUSceneData {
 
 struct GPUObjectData {
     glm::mat4 modelMatrix;
-};
-
-struct UploadContext {
-    VkFence _uploadFence;
-    VkCommandPool _commandPool;
+    // xy scale and zw offset of the texture inside its image, for atlases
+    glm::vec4 uvRect;
+    // slot in the bindless texture array
+    uint32_t textureIndex;
+    uint32_t padding[3];
 };
 
 struct FrameData {
@@ -114,8 +142,8 @@ struct FrameData {
     AllocatedBuffer cameraBuffer;
     VkDescriptorSet globalDescriptorSet;
 
+    // the shaders read it through the bindless set
     AllocatedBuffer objectBuffer;
-    VkDescriptorSet objectDescriptorSet;
 };
 
 class VulkanEngine {
@@ -141,6 +169,10 @@ public:
     FrameData _frames[FRAME_OVERLAP]; // Frame Storage
     VkQueue _graphicsQueue; // graphicsqueue to supply those commands to the GPU
     uint32_t _graphicsQueueFamily; // specify the family of the queue
+    // queue the uploads are copied on, the graphics queue when the device has
+    // no separate transfer family
+    VkQueue _transferQueue;
+    uint32_t _transferQueueFamily;
 
     // RenderPass
     VkRenderPass _renderpass; // you need a renderpass to display images from
@@ -155,18 +187,28 @@ public:
 
     // VulkanMemoryAllocator
     VmaAllocator _allocator;
-
-    // Push Constants m8
+    // vertex and index buffers every mesh is sub allocated from
+    GeometryArena _geometryArena;
+    // batches the staging copies of meshes and textures
+    UploadManager _uploads;
+    // every mesh of the scene, only the recently visible ones are resident
+    MeshStreamer _meshStreamer;
+    // drawn while the real mesh is still loading
+    MeshHandle _placeholderMesh;
+    // every texture of the scene, with the mips their size on screen needs
+    TextureStreamer _textureStreamer;
+
+    // shared by every mesh pipeline: the global and the bindless set
     VkPipelineLayout _meshPipelineLayout;
 
     // suzanne moment -> rotating triangle moment
     VkPipeline _meshPipeline;
-    Mesh _triangleMesh;
-
-    // this time suzanne moment fr
-    Mesh _monkeyMesh;
-    // AudiMesh :dab:
-    Mesh _carMesh;
+    // same as _meshPipeline but reading PackedVertex
+    VkPipeline _packedMeshPipeline;
+    // both of the above for meshes with split off positions and the depth
+    // only versions of those, indexed by VertexFormat
+    VkPipeline _splitMeshPipelines[2];
+    VkPipeline _depthPipelines[2];
 
     // Depth buffer moment :dab:
     VkImageView _depthImageView;
@@ -185,9 +227,14 @@ public:
     VkDescriptorPool _descriptorPool;
     // Descriptor set layout
     VkDescriptorSetLayout _globalSetLayout;
-    VkDescriptorSetLayout _objectSetLayout;
+    // object buffers and textures, indexed by the shaders
+    BindlessDescriptors _bindless;
+    // white, sampled by untextured objects
+    Texture _defaultTexture;
     // Physical Device Properties
     VkPhysicalDeviceProperties _deviceProperties;
+    // cooked BC textures are only used when the device samples them
+    bool _textureCompressionBC = false;
 
     // GPU Scene Data and it's buffer (Desc Sets)
     GPUSceneData _sceneParams;
@@ -195,15 +242,19 @@ public:
 
     vkb::Swapchain _vkbSwapchain;
     VkSwapchainKHR _oldSwapChain;
-    // Upload context for writing to a shared buffer between the GPU and the CPU
-    UploadContext _uploadContext;
+    // One off command submission, the transfer one is only used when the
+    // device has a separate transfer queue
+    AsyncSubmitter _graphicsSubmitter;
+    AsyncSubmitter _transferSubmitter;
+    // imgui font texture upload, waited on at the end of init()
+    SubmitToken _fontUpload;
+    // the atlas keeps pointing at the ttf bytes, they stay in the vfs
+    VfsFile _fontFile;
 
     // Objects to be rendered
     std::vector<RenderObject> _renderables;
     // Hashmap of materials
     std::unordered_map<std::string, Material> _materials;
-    // Hashmap of meshes
-    std::unordered_map<std::string, Mesh> _meshes;
 
     // SDL related variables
     bool _isInitialized{false};
@@ -217,6 +268,21 @@ public:
     float _rotation = 0.0f;
     double _fps = 0.0f;
     int _currentDrawCalls = 0;
+    // meshlets culled during the last draw_objects
+    MeshletCullStats _meshletStats;
+    // objects drawn at every level of detail during the last draw_objects
+    int _lodHistogram[MAX_MESH_LODS] = {};
+    // scratch list of the visible meshlet ranges of one object
+    std::vector<IndexRange> _visibleRanges;
+    // scratch list of the mesh every object is drawn with this frame,
+    // nullptr for objects outside the frustum
+    std::vector<Mesh*> _drawnMeshes;
+    // scratch list of the draws of the frame, shared by the depth prepass
+    // and the main pass so both rasterize the same triangles
+    std::vector<DrawRange> _drawRanges;
+    // lay down the depth of the meshes with a position stream before
+    // shading anything
+    bool _depthPrepass{true};
 
     //
     // Public Functions:
@@ -234,8 +300,11 @@ public:
     void draw_objects(VkCommandBuffer cmd, RenderObject* first, int count);
     // Getter for the frame currenting getting rendered.
     FrameData& get_current_frame();
-    // Immediately create and submit a command buffer
-    void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
+    // Record and submit commands on the graphics queue without waiting for
+    // them, wait on the token (_graphicsSubmitter.wait) when the result is
+    // needed. Callable from any thread.
+    SubmitToken submit_async(
+        const std::function<void(VkCommandBuffer cmd)>& function);
 
     // run main loop
     void run();
@@ -253,8 +322,14 @@ public:
                               const std::string& name);
     // Get the material from the hashmap, returns nullptr if it isn't found.
     Material* get_material(const std::string& name);
-    // Get mesh; returns nullptr if the material isn't found.
-    Mesh* get_mesh(const std::string& name);
+    // Get the default material able to read the vertex format and layout.
+    Material* get_material_for(VertexFormat format,
+                               VertexLayout layout = VertexLayout::Interleaved);
+    // Get the handle of a mesh; invalid if the mesh isn't found.
+    MeshHandle get_mesh(const std::string& name);
+    // Get the bindless slot of a streamed texture, the default texture's for
+    // invalid handles
+    uint32_t texture_slot(TextureHandle handle) const;
     // Create a (general) buffer
     AllocatedBuffer create_buffer(size_t allocsize, VkBufferUsageFlags usage,
                                   VmaMemoryUsage memoryUsage);
@@ -279,12 +354,19 @@ private:
     void init_framebuffers();
     // Init sync structures
     void init_sync_structures();
+    // Init the upload manager
+    void init_uploads();
     // Init vulkan pipelines
     void init_pipelines();
     // Init the scene
     void init_scene();
+    // Refresh the world bounds of the renderables after the streamer loaded
+    // a mesh whose bounds weren't known before
+    void update_render_bounds();
     // Init descriptors
     void init_descriptors();
+    // Init the white texture of untextured objects
+    void init_default_texture();
     // Init ImGUI
     void init_imgui();
 };
@@ -0,0 +1,131 @@
+#include "geometry_arena.hh"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+// grow copies out of the old buffers, so they need to be transfer sources too
+constexpr VkBufferUsageFlags VERTEX_USAGE = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+constexpr VkBufferUsageFlags INDEX_USAGE = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+constexpr VkDeviceSize INDEX_ALIGNMENT = 4;
+
+}
+
+void GeometryArena::init(VmaAllocator allocator, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity)
+{
+        _allocator = allocator;
+        _vertexBuffer = create(vertexCapacity, VERTEX_USAGE);
+        _indexBuffer = create(indexCapacity, INDEX_USAGE);
+        _vertexRanges = RangeAllocator(vertexCapacity);
+        _indexRanges = RangeAllocator(indexCapacity);
+}
+
+void GeometryArena::destroy()
+{
+        if (_allocator == nullptr) {
+                return;
+        }
+
+        vmaDestroyBuffer(_allocator, _vertexBuffer._buffer, _vertexBuffer._allocation);
+        vmaDestroyBuffer(_allocator, _indexBuffer._buffer, _indexBuffer._allocation);
+        _vertexBuffer = {};
+        _indexBuffer = {};
+        _vertexRanges = RangeAllocator();
+        _indexRanges = RangeAllocator();
+        _allocator = nullptr;
+}
+
+bool GeometryArena::allocate(VkDeviceSize vertexSize, VkDeviceSize vertexStride, VkDeviceSize indexSize, GeometryRange& range,
+        VkDeviceSize positionSize, VkDeviceSize positionStride)
+{
+        uint64_t vertexOffset = _vertexRanges.allocate(vertexSize, vertexStride);
+        if (vertexOffset == RangeAllocator::INVALID_OFFSET) {
+                return false;
+        }
+
+        uint64_t indexOffset = _indexRanges.allocate(indexSize, INDEX_ALIGNMENT);
+        if (indexOffset == RangeAllocator::INVALID_OFFSET) {
+                _vertexRanges.free(vertexOffset);
+                return false;
+        }
+
+        uint64_t positionOffset = RangeAllocator::INVALID_OFFSET;
+        if (positionSize > 0) {
+                positionOffset = _vertexRanges.allocate(positionSize, positionStride);
+                if (positionOffset == RangeAllocator::INVALID_OFFSET) {
+                        _vertexRanges.free(vertexOffset);
+                        _indexRanges.free(indexOffset);
+                        return false;
+                }
+        }
+
+        range.vertexOffset = vertexOffset;
+        range.vertexSize = vertexSize;
+        range.indexOffset = indexOffset;
+        range.indexSize = indexSize;
+        range.positionOffset = positionOffset;
+        range.positionSize = positionSize;
+        return true;
+}
+
+void GeometryArena::free(GeometryRange& range)
+{
+        if (!range.valid()) {
+                return;
+        }
+
+        _vertexRanges.free(range.vertexOffset);
+        _indexRanges.free(range.indexOffset);
+        if (range.positionOffset != RangeAllocator::INVALID_OFFSET) {
+                _vertexRanges.free(range.positionOffset);
+        }
+        range = {};
+}
+
+void GeometryArena::grow(VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, const Submit& submit)
+{
+        vertexCapacity = std::max<VkDeviceSize>(vertexCapacity, _vertexRanges.capacity());
+        indexCapacity = std::max<VkDeviceSize>(indexCapacity, _indexRanges.capacity());
+
+        std::cout << "Growing the geometry arena to " << vertexCapacity / (1024 * 1024) << " MB vertices, "
+                  << indexCapacity / (1024 * 1024) << " MB indices" << std::endl;
+
+        AllocatedBuffer vertexBuffer = create(vertexCapacity, VERTEX_USAGE);
+        AllocatedBuffer indexBuffer = create(indexCapacity, INDEX_USAGE);
+
+        // the whole old buffer is copied, free space included, it's simpler
+        // than walking the allocations and growing is rare
+        submit([&](VkCommandBuffer cmd) {
+                VkBufferCopy copy {};
+                copy.size = _vertexRanges.capacity();
+                vkCmdCopyBuffer(cmd, _vertexBuffer._buffer, vertexBuffer._buffer, 1, &copy);
+
+                copy.size = _indexRanges.capacity();
+                vkCmdCopyBuffer(cmd, _indexBuffer._buffer, indexBuffer._buffer, 1, &copy);
+        });
+
+        vmaDestroyBuffer(_allocator, _vertexBuffer._buffer, _vertexBuffer._allocation);
+        vmaDestroyBuffer(_allocator, _indexBuffer._buffer, _indexBuffer._allocation);
+        _vertexBuffer = vertexBuffer;
+        _indexBuffer = indexBuffer;
+
+        _vertexRanges.grow(vertexCapacity);
+        _indexRanges.grow(indexCapacity);
+}
+
+AllocatedBuffer GeometryArena::create(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+        VkBufferCreateInfo bufferInfo {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = usage;
+
+        VmaAllocationCreateInfo allocInfo {};
+        allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+        AllocatedBuffer buffer {};
+        VK_CHECK(vmaCreateBuffer(_allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, nullptr));
+        return buffer;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "range_allocator.hh"
+#include "types.hh"
+
+#include <functional>
+
+// Where a mesh lives in the geometry arena, in bytes.
+struct GeometryRange {
+        uint64_t vertexOffset = RangeAllocator::INVALID_OFFSET;
+        uint64_t vertexSize = 0;
+        uint64_t indexOffset = RangeAllocator::INVALID_OFFSET;
+        uint64_t indexSize = 0;
+        // split off position stream, also in the vertex buffer
+        uint64_t positionOffset = RangeAllocator::INVALID_OFFSET;
+        uint64_t positionSize = 0;
+
+        bool valid() const { return vertexOffset != RangeAllocator::INVALID_OFFSET; }
+};
+
+// One device local vertex buffer and one index buffer shared by every mesh,
+// so a frame binds its geometry once and the draws pick their mesh with
+// vertexOffset / firstIndex.
+class GeometryArena {
+public:
+        // records commands into a one off command buffer and waits for them
+        using Submit = std::function<void(std::function<void(VkCommandBuffer)>&&)>;
+
+        void init(VmaAllocator allocator, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity);
+        void destroy();
+
+        // Vertex ranges are aligned to the vertex stride so the offset can be
+        // expressed in whole vertices, index ranges to 4 bytes so they work
+        // for both index types. A position stream is allocated from the vertex
+        // buffer too when positionSize isn't 0. False when the arena is too full.
+        bool allocate(VkDeviceSize vertexSize, VkDeviceSize vertexStride, VkDeviceSize indexSize, GeometryRange& range,
+                VkDeviceSize positionSize = 0, VkDeviceSize positionStride = 1);
+        void free(GeometryRange& range);
+
+        // Moves everything into bigger buffers, the ranges keep their offsets.
+        // The old buffers are destroyed right away, so nothing in flight may
+        // still use them.
+        void grow(VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, const Submit& submit);
+
+        VkBuffer vertex_buffer() const { return _vertexBuffer._buffer; }
+        VkBuffer index_buffer() const { return _indexBuffer._buffer; }
+
+        const RangeAllocator& vertex_ranges() const { return _vertexRanges; }
+        const RangeAllocator& index_ranges() const { return _indexRanges; }
+
+private:
+        AllocatedBuffer create(VkDeviceSize size, VkBufferUsageFlags usage);
+
+        VmaAllocator _allocator = nullptr;
+        AllocatedBuffer _vertexBuffer {};
+        AllocatedBuffer _indexBuffer {};
+        RangeAllocator _vertexRanges;
+        RangeAllocator _indexRanges;
+};
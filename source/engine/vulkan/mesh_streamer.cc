@@ -0,0 +1,273 @@
+#include "mesh_streamer.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <iostream>
+
+void MeshStreamer::init(VmaAllocator allocator, GeometryArena& arena, Upload upload, uint32_t framesInFlight, VkDeviceSize budget)
+{
+        _allocator = allocator;
+        _arena = &arena;
+        _upload = std::move(upload);
+        _framesInFlight = std::max(framesInFlight, 1u);
+        _budget = budget;
+        _currentBudget = budget;
+}
+
+void MeshStreamer::destroy()
+{
+        // the workers write into the entries
+        for (const std::unique_ptr<Entry>& entry : _entries) {
+                if (entry->load.valid()) {
+                        entry->load.wait();
+                }
+        }
+        _entries.clear();
+        _names.clear();
+        _residentBytes = 0;
+        _stats = {};
+}
+
+MeshHandle MeshStreamer::add(const std::string& name, const std::string& path, VertexFormat format, bool splitPositions)
+{
+        MeshHandle handle = find(name);
+        if (handle.valid()) {
+                return handle;
+        }
+
+        auto entry = std::make_unique<Entry>();
+        entry->name = name;
+        entry->path = path;
+        entry->format = format;
+        entry->splitPositions = splitPositions;
+        // objects are culled by them before the mesh is loaded
+        entry->hasBounds = Mesh::peek_bounds(path.c_str(), format, entry->bounds);
+
+        handle.index = static_cast<uint32_t>(_entries.size());
+        _entries.push_back(std::move(entry));
+        _names[name] = handle.index;
+        return handle;
+}
+
+MeshHandle MeshStreamer::add(const std::string& name, Mesh&& mesh)
+{
+        MeshHandle handle = find(name);
+        if (handle.valid()) {
+                return handle;
+        }
+
+        auto entry = std::make_unique<Entry>();
+        entry->name = name;
+        entry->format = mesh._format;
+        entry->splitPositions = mesh._splitPositions;
+        entry->mesh = std::move(mesh);
+        // there is no file to load it back from
+        entry->pinned = true;
+        make_resident(*entry);
+
+        handle.index = static_cast<uint32_t>(_entries.size());
+        _entries.push_back(std::move(entry));
+        _names[name] = handle.index;
+        return handle;
+}
+
+MeshHandle MeshStreamer::find(const std::string& name) const
+{
+        auto item = _names.find(name);
+        if (item == _names.end()) {
+                return {};
+        }
+        return { item->second };
+}
+
+Mesh* MeshStreamer::request(MeshHandle handle, uint64_t frame)
+{
+        if (!handle.valid() || handle.index >= _entries.size()) {
+                return nullptr;
+        }
+
+        Entry& entry = *_entries[handle.index];
+        entry.lastVisible = frame;
+
+        State state = entry.state.load(std::memory_order_acquire);
+        if (state == State::Resident) {
+                return &entry.mesh;
+        }
+        if (state == State::Unloaded) {
+                start_load(entry);
+        }
+        return nullptr;
+}
+
+Mesh* MeshStreamer::resident(MeshHandle handle) const
+{
+        if (!handle.valid() || handle.index >= _entries.size()) {
+                return nullptr;
+        }
+
+        Entry& entry = *_entries[handle.index];
+        if (entry.state.load(std::memory_order_acquire) != State::Resident) {
+                return nullptr;
+        }
+        return &entry.mesh;
+}
+
+const Bounds* MeshStreamer::bounds(MeshHandle handle) const
+{
+        if (!handle.valid() || handle.index >= _entries.size() || !_entries[handle.index]->hasBounds) {
+                return nullptr;
+        }
+        return &_entries[handle.index]->bounds;
+}
+
+VertexFormat MeshStreamer::format(MeshHandle handle) const
+{
+        if (!handle.valid() || handle.index >= _entries.size()) {
+                return VertexFormat::Full;
+        }
+        return _entries[handle.index]->format;
+}
+
+VertexLayout MeshStreamer::layout(MeshHandle handle) const
+{
+        if (!handle.valid() || handle.index >= _entries.size()) {
+                return VertexLayout::Interleaved;
+        }
+        return _entries[handle.index]->splitPositions ? VertexLayout::Split : VertexLayout::Interleaved;
+}
+
+bool MeshStreamer::update(uint64_t frame)
+{
+        bool changed = false;
+        _currentBudget = device_budget();
+
+        // the budget may have shrunk since the last frame
+        uint32_t evictions = _stats.evictions;
+        make_room(0, frame);
+        changed |= _stats.evictions != evictions;
+
+        // the meshes visible most recently go first
+        std::vector<Entry*> loaded;
+        for (const std::unique_ptr<Entry>& entry : _entries) {
+                if (entry->state.load(std::memory_order_acquire) == State::Loaded) {
+                        loaded.push_back(entry.get());
+                }
+        }
+        std::sort(loaded.begin(), loaded.end(), [](const Entry* l, const Entry* r) { return l->lastVisible > r->lastVisible; });
+
+        VkDeviceSize uploaded = 0;
+        for (Entry* entry : loaded) {
+                const Mesh& mesh = entry->mesh;
+                VkDeviceSize size = mesh.vertex_count() * mesh.vertex_stride() + mesh.index_count() * mesh.index_size();
+                if (uploaded > 0 && uploaded + size > MESH_STREAMING_UPLOAD_PER_FRAME) {
+                        break;
+                }
+
+                // meshes that are visible right now win over the budget, they
+                // would only be loaded again the next frame
+                make_room(size, frame);
+                if (make_resident(*entry)) {
+                        uploaded += size;
+                }
+                changed = true;
+        }
+
+        _stats.meshes = static_cast<uint32_t>(_entries.size());
+        _stats.resident = 0;
+        _stats.loading = 0;
+        for (const std::unique_ptr<Entry>& entry : _entries) {
+                State state = entry->state.load(std::memory_order_relaxed);
+                _stats.resident += state == State::Resident;
+                _stats.loading += state == State::Loading || state == State::Loaded;
+        }
+        _stats.residentBytes = _residentBytes;
+        _stats.budget = _currentBudget;
+
+        return changed;
+}
+
+void MeshStreamer::start_load(Entry& entry)
+{
+        entry.state.store(State::Loading, std::memory_order_relaxed);
+        entry.load = ThreadPool::global().submit([&entry]() {
+                Mesh mesh;
+                bool loaded = mesh.load(entry.path.c_str(), entry.format);
+                mesh._splitPositions = entry.splitPositions;
+                entry.mesh = std::move(mesh);
+                entry.state.store(loaded ? State::Loaded : State::Failed, std::memory_order_release);
+        });
+}
+
+bool MeshStreamer::make_resident(Entry& entry)
+{
+        if (entry.load.valid()) {
+                entry.load.get();
+        }
+
+        _upload(entry.mesh);
+        if (!entry.mesh._geometry.valid()) {
+                std::cout << "Mesh " << entry.name << " has nothing to upload." << std::endl;
+                entry.state.store(State::Failed, std::memory_order_relaxed);
+                return false;
+        }
+
+        entry.bounds = entry.mesh._bounds;
+        entry.hasBounds = true;
+
+        const GeometryRange& range = entry.mesh._geometry;
+        entry.bytes = range.vertexSize + range.positionSize + range.indexSize;
+        _residentBytes += entry.bytes;
+        entry.state.store(State::Resident, std::memory_order_release);
+        return true;
+}
+
+void MeshStreamer::make_room(VkDeviceSize size, uint64_t frame)
+{
+        while (_residentBytes + size > _currentBudget) {
+                // a mesh may only go once the frames that drew it finished
+                Entry* oldest = nullptr;
+                for (const std::unique_ptr<Entry>& entry : _entries) {
+                        if (entry->pinned || entry->state.load(std::memory_order_relaxed) != State::Resident
+                                || entry->lastVisible + _framesInFlight > frame) {
+                                continue;
+                        }
+                        if (oldest == nullptr || entry->lastVisible < oldest->lastVisible) {
+                                oldest = entry.get();
+                        }
+                }
+                if (oldest == nullptr) {
+                        return;
+                }
+                evict(*oldest);
+        }
+}
+
+void MeshStreamer::evict(Entry& entry)
+{
+        _arena->free(entry.mesh._geometry);
+        _residentBytes -= entry.bytes;
+        entry.bytes = 0;
+        // the cpu copy goes too, loading it again is cheap once it's cooked
+        entry.mesh = Mesh {};
+        entry.state.store(State::Unloaded, std::memory_order_relaxed);
+        _stats.evictions++;
+}
+
+VkDeviceSize MeshStreamer::device_budget() const
+{
+        const VkPhysicalDeviceMemoryProperties* properties = nullptr;
+        vmaGetMemoryProperties(_allocator, &properties);
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+        vmaGetHeapBudgets(_allocator, budgets);
+
+        // the arena is allocated up front and already part of the usage, what
+        // is left of the device local heaps is room it can grow into
+        VkDeviceSize headroom = 0;
+        for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+                if ((properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && budgets[i].budget > budgets[i].usage) {
+                        headroom += budgets[i].budget - budgets[i].usage;
+                }
+        }
+        VkDeviceSize arena = _arena->vertex_ranges().capacity() + _arena->index_ranges().capacity();
+        return std::min(_budget, arena + headroom);
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "geometry_arena.hh"
+#include "mesh.hh"
+#include "types.hh"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// how much geometry may stay resident before the least recently visible
+// meshes get evicted, lowered further when VMA reports less free memory
+constexpr VkDeviceSize MESH_STREAMING_BUDGET = 256 * 1024 * 1024;
+// uploads per frame are capped so a burst of finished loads doesn't turn into
+// one long frame, a single mesh bigger than this still goes through
+constexpr VkDeviceSize MESH_STREAMING_UPLOAD_PER_FRAME = 16 * 1024 * 1024;
+
+struct MeshHandle {
+        uint32_t index = UINT32_MAX;
+
+        bool valid() const { return index != UINT32_MAX; }
+};
+
+struct MeshStreamingStats {
+        uint32_t meshes = 0;
+        uint32_t resident = 0;
+        uint32_t loading = 0;
+        uint32_t evictions = 0;
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize budget = 0;
+};
+
+// Owns the meshes of the scene and keeps the recently visible ones in the
+// geometry arena. A mesh that isn't resident when it is requested gets loaded
+// on the thread pool, update() uploads it once the load finished and evicts
+// meshes that weren't visible for the longest time while over budget. Until
+// then the caller draws a placeholder.
+//
+// Everything but the loads themselves runs on the main thread.
+class MeshStreamer {
+public:
+        // stages the mesh into the geometry arena and fills mesh._geometry
+        using Upload = std::function<void(Mesh&)>;
+
+        void init(VmaAllocator allocator, GeometryArena& arena, Upload upload, uint32_t framesInFlight,
+                VkDeviceSize budget = MESH_STREAMING_BUDGET);
+        // waits for the loads that are still running, the arena ranges go
+        // away with the arena
+        void destroy();
+
+        // mesh loaded from path the first time it is requested, see
+        // Mesh::_splitPositions for splitPositions
+        MeshHandle add(const std::string& name, const std::string& path, VertexFormat format, bool splitPositions = false);
+        // mesh built in code, uploaded right away and never evicted
+        MeshHandle add(const std::string& name, Mesh&& mesh);
+        // invalid handle when there is no mesh with that name
+        MeshHandle find(const std::string& name) const;
+
+        // The mesh when it is resident, nullptr otherwise. Marks the mesh as
+        // visible in frame and starts loading it when it is missing.
+        Mesh* request(MeshHandle handle, uint64_t frame);
+        // same as request without touching the mesh
+        Mesh* resident(MeshHandle handle) const;
+        // Model space bounds of the mesh, before it is resident as well when
+        // it was cooked already. nullptr when they are unknown until it loads.
+        const Bounds* bounds(MeshHandle handle) const;
+        VertexFormat format(MeshHandle handle) const;
+        VertexLayout layout(MeshHandle handle) const;
+
+        // Uploads finished loads and evicts down to the budget. Call once per
+        // frame, after the frame's fence and before the uploads are flushed.
+        // True when a mesh became resident or was evicted.
+        bool update(uint64_t frame);
+
+        void set_budget(VkDeviceSize budget) { _budget = budget; }
+        const MeshStreamingStats& stats() const { return _stats; }
+
+private:
+        enum class State : uint32_t {
+                Unloaded,
+                Loading,
+                // loaded on the cpu, waiting for update() to upload it
+                Loaded,
+                Resident,
+                Failed,
+        };
+
+        struct Entry {
+                std::string name;
+                std::string path;
+                VertexFormat format = VertexFormat::Full;
+                bool splitPositions = false;
+                // the loading worker owns mesh until it sets Loaded
+                std::atomic<State> state { State::Unloaded };
+                Mesh mesh;
+                std::future<void> load;
+                uint64_t lastVisible = 0;
+                VkDeviceSize bytes = 0;
+                bool pinned = false;
+                // kept when the mesh is evicted
+                Bounds bounds {};
+                bool hasBounds = false;
+        };
+
+        void start_load(Entry& entry);
+        // uploads a loaded mesh, false when it didn't make it into the arena
+        bool make_resident(Entry& entry);
+        // evicts the least recently visible meshes the gpu is done with until
+        // size more bytes fit into the budget or nothing is left to evict
+        void make_room(VkDeviceSize size, uint64_t frame);
+        void evict(Entry& entry);
+        // _budget, or less when the device is running out of memory
+        VkDeviceSize device_budget() const;
+
+        VmaAllocator _allocator = nullptr;
+        GeometryArena* _arena = nullptr;
+        Upload _upload;
+        uint32_t _framesInFlight = 1;
+        VkDeviceSize _budget = MESH_STREAMING_BUDGET;
+        VkDeviceSize _currentBudget = MESH_STREAMING_BUDGET;
+
+        // entries never move, the loading workers hold on to them
+        std::vector<std::unique_ptr<Entry>> _entries;
+        std::unordered_map<std::string, uint32_t> _names;
+        VkDeviceSize _residentBytes = 0;
+        MeshStreamingStats _stats;
+};
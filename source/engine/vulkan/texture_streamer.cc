@@ -0,0 +1,407 @@
+#include "texture_streamer.hh"
+#include "initializers.hh"
+#include "texture_cook.hh"
+#include "thread_pool.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+void TextureStreamer::init(VkDevice device, VmaAllocator allocator, UploadManager& uploads, bool compressed, Changed changed,
+        uint32_t framesInFlight, VkDeviceSize budget)
+{
+        _device = device;
+        _allocator = allocator;
+        _uploads = &uploads;
+        _compressed = compressed;
+        _changed = std::move(changed);
+        _framesInFlight = std::max(framesInFlight, 1u);
+        _budget = budget;
+        _currentBudget = budget;
+
+        VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_LINEAR);
+        VK_CHECK(vkCreateSampler(_device, &samplerInfo, nullptr, &_sampler));
+}
+
+void TextureStreamer::destroy()
+{
+        // the workers write into the entries
+        for (const std::unique_ptr<Entry>& entry : _entries) {
+                if (entry->load.valid()) {
+                        entry->load.wait();
+                }
+                if (entry->texture.image._image != VK_NULL_HANDLE) {
+                        destroy_texture(entry->texture);
+                }
+        }
+        for (const Retired& retired : _retired) {
+                destroy_texture(retired.texture);
+        }
+        if (_sampler != VK_NULL_HANDLE) {
+                vkDestroySampler(_device, _sampler, nullptr);
+                _sampler = VK_NULL_HANDLE;
+        }
+        _entries.clear();
+        _textures.clear();
+        _paths.clear();
+        _retired.clear();
+        _residentBytes = 0;
+        _stats = {};
+}
+
+bool TextureStreamer::add_atlases(const char* manifestPath, const std::string& root)
+{
+        atlas::Manifest manifest;
+        if (!atlas::read_manifest(manifestPath, manifest)) {
+                return false;
+        }
+
+        const std::string directory = std::filesystem::path(manifestPath).parent_path().generic_string();
+        for (const atlas::Page& page : manifest.pages) {
+                const std::string& file = _compressed ? page.compressedFile : page.uncompressedFile;
+                const uint32_t image = add_image(directory + "/" + file, true);
+
+                for (const atlas::Member& member : page.members) {
+                        // whatever was added before keeps its own image
+                        const std::string path = root + "/" + member.name;
+                        if (find(path).valid()) {
+                                continue;
+                        }
+
+                        UvRect rect;
+                        rect.scale[0] = static_cast<float>(member.rect.width) / page.width;
+                        rect.scale[1] = static_cast<float>(member.rect.height) / page.height;
+                        rect.offset[0] = static_cast<float>(member.rect.x) / page.width;
+                        rect.offset[1] = static_cast<float>(member.rect.y) / page.height;
+
+                        _paths[path] = static_cast<uint32_t>(_textures.size());
+                        _textures.push_back({ image, rect });
+                }
+        }
+        return true;
+}
+
+TextureHandle TextureStreamer::add(const std::string& path)
+{
+        TextureHandle handle = find(path);
+        if (handle.valid()) {
+                return handle;
+        }
+
+        handle.index = static_cast<uint32_t>(_textures.size());
+        _textures.push_back({ add_image(path, false), {} });
+        _paths[path] = handle.index;
+        return handle;
+}
+
+uint32_t TextureStreamer::add_image(const std::string& path, bool cooked)
+{
+        auto entry = std::make_unique<Entry>();
+        entry->index = static_cast<uint32_t>(_entries.size());
+        entry->path = path;
+        entry->cooked = cooked;
+        _entries.push_back(std::move(entry));
+        return _entries.back()->index;
+}
+
+TextureHandle TextureStreamer::find(const std::string& path) const
+{
+        auto item = _paths.find(path);
+        if (item == _paths.end()) {
+                return {};
+        }
+        return { item->second };
+}
+
+const Texture* TextureStreamer::request(TextureHandle handle, float pixels, uint64_t frame)
+{
+        if (!handle.valid() || handle.index >= _textures.size()) {
+                return nullptr;
+        }
+
+        // an atlas page is that much bigger on screen than its member
+        const TextureRef& ref = _textures[handle.index];
+        pixels /= std::max(ref.rect.scale[0], ref.rect.scale[1]);
+
+        Entry& entry = *_entries[ref.image];
+        entry.lastVisible = frame;
+        // every object using the texture asks, the biggest one counts
+        if (entry.wantedFrame != frame) {
+                entry.wantedFrame = frame;
+                entry.wantedPixels = pixels;
+        } else {
+                entry.wantedPixels = std::max(entry.wantedPixels, pixels);
+        }
+
+        State state = entry.state.load(std::memory_order_acquire);
+        if (state == State::Unloaded) {
+                start_load(entry);
+        }
+        return resident(handle);
+}
+
+const Texture* TextureStreamer::resident(TextureHandle handle) const
+{
+        if (!handle.valid() || handle.index >= _textures.size()) {
+                return nullptr;
+        }
+
+        const Entry& entry = *_entries[_textures[handle.index].image];
+        if (entry.state.load(std::memory_order_acquire) != State::Loaded || entry.firstLevel >= level_count(entry)) {
+                return nullptr;
+        }
+        return &entry.texture;
+}
+
+bool TextureStreamer::update(uint64_t frame)
+{
+        bool changed = false;
+
+        // images the frames in flight no longer sample
+        auto done = std::remove_if(_retired.begin(), _retired.end(), [&](const Retired& retired) {
+                if (retired.frame + _framesInFlight > frame) {
+                        return false;
+                }
+                destroy_texture(retired.texture);
+                return true;
+        });
+        _retired.erase(done, _retired.end());
+
+        _currentBudget = device_budget();
+
+        // the budget may have shrunk since the last frame
+        uint32_t evictions = _stats.evictions;
+        make_room(0, frame, nullptr);
+        changed |= _stats.evictions != evictions;
+
+        // finished loads go straight to the levels they want when those fit,
+        // else they get their tail right away, it is tiny and without it
+        // there is nothing to sample at all
+        VkDeviceSize uploaded = 0;
+        std::vector<Entry*> wanting;
+        for (const std::unique_ptr<Entry>& entry : _entries) {
+                if (entry->state.load(std::memory_order_acquire) != State::Loaded) {
+                        continue;
+                }
+                const uint32_t tail = tail_level(*entry);
+                if (entry->firstLevel > tail) {
+                        for (uint32_t level = target_level(*entry, frame);; level++) {
+                                const VkDeviceSize size = chain_bytes(*entry, level);
+                                if (level == tail) {
+                                        make_room(size, frame, entry.get());
+                                } else if ((uploaded > 0 && uploaded + size > TEXTURE_STREAMING_UPLOAD_PER_FRAME)
+                                        || !make_room(size, frame, entry.get())) {
+                                        continue;
+                                }
+                                uploaded += make_resident(*entry, level, frame);
+                                break;
+                        }
+                        changed = true;
+                }
+                if (target_level(*entry, frame) < entry->firstLevel) {
+                        wanting.push_back(entry.get());
+                }
+        }
+
+        // the textures visible most recently go first, then the ones
+        // missing the most levels
+        std::sort(wanting.begin(), wanting.end(), [&](const Entry* l, const Entry* r) {
+                if (l->lastVisible != r->lastVisible) {
+                        return l->lastVisible > r->lastVisible;
+                }
+                return l->firstLevel - target_level(*l, frame) > r->firstLevel - target_level(*r, frame);
+        });
+
+        for (Entry* entry : wanting) {
+                // settle for fewer levels when all of them don't fit
+                for (uint32_t level = target_level(*entry, frame); level < entry->firstLevel; level++) {
+                        // the levels it already has are copied on the gpu
+                        const VkDeviceSize size = chain_bytes(*entry, level);
+                        const VkDeviceSize staged = size - entry->bytes;
+                        if (uploaded > 0 && uploaded + staged > TEXTURE_STREAMING_UPLOAD_PER_FRAME) {
+                                continue;
+                        }
+                        if (!make_room(staged, frame, entry)) {
+                                continue;
+                        }
+                        uploaded += make_resident(*entry, level, frame);
+                        changed = true;
+                        break;
+                }
+        }
+
+        _stats.textures = static_cast<uint32_t>(_textures.size());
+        _stats.images = static_cast<uint32_t>(_entries.size());
+        _stats.loading = 0;
+        _stats.streaming = 0;
+        for (const std::unique_ptr<Entry>& entry : _entries) {
+                State state = entry->state.load(std::memory_order_relaxed);
+                _stats.loading += state == State::Loading;
+                _stats.streaming += state == State::Loaded && target_level(*entry, frame) < entry->firstLevel;
+        }
+        _stats.residentBytes = _residentBytes;
+        _stats.budget = _currentBudget;
+
+        return changed;
+}
+
+void TextureStreamer::start_load(Entry& entry)
+{
+        entry.state.store(State::Loading, std::memory_order_relaxed);
+        entry.load = ThreadPool::global().submit([&entry, compressed = _compressed]() {
+                // the texture is cooked on a miss, atlas pages only exist cooked
+                const std::string cookedPath = entry.cooked ? entry.path : texture_cook::find_or_cook(entry.path.c_str(), compressed);
+                bool loaded = !cookedPath.empty() && Vfs::global().read(cookedPath.c_str(), entry.file)
+                        && ktx2::parse(entry.file.data, entry.file.size, entry.ktx);
+                if (!loaded) {
+                        std::cerr << "Failed to load texture " << entry.path << std::endl;
+                        entry.file = {};
+                } else {
+                        entry.firstLevel = static_cast<uint32_t>(entry.ktx.levels.size());
+                }
+                entry.state.store(loaded ? State::Loaded : State::Failed, std::memory_order_release);
+        });
+}
+
+uint32_t TextureStreamer::tail_level(const Entry& entry) const
+{
+        const uint32_t size = std::max(entry.ktx.width, entry.ktx.height);
+        uint32_t level = 0;
+        while (level + 1 < level_count(entry) && (size >> level) > TEXTURE_STREAMING_TAIL_SIZE) {
+                level++;
+        }
+        return level;
+}
+
+uint32_t TextureStreamer::target_level(const Entry& entry, uint64_t frame) const
+{
+        // the requests of the last frame are the latest there are
+        const uint32_t tail = tail_level(entry);
+        if (entry.wantedFrame + 1 < frame) {
+                return tail;
+        }
+
+        // the smallest level that still has a texel for every pixel
+        const uint32_t size = std::max(entry.ktx.width, entry.ktx.height);
+        uint32_t level = 0;
+        while (level < tail && static_cast<float>(size >> (level + 1)) >= entry.wantedPixels) {
+                level++;
+        }
+        return level;
+}
+
+VkDeviceSize TextureStreamer::chain_bytes(const Entry& entry, uint32_t firstLevel) const
+{
+        VkDeviceSize bytes = 0;
+        for (uint32_t level = firstLevel; level < level_count(entry); level++) {
+                bytes += entry.ktx.levels[level].size;
+        }
+        return bytes;
+}
+
+VkDeviceSize TextureStreamer::make_resident(Entry& entry, uint32_t firstLevel, uint64_t frame)
+{
+        if (entry.load.valid()) {
+                entry.load.get();
+        }
+
+        Texture texture {};
+        texture.mipLevels = level_count(entry) - firstLevel;
+        texture.sampler = _sampler;
+        VkExtent3D extent { std::max(entry.ktx.width >> firstLevel, 1u), std::max(entry.ktx.height >> firstLevel, 1u), 1 };
+
+        // the next image copies its levels out of this one
+        VkImageCreateInfo imageInfo = vkinit::create_image_info(entry.ktx.format,
+                VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, extent, VK_SAMPLE_COUNT_1_BIT);
+        imageInfo.mipLevels = texture.mipLevels;
+
+        VmaAllocationCreateInfo allocationInfo {};
+        allocationInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+        VK_CHECK(vmaCreateImage(_allocator, &imageInfo, &allocationInfo, &texture.image._image, &texture.image._allocation, nullptr));
+
+        // the levels from copiedLevel on are in the old image already,
+        // everything in front of them is staged one level at a time, the
+        // ring may wrap in between
+        const bool hadImage = entry.texture.image._image != VK_NULL_HANDLE;
+        const uint32_t copiedLevel = hadImage ? std::max(firstLevel, entry.firstLevel) : level_count(entry);
+        VkDeviceSize staged = 0;
+        for (uint32_t i = 0; firstLevel + i < copiedLevel; i++) {
+                const ktx2::Level& level = entry.ktx.levels[firstLevel + i];
+                VkExtent3D levelExtent { std::max(extent.width >> i, 1u), std::max(extent.height >> i, 1u), 1 };
+                memcpy(_uploads->stage_image_level(texture.image._image, i, levelExtent, level.size), level.data, level.size);
+                staged += level.size;
+        }
+        if (copiedLevel < level_count(entry)) {
+                VkExtent3D copyExtent { std::max(entry.ktx.width >> copiedLevel, 1u), std::max(entry.ktx.height >> copiedLevel, 1u), 1 };
+                _uploads->copy_image_levels(entry.texture.image._image, copiedLevel - entry.firstLevel, texture.image._image,
+                        copiedLevel - firstLevel, level_count(entry) - copiedLevel, copyExtent);
+        }
+
+        VkImageViewCreateInfo viewInfo = vkinit::create_image_view_info(entry.ktx.format, texture.image._image, VK_IMAGE_ASPECT_COLOR_BIT);
+        viewInfo.subresourceRange.levelCount = texture.mipLevels;
+        VK_CHECK(vkCreateImageView(_device, &viewInfo, nullptr, &texture.imageView));
+
+        // the frames in flight may still sample the old levels
+        if (entry.texture.image._image != VK_NULL_HANDLE) {
+                _retired.push_back({ entry.texture, frame });
+        }
+        _residentBytes -= entry.bytes;
+        entry.bytes = chain_bytes(entry, firstLevel);
+        _residentBytes += entry.bytes;
+        entry.firstLevel = firstLevel;
+        entry.texture = texture;
+        if (_changed) {
+                _changed(entry.index, entry.texture);
+        }
+        return staged;
+}
+
+bool TextureStreamer::make_room(VkDeviceSize size, uint64_t frame, const Entry* keep)
+{
+        while (_residentBytes + size > _currentBudget) {
+                // the least recently visible texture with more levels than
+                // it wants goes down to what it wants, the tail when it
+                // isn't visible anymore
+                Entry* oldest = nullptr;
+                for (const std::unique_ptr<Entry>& entry : _entries) {
+                        if (entry.get() == keep || entry->state.load(std::memory_order_relaxed) != State::Loaded
+                                || target_level(*entry, frame) <= entry->firstLevel) {
+                                continue;
+                        }
+                        if (oldest == nullptr || entry->lastVisible < oldest->lastVisible) {
+                                oldest = entry.get();
+                        }
+                }
+                if (oldest == nullptr) {
+                        return false;
+                }
+                make_resident(*oldest, target_level(*oldest, frame), frame);
+                _stats.evictions++;
+        }
+        return true;
+}
+
+void TextureStreamer::destroy_texture(const Texture& texture)
+{
+        vkDestroyImageView(_device, texture.imageView, nullptr);
+        vmaDestroyImage(_allocator, texture.image._image, texture.image._allocation);
+}
+
+VkDeviceSize TextureStreamer::device_budget() const
+{
+        const VkPhysicalDeviceMemoryProperties* properties = nullptr;
+        vmaGetMemoryProperties(_allocator, &properties);
+        VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+        vmaGetHeapBudgets(_allocator, budgets);
+
+        // the resident levels are already part of the usage, what is left of
+        // the device local heaps is room they can grow into
+        VkDeviceSize headroom = 0;
+        for (uint32_t i = 0; i < properties->memoryHeapCount; i++) {
+                if ((properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && budgets[i].budget > budgets[i].usage) {
+                        headroom += budgets[i].budget - budgets[i].usage;
+                }
+        }
+        return std::min(_budget, _residentBytes + headroom);
+}
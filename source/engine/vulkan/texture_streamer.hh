@@ -0,0 +1,186 @@
+#pragma once
+
+#include "atlas.hh"
+#include "ktx2.hh"
+#include "types.hh"
+#include "upload_manager.hh"
+#include "vfs.hh"
+
+#include <atomic>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// how much texture memory the streamed levels may take before the least
+// recently visible textures drop theirs, lowered further when VMA reports
+// less free memory
+constexpr VkDeviceSize TEXTURE_STREAMING_BUDGET = 128 * 1024 * 1024;
+// like the mesh uploads, a single chain bigger than this still goes through
+constexpr VkDeviceSize TEXTURE_STREAMING_UPLOAD_PER_FRAME = 8 * 1024 * 1024;
+// the levels up to this size are uploaded as soon as a texture is loaded and
+// never dropped, they are what gets sampled until more streams in
+constexpr uint32_t TEXTURE_STREAMING_TAIL_SIZE = 64;
+
+struct TextureHandle {
+        uint32_t index = UINT32_MAX;
+
+        bool valid() const { return index != UINT32_MAX; }
+};
+
+// Where a texture is inside its image, uv = offset + fract(uv) * scale. The
+// whole image for textures that aren't in an atlas.
+struct UvRect {
+        float scale[2] = { 1.0f, 1.0f };
+        float offset[2] = { 0.0f, 0.0f };
+};
+
+struct TextureStreamingStats {
+        uint32_t textures = 0;
+        // textures share an image when they were packed into an atlas
+        uint32_t images = 0;
+        uint32_t loading = 0;
+        // visible textures that have fewer levels resident than they want
+        uint32_t streaming = 0;
+        // times levels were dropped to stay within the budget
+        uint32_t evictions = 0;
+        VkDeviceSize residentBytes = 0;
+        VkDeviceSize budget = 0;
+};
+
+// Keeps as many mip levels of every texture resident as its size on screen
+// asks for. The cooked KTX2 of a texture is loaded on the thread pool and
+// stays mapped, update() then uploads its smallest levels and streams the
+// finer ones in and out from there, the most visible textures first.
+//
+// There is no sparse residency, so a texture with levels [first, count)
+// resident is an image of just those levels, sized like level first. Every
+// change of the first level recreates the image. The levels the old image
+// already has are copied over on the gpu, only new ones are staged and count
+// against TEXTURE_STREAMING_UPLOAD_PER_FRAME, so dropping levels uploads
+// nothing. The old image stays alive until the frames that sampled it are done.
+//
+// The small textures the baker packed into atlases are all served from their
+// atlas page, see add_atlases.
+//
+// Everything but the loads themselves runs on the main thread.
+class TextureStreamer {
+public:
+        // called whenever an image was replaced, with the new one
+        using Changed = std::function<void(uint32_t image, const Texture&)>;
+
+        // compressed picks the BC or the RGBA8 flavor of the cooked textures
+        void init(VkDevice device, VmaAllocator allocator, UploadManager& uploads, bool compressed, Changed changed,
+                uint32_t framesInFlight, VkDeviceSize budget = TEXTURE_STREAMING_BUDGET);
+        // waits for the loads that are still running and destroys every
+        // image, the gpu has to be idle
+        void destroy();
+
+        // Registers the pages of the atlas manifest, the textures in them are
+        // the member names below root. False when there is no manifest.
+        bool add_atlases(const char* manifestPath, const std::string& root);
+        // texture loaded from path the first time it is requested
+        TextureHandle add(const std::string& path);
+        // invalid handle when the texture was never added
+        TextureHandle find(const std::string& path) const;
+        // the image the texture is sampled from, shared by textures in the
+        // same atlas page
+        uint32_t image(TextureHandle handle) const { return _textures[handle.index].image; }
+        const UvRect& uv_rect(TextureHandle handle) const { return _textures[handle.index].rect; }
+
+        // The image of the texture when any level of it is resident, nullptr
+        // otherwise. Marks it as visible in frame, covering pixels along its
+        // longest side, and starts loading it when it is missing.
+        const Texture* request(TextureHandle handle, float pixels, uint64_t frame);
+        // same as request without touching the texture
+        const Texture* resident(TextureHandle handle) const;
+
+        // Uploads the levels the visible textures want and drops levels down
+        // to the budget. Call once per frame, after the frame's fence and
+        // before the uploads are flushed. True when a texture changed.
+        bool update(uint64_t frame);
+
+        void set_budget(VkDeviceSize budget) { _budget = budget; }
+        const TextureStreamingStats& stats() const { return _stats; }
+
+private:
+        enum class State : uint32_t {
+                Unloaded,
+                Loading,
+                // mapped and parsed, the levels are uploaded by update()
+                Loaded,
+                Failed,
+        };
+
+        // one per image
+        struct Entry {
+                uint32_t index = 0;
+                // the source, or the KTX2 itself for atlas pages
+                std::string path;
+                bool cooked = false;
+                // the loading worker owns file and ktx until it sets Loaded
+                std::atomic<State> state { State::Unloaded };
+                VfsFile file;
+                ktx2::Image ktx;
+                std::future<void> load;
+                // first resident level, the level count while nothing is
+                uint32_t firstLevel = 0;
+                // the level of the biggest visible size in wantedFrame
+                float wantedPixels = 0.0f;
+                uint64_t wantedFrame = 0;
+                uint64_t lastVisible = 0;
+                Texture texture {};
+                VkDeviceSize bytes = 0;
+        };
+
+        struct TextureRef {
+                uint32_t image;
+                UvRect rect;
+        };
+
+        struct Retired {
+                Texture texture;
+                uint64_t frame;
+        };
+
+        uint32_t add_image(const std::string& path, bool cooked);
+        void start_load(Entry& entry);
+        uint32_t level_count(const Entry& entry) const { return static_cast<uint32_t>(entry.ktx.levels.size()); }
+        // the first level of the levels that are always resident
+        uint32_t tail_level(const Entry& entry) const;
+        // the first level the texture should have, the tail when it wasn't
+        // visible recently
+        uint32_t target_level(const Entry& entry, uint64_t frame) const;
+        VkDeviceSize chain_bytes(const Entry& entry, uint32_t firstLevel) const;
+        // recreates the image with the levels from firstLevel on, returns the
+        // bytes staged for the levels the old image didn't have
+        VkDeviceSize make_resident(Entry& entry, uint32_t firstLevel, uint64_t frame);
+        // drops levels of the least recently visible textures until size
+        // more bytes fit into the budget, false when that's not possible
+        bool make_room(VkDeviceSize size, uint64_t frame, const Entry* keep);
+        void destroy_texture(const Texture& texture);
+        // _budget, or less when the device is running out of memory
+        VkDeviceSize device_budget() const;
+
+        VkDevice _device = VK_NULL_HANDLE;
+        VmaAllocator _allocator = nullptr;
+        UploadManager* _uploads = nullptr;
+        bool _compressed = true;
+        Changed _changed;
+        uint32_t _framesInFlight = 1;
+        VkDeviceSize _budget = TEXTURE_STREAMING_BUDGET;
+        VkDeviceSize _currentBudget = TEXTURE_STREAMING_BUDGET;
+        // shared by every texture, the views only cover the resident levels
+        VkSampler _sampler = VK_NULL_HANDLE;
+
+        // entries never move, the loading workers hold on to them
+        std::vector<std::unique_ptr<Entry>> _entries;
+        // indexed by the handles
+        std::vector<TextureRef> _textures;
+        std::unordered_map<std::string, uint32_t> _paths;
+        std::vector<Retired> _retired;
+        VkDeviceSize _residentBytes = 0;
+        TextureStreamingStats _stats;
+};
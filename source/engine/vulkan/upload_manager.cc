@@ -0,0 +1,454 @@
+#include "upload_manager.hh"
+
+#include "initializers.hh"
+
+#include <algorithm>
+#include <tuple>
+
+namespace {
+
+// whatever reads the uploaded data on the graphics queue
+constexpr VkPipelineStageFlags CONSUMER_STAGES = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+constexpr VkAccessFlags BUFFER_CONSUMER_ACCESS = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+
+AllocatedBuffer create_staging(VmaAllocator allocator, VkDeviceSize size, void** mapped)
+{
+        VkBufferCreateInfo bufferInfo {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size = size;
+        bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+        // mapped for as long as the buffer lives
+        VmaAllocationCreateInfo allocInfo {};
+        allocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+        allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+        AllocatedBuffer buffer {};
+        VmaAllocationInfo info {};
+        VK_CHECK(vmaCreateBuffer(allocator, &bufferInfo, &allocInfo, &buffer._buffer, &buffer._allocation, &info));
+        *mapped = info.pMappedData;
+        return buffer;
+}
+
+VkImageMemoryBarrier image_barrier(VkImage image, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+        VkImageMemoryBarrier barrier {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        barrier.oldLayout = oldLayout;
+        barrier.newLayout = newLayout;
+        return barrier;
+}
+
+// Blits every level of the image from the one above it. The image arrives
+// with all levels in TRANSFER_DST_OPTIMAL and leaves in SHADER_READ_ONLY_OPTIMAL,
+// each level moves to TRANSFER_SRC_OPTIMAL right before it is read.
+void record_mip_chain(VkCommandBuffer cmd, VkImage image, VkExtent3D extent, uint32_t mipLevels)
+{
+        int32_t width = static_cast<int32_t>(extent.width);
+        int32_t height = static_cast<int32_t>(extent.height);
+
+        for (uint32_t level = 1; level < mipLevels; level++) {
+                VkImageMemoryBarrier barrier = image_barrier(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+                barrier.subresourceRange.baseMipLevel = level - 1;
+                barrier.subresourceRange.levelCount = 1;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+                const int32_t nextWidth = std::max(width / 2, 1);
+                const int32_t nextHeight = std::max(height / 2, 1);
+
+                VkImageBlit blit {};
+                blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                blit.srcSubresource.mipLevel = level - 1;
+                blit.srcSubresource.layerCount = 1;
+                blit.srcOffsets[1] = { width, height, 1 };
+                blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                blit.dstSubresource.mipLevel = level;
+                blit.dstSubresource.layerCount = 1;
+                blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+                vkCmdBlitImage(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit,
+                        VK_FILTER_LINEAR);
+
+                // done as a source, the shaders get it
+                barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+                barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, CONSUMER_STAGES, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+                width = nextWidth;
+                height = nextHeight;
+        }
+
+        // the last level was only ever written
+        VkImageMemoryBarrier barrier = image_barrier(image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, CONSUMER_STAGES, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+// Copies the levels with the source moved to TRANSFER_SRC_OPTIMAL and back,
+// frames before this one may still be sampling it. Earlier copies in the same
+// command buffer may have written it, those writes are waited for as well.
+void record_level_copy(VkCommandBuffer cmd, VkImage src, uint32_t srcLevel, VkImage dst, uint32_t dstLevel, uint32_t levelCount,
+        VkExtent3D extent)
+{
+        VkImageMemoryBarrier barriers[2] = {
+                image_barrier(src, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL),
+                image_barrier(dst, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL),
+        };
+        barriers[0].subresourceRange.baseMipLevel = srcLevel;
+        barriers[0].subresourceRange.levelCount = levelCount;
+        barriers[0].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barriers[1].subresourceRange.baseMipLevel = dstLevel;
+        barriers[1].subresourceRange.levelCount = levelCount;
+        barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd, CONSUMER_STAGES | VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                nullptr, 2, barriers);
+
+        std::vector<VkImageCopy> regions(levelCount);
+        for (uint32_t i = 0; i < levelCount; i++) {
+                VkImageCopy& region = regions[i];
+                region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, srcLevel + i, 0, 1 };
+                region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, dstLevel + i, 0, 1 };
+                region.extent = { std::max(extent.width >> i, 1u), std::max(extent.height >> i, 1u), 1 };
+        }
+        vkCmdCopyImage(cmd, src, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount,
+                regions.data());
+
+        barriers[0].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barriers[0].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[0].srcAccessMask = 0;
+        barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, CONSUMER_STAGES | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0,
+                nullptr, 2, barriers);
+}
+
+}
+
+void UploadManager::init(VmaAllocator allocator, AsyncSubmitter& submitter, uint32_t graphicsFamily, VkDeviceSize ringSize)
+{
+        _allocator = allocator;
+        _submitter = &submitter;
+        _graphicsFamily = graphicsFamily;
+
+        void* mapped = nullptr;
+        _ring = create_staging(_allocator, ringSize, &mapped);
+        _ringData = static_cast<char*>(mapped);
+        _ringSize = ringSize;
+        _ringHead = 0;
+}
+
+void UploadManager::destroy()
+{
+        if (_submitter == nullptr) {
+                return;
+        }
+
+        flush();
+        wait_idle();
+
+        vmaDestroyBuffer(_allocator, _ring._buffer, _ring._allocation);
+        _submitter = nullptr;
+}
+
+void* UploadManager::allocate(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& buffer, VkDeviceSize& offset)
+{
+        if (size > _ringSize) {
+                void* mapped = nullptr;
+                AllocatedBuffer staging = create_staging(_allocator, size, &mapped);
+                _oversized.push_back(staging);
+                buffer = staging._buffer;
+                offset = 0;
+                return mapped;
+        }
+
+        VkDeviceSize start = (_ringHead + alignment - 1) / alignment * alignment;
+        if (start + size > _ringSize) {
+                // Start over at the front once everything in the ring has been
+                // copied out. The space in front of the head is always free
+                // since the last wrap, so this is the only wait.
+                flush();
+                wait_idle();
+                start = 0;
+        }
+
+        _ringHead = start + size;
+        buffer = _ring._buffer;
+        offset = start;
+        return _ringData + start;
+}
+
+void* UploadManager::stage_buffer(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size)
+{
+        BufferCopy copy {};
+        copy.dst = dst;
+        copy.region.dstOffset = dstOffset;
+        copy.region.size = size;
+        void* data = allocate(size, UPLOAD_STAGING_ALIGNMENT, copy.src, copy.region.srcOffset);
+        _bufferCopies.push_back(copy);
+
+        current_stats().bytes += size;
+        current_stats().copies++;
+        return data;
+}
+
+void* UploadManager::stage_image(VkImage dst, VkExtent3D extent, VkDeviceSize size, uint32_t mipLevels)
+{
+        void* data = stage_image_level(dst, 0, extent, size);
+        _imageCopies.back().mipLevels = std::max(mipLevels, 1u);
+        return data;
+}
+
+void* UploadManager::stage_image_level(VkImage dst, uint32_t mipLevel, VkExtent3D extent, VkDeviceSize size)
+{
+        ImageCopy copy {};
+        copy.dst = dst;
+        copy.mipLevels = 1;
+        copy.region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy.region.imageSubresource.mipLevel = mipLevel;
+        copy.region.imageSubresource.baseArrayLayer = 0;
+        copy.region.imageSubresource.layerCount = 1;
+        copy.region.imageExtent = extent;
+        void* data = allocate(size, UPLOAD_STAGING_ALIGNMENT, copy.src, copy.region.bufferOffset);
+        _imageCopies.push_back(copy);
+
+        current_stats().bytes += size;
+        current_stats().copies++;
+        return data;
+}
+
+void UploadManager::copy_image_levels(VkImage src, uint32_t srcLevel, VkImage dst, uint32_t dstLevel, uint32_t levelCount,
+        VkExtent3D extent)
+{
+        _levelCopies.push_back({ src, dst, srcLevel, dstLevel, levelCount, extent });
+}
+
+SubmitToken UploadManager::flush()
+{
+        retire();
+        if (!has_pending()) {
+                return _lastFlush;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+
+        Batch batch {};
+        batch.token = _submitter->submit([this](VkCommandBuffer cmd) { record(cmd); });
+        batch.oversized = std::move(_oversized);
+        _oversized.clear();
+        _inFlight.push_back(std::move(batch));
+
+        _lastFlush = _inFlight.back().token;
+        // the next frame waits for this before touching the new data
+        _acquireValue = _lastFlush.value;
+
+        _bufferCopies.clear();
+        _imageCopies.clear();
+
+        UploadStats& stats = current_stats();
+        stats.flushes++;
+        stats.milliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        return _lastFlush;
+}
+
+void UploadManager::record(VkCommandBuffer cmd)
+{
+        const bool transfer = dedicated_queue();
+
+        // one vkCmdCopyBuffer per source/destination pair with all of its regions
+        std::stable_sort(_bufferCopies.begin(), _bufferCopies.end(), [](const BufferCopy& l, const BufferCopy& r) {
+                return std::tie(l.src, l.dst) < std::tie(r.src, r.dst);
+        });
+        std::vector<VkBufferCopy> regions;
+        for (size_t i = 0; i < _bufferCopies.size();) {
+                size_t end = i;
+                regions.clear();
+                while (end < _bufferCopies.size() && _bufferCopies[end].src == _bufferCopies[i].src && _bufferCopies[end].dst == _bufferCopies[i].dst) {
+                        regions.push_back(_bufferCopies[end].region);
+                        end++;
+                }
+                vkCmdCopyBuffer(cmd, _bufferCopies[i].src, _bufferCopies[i].dst, static_cast<uint32_t>(regions.size()), regions.data());
+                i = end;
+        }
+
+        // copies of a single level only transition that level, the levels
+        // of one image may come in different flushes
+        auto copy_barrier = [](const ImageCopy& copy, VkImageLayout oldLayout, VkImageLayout newLayout) {
+                VkImageMemoryBarrier barrier = image_barrier(copy.dst, oldLayout, newLayout);
+                if (copy.mipLevels == 1) {
+                        barrier.subresourceRange.baseMipLevel = copy.region.imageSubresource.mipLevel;
+                        barrier.subresourceRange.levelCount = 1;
+                }
+                return barrier;
+        };
+
+        std::vector<VkImageMemoryBarrier> imageBarriers;
+        if (!_imageCopies.empty()) {
+                for (const ImageCopy& copy : _imageCopies) {
+                        VkImageMemoryBarrier barrier = copy_barrier(copy, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+                        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                        imageBarriers.push_back(barrier);
+                }
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+                        static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+
+                for (const ImageCopy& copy : _imageCopies) {
+                        vkCmdCopyBufferToImage(cmd, copy.src, copy.dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+                }
+        }
+
+        // The final layout transitions. With a dedicated transfer queue they
+        // double as the release half of the ownership transfer, the graphics
+        // queue repeats them as the acquire half in record_acquires.
+        // Images with mips stay in TRANSFER_DST_OPTIMAL for the blits, a
+        // transfer family may not be able to blit at all.
+        imageBarriers.clear();
+        for (const ImageCopy& copy : _imageCopies) {
+                const bool mips = copy.mipLevels > 1;
+                if (mips) {
+                        _mipChains.push_back({ copy.dst, copy.region.imageExtent, copy.mipLevels });
+                }
+                VkImageLayout finalLayout = mips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+                VkImageMemoryBarrier barrier = copy_barrier(copy, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, finalLayout);
+                barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                if (transfer) {
+                        barrier.srcQueueFamilyIndex = _submitter->queue_family();
+                        barrier.dstQueueFamilyIndex = _graphicsFamily;
+                        VkImageMemoryBarrier acquire = barrier;
+                        acquire.srcAccessMask = 0;
+                        acquire.dstAccessMask = mips ? VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+                        _acquireImages.push_back(acquire);
+                } else if (!mips) {
+                        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+                } else {
+                        // nothing to transition, the semaphore wait orders it
+                        continue;
+                }
+                imageBarriers.push_back(barrier);
+        }
+
+        std::vector<VkBufferMemoryBarrier> bufferBarriers;
+        VkMemoryBarrier memoryBarrier {};
+        memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        memoryBarrier.dstAccessMask = BUFFER_CONSUMER_ACCESS;
+        if (transfer) {
+                for (const BufferCopy& copy : _bufferCopies) {
+                        VkBufferMemoryBarrier barrier {};
+                        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+                        barrier.srcQueueFamilyIndex = _submitter->queue_family();
+                        barrier.dstQueueFamilyIndex = _graphicsFamily;
+                        barrier.buffer = copy.dst;
+                        barrier.offset = copy.region.dstOffset;
+                        barrier.size = copy.region.size;
+                        bufferBarriers.push_back(barrier);
+
+                        VkBufferMemoryBarrier acquire = barrier;
+                        acquire.srcAccessMask = 0;
+                        acquire.dstAccessMask = BUFFER_CONSUMER_ACCESS;
+                        _acquireBuffers.push_back(acquire);
+                }
+        }
+
+        // The release barriers only need a transfer stage on this side, the
+        // same queue case makes the writes visible to the consumers directly.
+        // The graphics stages are only legal there, a transfer family may not
+        // support them.
+        VkPipelineStageFlags dstStages = transfer ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : CONSUMER_STAGES;
+        vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStages, 0, transfer ? 0 : 1, &memoryBarrier,
+                static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<uint32_t>(imageBarriers.size()),
+                imageBarriers.data());
+}
+
+void UploadManager::wait_idle()
+{
+        if (_lastFlush.valid()) {
+                auto start = std::chrono::steady_clock::now();
+                _submitter->wait(_lastFlush);
+                current_stats().milliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        retire();
+        // nothing staged is waiting for a flush, so the whole ring is free
+        if (!has_pending()) {
+                _ringHead = 0;
+        }
+}
+
+void UploadManager::retire()
+{
+        while (!_inFlight.empty() && _submitter->is_complete(_inFlight.front().token)) {
+                for (const AllocatedBuffer& buffer : _inFlight.front().oversized) {
+                        vmaDestroyBuffer(_allocator, buffer._buffer, buffer._allocation);
+                }
+                _inFlight.pop_front();
+        }
+}
+
+uint64_t UploadManager::record_acquires(VkCommandBuffer cmd)
+{
+        uint64_t waitValue = _acquireValue;
+        _acquireValue = 0;
+
+        if (!_acquireBuffers.empty() || !_acquireImages.empty()) {
+                vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, CONSUMER_STAGES | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr,
+                        static_cast<uint32_t>(_acquireBuffers.size()), _acquireBuffers.data(), static_cast<uint32_t>(_acquireImages.size()),
+                        _acquireImages.data());
+                _acquireBuffers.clear();
+                _acquireImages.clear();
+        }
+
+        // after the acquires, the blits need the ownership of the images
+        for (const MipChain& chain : _mipChains) {
+                record_mip_chain(cmd, chain.image, chain.extent, chain.mipLevels);
+        }
+        _mipChains.clear();
+
+        // the sources may be images that were only just acquired above
+        for (const LevelCopy& copy : _levelCopies) {
+                record_level_copy(cmd, copy.src, copy.srcLevel, copy.dst, copy.dstLevel, copy.levelCount, copy.extent);
+        }
+        _levelCopies.clear();
+
+        return waitValue;
+}
+
+void UploadManager::begin_phase(const char* name)
+{
+        // whatever was staged so far belongs to the previous phase
+        flush();
+        _phases.push_back({ name, {} });
+        _currentPhase = _phases.size() - 1;
+        _phaseStart = std::chrono::steady_clock::now();
+}
+
+void UploadManager::end_phase()
+{
+        flush();
+
+        const UploadPhase& phase = _phases[_currentPhase];
+        float total = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - _phaseStart).count();
+        std::cout << "Uploads (" << phase.name << "): " << phase.stats.bytes / 1024 << " KB in " << phase.stats.copies
+                  << " copies, " << phase.stats.flushes << " flushes, " << phase.stats.milliseconds << " ms submitting and waiting, "
+                  << total << " ms total on the cpu" << std::endl;
+
+        // back to collecting into "other"
+        _currentPhase = 0;
+}
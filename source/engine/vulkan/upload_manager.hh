@@ -0,0 +1,175 @@
+#pragma once
+
+#include "async_submit.hh"
+#include "types.hh"
+
+#include <chrono>
+#include <deque>
+#include <string>
+#include <vector>
+
+// default size of the persistently mapped staging ring
+constexpr VkDeviceSize UPLOAD_RING_SIZE = 64 * 1024 * 1024;
+// keeps every copy source suitably aligned for any texel, block or index size
+constexpr VkDeviceSize UPLOAD_STAGING_ALIGNMENT = 16;
+
+struct UploadStats {
+        uint64_t bytes = 0;
+        uint32_t copies = 0;
+        uint32_t flushes = 0;
+        float milliseconds = 0.0f;
+};
+
+struct UploadPhase {
+        std::string name;
+        UploadStats stats;
+};
+
+// Collects copies into gpu buffers and images and submits all of them at
+// once, so loading N assets is one round trip instead of N. The data goes
+// through a persistently mapped staging ring, uploads that don't fit into the
+// ring get their own staging buffer until their copies finished.
+//
+// The copies are submitted through the transfer queue's AsyncSubmitter, a
+// dedicated family when the device has one. The graphics queue waits for the
+// submitter's timeline in the first frame after the upload and takes
+// ownership of the resources there (record_acquires).
+//
+// stage_*() hands out staging memory that has to be filled before the next
+// stage_*() or flush() call, the ring may be flushed and reused in between.
+class UploadManager {
+public:
+        void init(VmaAllocator allocator, AsyncSubmitter& submitter, uint32_t graphicsFamily,
+                VkDeviceSize ringSize = UPLOAD_RING_SIZE);
+        void destroy();
+
+        // copies size bytes into dst at dstOffset
+        void* stage_buffer(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+
+        // Fills mip level 0 of a color image from tightly packed texels, the
+        // image ends up in SHADER_READ_ONLY_OPTIMAL. With mipLevels > 1 the
+        // other levels are blitted down from level 0 on the graphics queue
+        // in record_acquires, the image needs TRANSFER_SRC usage and a format
+        // that supports linear filtered blits for that.
+        void* stage_image(VkImage dst, VkExtent3D extent, VkDeviceSize size, uint32_t mipLevels = 1);
+        // Fills a single level with data laid out like the format wants it in
+        // a buffer, e.g. precompressed blocks. extent is the size of that
+        // level, the transitions only touch that level.
+        void* stage_image_level(VkImage dst, uint32_t mipLevel, VkExtent3D extent, VkDeviceSize size);
+
+        // Copies levelCount levels of src, an image the graphics queue
+        // samples in SHADER_READ_ONLY_OPTIMAL, into dst from dstLevel on.
+        // Nothing is staged, the copy is recorded on the graphics queue in
+        // record_acquires, after the uploads it may depend on. extent is the
+        // size of the first level, src needs TRANSFER_SRC usage.
+        void copy_image_levels(VkImage src, uint32_t srcLevel, VkImage dst, uint32_t dstLevel, uint32_t levelCount, VkExtent3D extent);
+
+        // submits every pending copy in one command buffer, doesn't wait
+        SubmitToken flush();
+        // blocks until everything flushed so far finished on the gpu
+        void wait_idle();
+
+        bool has_pending() const { return !_bufferCopies.empty() || !_imageCopies.empty(); }
+
+        // Staging that fits into ring_space() bytes (alignment included) is
+        // handed out without a wrap, so everything staged until then can
+        // still be filled. Uploads bigger than ring_size() never use the ring.
+        VkDeviceSize ring_space() const { return _ringSize - _ringHead; }
+        VkDeviceSize ring_size() const { return _ringSize; }
+
+        // Records the graphics queue half of the ownership transfers of
+        // everything flushed since the last call, the mip generation of the
+        // images flushed with more than one level and the level copies
+        // between images. Returns the timeline value
+        // the submission of cmd has to wait for, 0 when there is nothing new.
+        uint64_t record_acquires(VkCommandBuffer cmd);
+        VkSemaphore timeline() const { return _submitter->timeline(); }
+
+        // false when the copies share the graphics queue family
+        bool dedicated_queue() const { return _submitter->queue_family() != _graphicsFamily; }
+
+        // Phases group the stats of a loading step, end_phase() flushes and
+        // prints what the phase uploaded, without waiting for the gpu.
+        void begin_phase(const char* name);
+        void end_phase();
+        const std::vector<UploadPhase>& phases() const { return _phases; }
+
+private:
+        struct BufferCopy {
+                VkBuffer src;
+                VkBuffer dst;
+                VkBufferCopy region;
+        };
+
+        struct ImageCopy {
+                VkBuffer src;
+                VkImage dst;
+                VkBufferImageCopy region;
+                // levels generated from level 0, 1 for copies of one level
+                uint32_t mipLevels;
+        };
+
+        struct LevelCopy {
+                VkImage src;
+                VkImage dst;
+                uint32_t srcLevel;
+                uint32_t dstLevel;
+                uint32_t levelCount;
+                VkExtent3D extent;
+        };
+
+        // an image whose levels below 0 still have to be generated
+        struct MipChain {
+                VkImage image;
+                VkExtent3D extent;
+                uint32_t mipLevels;
+        };
+
+        // staging buffers of uploads bigger than the ring, freed once the
+        // flush they were copied in finished
+        struct Batch {
+                SubmitToken token;
+                std::vector<AllocatedBuffer> oversized;
+        };
+
+        // staging memory for size bytes, waits for the ring to drain when full
+        void* allocate(VkDeviceSize size, VkDeviceSize alignment, VkBuffer& buffer, VkDeviceSize& offset);
+        // records the pending copies and their barriers
+        void record(VkCommandBuffer cmd);
+        // frees the oversized staging buffers of finished batches
+        void retire();
+
+        UploadStats& current_stats() { return _phases[_currentPhase].stats; }
+
+        VmaAllocator _allocator = nullptr;
+        AsyncSubmitter* _submitter = nullptr;
+        uint32_t _graphicsFamily = 0;
+
+        // last flush, wait_idle waits for it
+        SubmitToken _lastFlush;
+        std::deque<Batch> _inFlight;
+
+        AllocatedBuffer _ring {};
+        char* _ringData = nullptr;
+        VkDeviceSize _ringSize = 0;
+        VkDeviceSize _ringHead = 0;
+
+        std::vector<AllocatedBuffer> _oversized;
+        std::vector<BufferCopy> _bufferCopies;
+        std::vector<ImageCopy> _imageCopies;
+
+        // graphics side barriers of the flushed uploads, and the timeline
+        // value they are complete at
+        std::vector<VkBufferMemoryBarrier> _acquireBuffers;
+        std::vector<VkImageMemoryBarrier> _acquireImages;
+        std::vector<MipChain> _mipChains;
+        // recorded in the order they were asked for, a copy may read what
+        // the one before it wrote
+        std::vector<LevelCopy> _levelCopies;
+        uint64_t _acquireValue = 0;
+
+        // the first phase collects whatever is uploaded outside of a phase
+        std::vector<UploadPhase> _phases { { "other", {} } };
+        size_t _currentPhase = 0;
+        std::chrono::steady_clock::time_point _phaseStart;
+};
@@ -1,7 +1,199 @@
 #include "engine.hh"
+#include "gltf.hh"
+#include "obj_parser.hh"
+#include "texture_cook.hh"
+#include "textures.hh"
+#include "thread_pool.hh"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// the optional size argument of the benchmarks, false when it isn't a
+// positive number
+static bool parse_size(int argc, char* argv[], const char* what, uint32_t& size)
+{
+        if (argc <= 2) {
+                return true;
+        }
+        char* end = nullptr;
+        long value = std::strtol(argv[2], &end, 10);
+        if (end == argv[2] || *end != '\0' || value <= 0 || value > 100000) {
+                std::fprintf(stderr, "ERROR: the %s has to be between 1 and 100000, got %s\n", what, argv[2]);
+                return false;
+        }
+        size = static_cast<uint32_t>(value);
+        return true;
+}
+
+// --bench-obj [grid size]: compares the obj loaders on suzanne and on a
+// synthetic grid with 2 * grid size^2 faces, then exits.
+static int run_obj_benchmark(int argc, char* argv[])
+{
+        uint32_t gridSize = 1000;
+        if (!parse_size(argc, argv, "grid size", gridSize)) {
+                return 1;
+        }
+
+        obj::benchmark("../models/suzanne.obj");
+
+        std::string synthetic = (std::filesystem::temp_directory_path() / "synthetic.obj").string();
+        if (!obj::write_synthetic(synthetic.c_str(), gridSize)) {
+                return 1;
+        }
+        obj::benchmark(synthetic.c_str());
+        std::filesystem::remove(synthetic);
+
+        return 0;
+}
+
+// --bench-gltf [grid size]: same meshes as --bench-obj, loading the obj
+// against loading the geometry converted to glb.
+static int run_gltf_benchmark(int argc, char* argv[])
+{
+        uint32_t gridSize = 1000;
+        if (!parse_size(argc, argv, "grid size", gridSize)) {
+                return 1;
+        }
+
+        gltf::benchmark("../models/suzanne.obj");
+
+        std::string synthetic = (std::filesystem::temp_directory_path() / "synthetic.obj").string();
+        if (!obj::write_synthetic(synthetic.c_str(), gridSize)) {
+                return 1;
+        }
+        gltf::benchmark(synthetic.c_str());
+        std::filesystem::remove(synthetic);
+
+        return 0;
+}
+
+// an uncompressed 32 bit TGA with some noise, so the block compression
+// has something to do
+static bool write_synthetic_texture(const std::string& filename, uint32_t size, uint64_t seed)
+{
+        uint8_t header[18] = {};
+        header[2] = 2;
+        header[12] = static_cast<uint8_t>(size);
+        header[13] = static_cast<uint8_t>(size >> 8);
+        header[14] = static_cast<uint8_t>(size);
+        header[15] = static_cast<uint8_t>(size >> 8);
+        header[16] = 32;
+        // top left origin, 8 bits of alpha
+        header[17] = 0x28;
+
+        std::vector<uint8_t> texels(size_t(size) * size * 4);
+        uint64_t state = seed * 0x9E3779B97F4A7C15ull + 1;
+        for (uint32_t y = 0; y < size; y++) {
+                for (uint32_t x = 0; x < size; x++) {
+                        state = state * 6364136223846793005ull + 1442695040888963407ull;
+                        const uint8_t noise = static_cast<uint8_t>(state >> 59);
+                        uint8_t* texel = &texels[(size_t(y) * size + x) * 4];
+                        texel[0] = static_cast<uint8_t>(x * 255 / size + noise);
+                        texel[1] = static_cast<uint8_t>(y * 255 / size + noise);
+                        texel[2] = static_cast<uint8_t>(seed * 37 + noise);
+                        texel[3] = 255;
+                }
+        }
+
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(texels.data()), texels.size());
+        return file.good();
+}
+
+// Writes count synthetic images to a temporary directory, then prints how
+// long load_textures takes for all of them against load_image_from_file and
+// load_texture one at a time. The first batch cooks the whole set.
+static void bench_texture_batch_load(VulkanEngine& engine, uint32_t count)
+{
+        // new contents every run, so the first batch really misses the cache
+        const uint64_t run = static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+        const std::filesystem::path directory = std::filesystem::temp_directory_path() / "texture_benchmark";
+        std::filesystem::create_directories(directory);
+        std::vector<std::string> files(count);
+        for (uint32_t i = 0; i < count; i++) {
+                files[i] = (directory / ("texture" + std::to_string(i) + ".tga")).string();
+                if (!write_synthetic_texture(files[i], 128, run + i)) {
+                        std::cerr << "ERROR: failed to write " << files[i] << std::endl;
+                        return;
+                }
+        }
+
+        // every copy has to be done on the gpu as well
+        auto measure = [&](auto&& load) {
+                auto start = std::chrono::high_resolution_clock::now();
+                load();
+                engine._uploads.flush();
+                engine._uploads.wait_idle();
+                std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+                return elapsed.count();
+        };
+        std::vector<Texture> textures;
+        const double cold = measure([&]() { vkutil::load_textures(engine, files, textures); });
+        const double images = measure([&]() {
+                for (const std::string& file : files) {
+                        Texture texture;
+                        vkutil::load_image_from_file(engine, file.c_str(), texture);
+                }
+        });
+        const double single = measure([&]() {
+                for (const std::string& file : files) {
+                        Texture texture;
+                        vkutil::load_texture(engine, file.c_str(), texture);
+                }
+        });
+        const double batch = measure([&]() { vkutil::load_textures(engine, files, textures); });
+
+        std::printf("%u textures of 128x128, %s\n", count, engine._textureCompressionBC ? "BC" : "RGBA8");
+        std::printf("  load_textures, cooking:  %8.2f ms\n", cold);
+        std::printf("  load_image_from_file:    %8.2f ms\n", images);
+        std::printf("  load_texture:            %8.2f ms\n", single);
+        std::printf("  load_textures:           %8.2f ms, %u threads\n", batch, ThreadPool::global().size());
+
+        // the cooked versions would never be used again
+        std::error_code error;
+        for (const std::string& file : files) {
+                std::filesystem::remove(texture_cook::entry_path(file.c_str()), error);
+        }
+        std::filesystem::remove_all(directory, error);
+}
+
+// --bench-textures [count]: loads count synthetic textures one at a time and
+// in one batch, needs the device, so the window opens for it.
+static int run_texture_benchmark(int argc, char* argv[])
+{
+        uint32_t count = 500;
+        if (!parse_size(argc, argv, "texture count", count)) {
+                return 1;
+        }
+
+        VulkanEngine engine;
+        engine.init();
+        bench_texture_batch_load(engine, count);
+        engine.cleanup();
+
+        return 0;
+}
 
 int main(int argc, char* argv[])
 {
+        if (argc > 1 && std::strcmp(argv[1], "--bench-obj") == 0) {
+                return run_obj_benchmark(argc, argv);
+        }
+        if (argc > 1 && std::strcmp(argv[1], "--bench-gltf") == 0) {
+                return run_gltf_benchmark(argc, argv);
+        }
+        if (argc > 1 && std::strcmp(argv[1], "--bench-textures") == 0) {
+                return run_texture_benchmark(argc, argv);
+        }
+
         VulkanEngine engine;
 
         engine.init();
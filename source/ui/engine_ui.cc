@@ -1,4 +1,5 @@
 #include "engine.hh"
+#include "mesh_cache.hh"
 
 void VulkanEngine::init_imgui()
 {
@@ -49,7 +50,16 @@ void VulkanEngine::init_imgui()
         init_info.MSAASamples = _sampleCount;
 
         ImGuiIO& io = ImGui::GetIO();
-        ImFont* jetbrainsMono = io.Fonts->AddFontFromFileTTF("../fonts/jetbrains_mono.ttf", 18);
+        // the atlas only borrows the ttf, _fontFile keeps it around
+        ImFont* jetbrainsMono = nullptr;
+        if (Vfs::global().read("../fonts/jetbrains_mono.ttf", _fontFile)) {
+                ImFontConfig fontConfig;
+                fontConfig.FontDataOwnedByAtlas = false;
+                jetbrainsMono = io.Fonts->AddFontFromMemoryTTF(const_cast<uint8_t*>(_fontFile.data),
+                        static_cast<int>(_fontFile.size), 18, &fontConfig);
+        } else {
+                jetbrainsMono = io.Fonts->AddFontDefault();
+        }
         io.Fonts->Build();
         ImGui::SetCurrentFont(jetbrainsMono);
 
@@ -134,13 +144,11 @@ void VulkanEngine::init_imgui()
         style.LogSliderDeadzone = 4;
         style.TabRounding = 4;
 
-        // execute a gpu command to upload imgui font textures
-        immediate_submit(
+        // upload the imgui font textures, init() waits for it and clears the
+        // cpu side font data once everything else is loaded
+        _fontUpload = submit_async(
                 [&](VkCommandBuffer cmd) { ImGui_ImplVulkan_CreateFontsTexture(cmd); });
 
-        // clear font textures from cpu data
-        ImGui_ImplVulkan_DestroyFontUploadObjects();
-
         // add the destroy the imgui created structures
         _mainDeletionQueue.push_function([=]() {
                 vkDestroyDescriptorPool(_device, imguiPool, nullptr);
@@ -153,8 +161,43 @@ void VulkanEngine::draw_stats()
         // imgui commands
         ImGui::Begin("Engine Status");
         ImGui::Text("FPS: %d", static_cast<int>(floor(_fps)));
-        ImGui::Text("Number Of Meshes: %lu", _meshes.size());
+        const MeshStreamingStats& streaming = _meshStreamer.stats();
+        ImGui::Text("Meshes: %u resident / %u, %u loading, %u evicted",
+                    streaming.resident, streaming.meshes, streaming.loading,
+                    streaming.evictions);
+        ImGui::Text("Mesh Memory: %.1f / %.1f MB",
+                    streaming.residentBytes / (1024.0 * 1024.0),
+                    streaming.budget / (1024.0 * 1024.0));
+        const MeshCacheStats cache = MeshCache::global().stats();
+        ImGui::Text("Mesh Cache: %u hits, %u misses, %.1f ms saved",
+                    cache.hits, cache.misses, cache.savedMs);
+        const TextureStreamingStats& textures = _textureStreamer.stats();
+        ImGui::Text("Textures: %u in %u images, %u loading, %u streaming, "
+                    "%u evicted",
+                    textures.textures, textures.images, textures.loading,
+                    textures.streaming, textures.evictions);
+        ImGui::Text("Texture Memory: %.1f / %.1f MB",
+                    textures.residentBytes / (1024.0 * 1024.0),
+                    textures.budget / (1024.0 * 1024.0));
         ImGui::Text("Current Draw Calls: %d", _currentDrawCalls);
+        ImGui::Checkbox("Depth Prepass", &_depthPrepass);
+        ImGui::Text("Geometry Arena: %.1f / %.1f MB vertices, %.1f / %.1f MB indices",
+                    _geometryArena.vertex_ranges().used() / (1024.0 * 1024.0),
+                    _geometryArena.vertex_ranges().capacity() / (1024.0 * 1024.0),
+                    _geometryArena.index_ranges().used() / (1024.0 * 1024.0),
+                    _geometryArena.index_ranges().capacity() / (1024.0 * 1024.0));
+        ImGui::Text("Visible Meshlets: %zu / %zu", _meshletStats.visible,
+                    _meshletStats.total);
+        for (const UploadPhase& phase : _uploads.phases()) {
+                ImGui::Text("Uploads (%s): %.1f KB, %u copies, %u flushes",
+                            phase.name.c_str(), phase.stats.bytes / 1024.0,
+                            phase.stats.copies, phase.stats.flushes);
+        }
+        for (size_t i = 0; i < MAX_MESH_LODS; i++) {
+                ImGui::Text("Objects At LOD %zu: %d", i, _lodHistogram[i]);
+                _lodHistogram[i] = 0;
+        }
         _currentDrawCalls = 0;
+        _meshletStats = {};
         ImGui::End();
 }
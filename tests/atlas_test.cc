@@ -0,0 +1,203 @@
+#include "atlas.hh"
+#include "check.hh"
+#include "ktx2.hh"
+#include "mapped_file.hh"
+
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// The packer has to keep the cells apart and aligned, the baked pages must
+// not have anything but the member in its cell. The engine builds the uv
+// rects of the members straight from the manifest, so a manifest that would
+// give it empty pages or rects outside of them has to be rejected.
+namespace {
+
+const std::filesystem::path DIRECTORY = std::filesystem::temp_directory_path() / "atlas_test";
+
+bool accepts(const std::string& pageSize, const std::string& rect)
+{
+        const std::filesystem::path path = DIRECTORY / "atlases.json";
+        std::ofstream(path, std::ios::binary | std::ios::trunc)
+                << "{ \"version\": " << atlas::VERSION << ", \"key\": \"00000000000000ff\", \"pages\": [ { \"compressed\": \"a.ktx2\", "
+                << "\"uncompressed\": \"b.ktx2\", " << pageSize << ", \"opaque\": true, \"members\": [ { \"name\": \"textures/a.png\", "
+                << rect << " } ] } ] }";
+        atlas::Manifest manifest;
+        return atlas::read_manifest(path.string().c_str(), manifest);
+}
+
+void test_pack()
+{
+        std::mt19937 random(42);
+        std::vector<atlas::Rect> sizes;
+        for (int i = 0; i < 300; i++) {
+                sizes.push_back({ 0, 0, 1 + random() % 256, 1 + random() % 256 });
+        }
+        std::vector<atlas::Rect> rects, pageSizes;
+        std::vector<uint32_t> pages;
+        const uint32_t padding = 8, maxSize = 1024;
+        CHECK(atlas::pack(sizes, padding, maxSize, rects, pages, pageSizes));
+        CHECK(rects.size() == sizes.size() && pages.size() == sizes.size());
+        CHECK(pageSizes.size() > 1);
+
+        // the cells the border and the alignment take
+        std::vector<atlas::Rect> cells(sizes.size());
+        for (size_t i = 0; i < sizes.size() && i < rects.size() && i < pages.size(); i++) {
+                CHECK(pages[i] < pageSizes.size());
+                CHECK(rects[i].width == sizes[i].width && rects[i].height == sizes[i].height);
+                CHECK(rects[i].x >= padding && rects[i].y >= padding);
+                CHECK(rects[i].x % padding == 0 && rects[i].y % padding == 0);
+                cells[i] = { rects[i].x - padding, rects[i].y - padding, (sizes[i].width + 3 * padding - 1) / padding * padding,
+                        (sizes[i].height + 3 * padding - 1) / padding * padding };
+                if (pages[i] < pageSizes.size()) {
+                        const atlas::Rect& page = pageSizes[pages[i]];
+                        CHECK(cells[i].x + cells[i].width <= page.width && cells[i].y + cells[i].height <= page.height);
+                }
+        }
+        for (const atlas::Rect& page : pageSizes) {
+                CHECK(page.width <= maxSize && page.height <= page.width);
+                CHECK(std::has_single_bit(page.width) && std::has_single_bit(page.height));
+        }
+        for (size_t i = 0; i < cells.size(); i++) {
+                for (size_t j = i + 1; j < cells.size(); j++) {
+                        const atlas::Rect& l = cells[i];
+                        const atlas::Rect& r = cells[j];
+                        CHECK(pages[i] != pages[j] || l.x + l.width <= r.x || r.x + r.width <= l.x || l.y + l.height <= r.y
+                                || r.y + r.height <= l.y);
+                }
+        }
+
+        // too big even for an empty page
+        CHECK(!atlas::pack({ { 0, 0, 1020, 16 } }, padding, maxSize, rects, pages, pageSizes));
+        CHECK(atlas::pack({}, padding, maxSize, rects, pages, pageSizes) && pageSizes.empty());
+}
+
+// an uncompressed 32 bit tga, bottom-up like most writers do it
+void write_tga(const std::filesystem::path& path, uint32_t width, uint32_t height, uint8_t red)
+{
+        uint8_t header[18] = {};
+        header[2] = 2;
+        header[12] = static_cast<uint8_t>(width);
+        header[13] = static_cast<uint8_t>(width >> 8);
+        header[14] = static_cast<uint8_t>(height);
+        header[15] = static_cast<uint8_t>(height >> 8);
+        header[16] = 32;
+        header[17] = 8;
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (uint32_t i = 0; i < width * height; i++) {
+                // BGRA
+                const uint8_t texel[4] = { 32, 64, red, 255 };
+                file.write(reinterpret_cast<const char*>(texel), sizeof(texel));
+        }
+}
+
+// Sizes that aren't multiples of the padding leave part of the aligned cell
+// past the border, it has to be filled with the member like the border is.
+void test_bake()
+{
+        const std::vector<std::string> names { "a.tga", "b.tga" };
+        std::vector<std::string> sources;
+        write_tga(DIRECTORY / names[0], 20, 13, 200);
+        write_tga(DIRECTORY / names[1], 5, 30, 100);
+        for (const std::string& name : names) {
+                sources.push_back((DIRECTORY / name).string());
+        }
+
+        const std::filesystem::path directory = DIRECTORY / "pages";
+        std::filesystem::create_directories(directory);
+        atlas::Manifest manifest;
+        CHECK(atlas::bake(sources, names, directory.string(), manifest));
+        CHECK(manifest.pages.size() == 1);
+        if (manifest.pages.size() != 1) {
+                return;
+        }
+        const atlas::Page& page = manifest.pages[0];
+        CHECK(page.opaque && page.members.size() == 2);
+
+        MappedFile file;
+        ktx2::Image image;
+        CHECK(file.open((directory / page.uncompressedFile).string().c_str()) && ktx2::parse(file.data(), file.size(), image));
+        CHECK(image.format == VK_FORMAT_R8G8B8A8_SRGB && image.width == page.width && image.height == page.height);
+        if (image.levels.empty() || image.width != page.width) {
+                return;
+        }
+        const uint32_t padding = ATLAS_PADDING;
+        for (const atlas::Member& member : page.members) {
+                const uint8_t red = member.name == names[0] ? 200 : 100;
+                const uint32_t cellWidth = (member.rect.width + 3 * padding - 1) / padding * padding;
+                const uint32_t cellHeight = (member.rect.height + 3 * padding - 1) / padding * padding;
+                bool filled = true;
+                for (uint32_t y = member.rect.y - padding; y < member.rect.y - padding + cellHeight; y++) {
+                        for (uint32_t x = member.rect.x - padding; x < member.rect.x - padding + cellWidth; x++) {
+                                const uint8_t* texel = image.levels[0].data + (size_t(y) * image.width + x) * 4;
+                                filled = filled && texel[0] == red && texel[1] == 64 && texel[2] == 32;
+                        }
+                }
+                CHECK(filled);
+        }
+
+        // nothing changed, the manifest of the last bake is returned
+        CHECK(atlas::write_manifest((directory / ATLAS_MANIFEST).string().c_str(), manifest));
+        atlas::Manifest again;
+        CHECK(atlas::bake(sources, names, directory.string(), again));
+        CHECK(again.key == manifest.key && again.pages.size() == 1);
+}
+
+void test_manifest()
+{
+        atlas::Manifest manifest;
+        manifest.key = 0x1234;
+        manifest.pages.push_back({ "a.ktx2", "b.ktx2", 256, 128, false, { { "textures/a.png", { 8, 8, 64, 32 } } } });
+        const std::string path = (DIRECTORY / "written.json").string();
+        CHECK(atlas::write_manifest(path.c_str(), manifest));
+        atlas::Manifest read;
+        CHECK(atlas::read_manifest(path.c_str(), read));
+        CHECK(read.key == 0x1234 && read.pages.size() == 1);
+        if (read.pages.size() == 1) {
+                const atlas::Page& page = read.pages[0];
+                CHECK(page.compressedFile == "a.ktx2" && page.uncompressedFile == "b.ktx2");
+                CHECK(page.width == 256 && page.height == 128 && !page.opaque);
+                CHECK(page.members.size() == 1 && page.members[0].name == "textures/a.png");
+                CHECK(page.members.size() == 1 && page.members[0].rect.x == 8 && page.members[0].rect.y == 8
+                        && page.members[0].rect.width == 64 && page.members[0].rect.height == 32);
+        }
+
+        const std::string page = "\"width\": 64, \"height\": 32";
+        const std::string rect = "\"x\": 8, \"y\": 8, \"width\": 16, \"height\": 16";
+        CHECK(accepts(page, rect));
+        CHECK(accepts(page, "\"x\": 0, \"y\": 0, \"width\": 64, \"height\": 32"));
+
+        // empty or missing page sizes
+        CHECK(!accepts("\"width\": 0, \"height\": 32", rect));
+        CHECK(!accepts("\"width\": 64, \"height\": 0", rect));
+        CHECK(!accepts("\"width\": 64", rect));
+        CHECK(!accepts("\"width\": -64, \"height\": 32", rect));
+        CHECK(!accepts("\"width\": 64.5, \"height\": 32", rect));
+        CHECK(!accepts("\"width\": 1e10, \"height\": 32", rect));
+
+        // empty rects and rects reaching out of the page
+        CHECK(!accepts(page, "\"x\": 8, \"y\": 8, \"width\": 0, \"height\": 16"));
+        CHECK(!accepts(page, "\"x\": 8, \"y\": 8, \"width\": 16"));
+        CHECK(!accepts(page, "\"x\": 56, \"y\": 8, \"width\": 16, \"height\": 16"));
+        CHECK(!accepts(page, "\"x\": 8, \"y\": 24, \"width\": 16, \"height\": 16"));
+        CHECK(!accepts(page, "\"x\": -8, \"y\": 8, \"width\": 16, \"height\": 16"));
+        CHECK(!accepts(page, "\"x\": 8, \"y\": 8, \"width\": 4294967295, \"height\": 16"));
+}
+
+}
+
+int main()
+{
+        std::filesystem::create_directories(DIRECTORY);
+
+        test_pack();
+        test_bake();
+        test_manifest();
+
+        std::filesystem::remove_all(DIRECTORY);
+        return check_result();
+}
@@ -0,0 +1,367 @@
+#include "bc.hh"
+#include "check.hh"
+#include "ktx2.hh"
+#include "mapped_file.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+// The encoders are decoded again with the rules of the spec and have to stay
+// within an error bound, the KTX2 writer has to produce what the reader and
+// the spec expect.
+namespace {
+
+const std::filesystem::path DIRECTORY = std::filesystem::temp_directory_path() / "bc_test";
+
+uint32_t read_u32(const uint8_t* data)
+{
+        uint32_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+}
+
+uint64_t read_u64(const uint8_t* data)
+{
+        uint64_t value;
+        std::memcpy(&value, data, sizeof(value));
+        return value;
+}
+
+void from_565(uint32_t packed, uint32_t color[3])
+{
+        const uint32_t r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+        color[0] = (r << 3) | (r >> 2);
+        color[1] = (g << 2) | (g >> 4);
+        color[2] = (b << 3) | (b >> 2);
+}
+
+// RGB of a BC1 color block in either mode, alpha 0 for the transparent index
+void decode_color(const uint8_t* block, uint8_t texels[16][4])
+{
+        const uint32_t color0 = block[0] | (block[1] << 8), color1 = block[2] | (block[3] << 8);
+        uint32_t palette[4][4];
+        from_565(color0, palette[0]);
+        from_565(color1, palette[1]);
+        palette[0][3] = palette[1][3] = palette[2][3] = palette[3][3] = 255;
+        for (uint32_t c = 0; c < 3; c++) {
+                if (color0 > color1) {
+                        palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+                        palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+                } else {
+                        palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+                        palette[3][c] = 0;
+                }
+        }
+        if (color0 <= color1) {
+                palette[3][3] = 0;
+        }
+        const uint32_t indices = read_u32(block + 4);
+        for (uint32_t i = 0; i < 16; i++) {
+                for (uint32_t c = 0; c < 4; c++) {
+                        texels[i][c] = static_cast<uint8_t>(palette[(indices >> (2 * i)) & 3][c]);
+                }
+        }
+}
+
+void decode_alpha(const uint8_t* block, uint8_t texels[16][4])
+{
+        uint32_t palette[8] = { block[0], block[1] };
+        for (uint32_t i = 2; i < 8; i++) {
+                if (block[0] > block[1]) {
+                        palette[i] = ((8 - i) * block[0] + (i - 1) * block[1]) / 7;
+                } else {
+                        palette[i] = i < 6 ? ((6 - i) * block[0] + (i - 1) * block[1]) / 5 : (i == 6 ? 0 : 255);
+                }
+        }
+        uint64_t indices = 0;
+        for (uint32_t i = 0; i < 6; i++) {
+                indices |= uint64_t(block[2 + i]) << (8 * i);
+        }
+        for (uint32_t i = 0; i < 16; i++) {
+                texels[i][3] = static_cast<uint8_t>(palette[(indices >> (3 * i)) & 7]);
+        }
+}
+
+// only mode 6, the one the encoder writes, false for any other
+bool decode_bc7(const uint8_t* block, uint8_t texels[16][4])
+{
+        uint32_t position = 0;
+        auto read = [&](uint32_t count) {
+                uint32_t value = 0;
+                for (uint32_t i = 0; i < count; i++, position++) {
+                        value |= ((block[position / 8] >> (position % 8)) & 1u) << i;
+                }
+                return value;
+        };
+        if (read(7) != 1 << 6) {
+                return false;
+        }
+        uint32_t endpoints[2][4];
+        for (uint32_t c = 0; c < 4; c++) {
+                endpoints[0][c] = read(7);
+                endpoints[1][c] = read(7);
+        }
+        const uint32_t pBits[2] = { read(1), read(1) };
+        static const uint32_t WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+        for (uint32_t i = 0; i < 16; i++) {
+                const uint32_t index = read(i == 0 ? 3 : 4);
+                for (uint32_t c = 0; c < 4; c++) {
+                        const uint32_t end0 = (endpoints[0][c] << 1) | pBits[0];
+                        const uint32_t end1 = (endpoints[1][c] << 1) | pBits[1];
+                        texels[i][c] = static_cast<uint8_t>(((64 - WEIGHTS[index]) * end0 + WEIGHTS[index] * end1 + 32) >> 6);
+                }
+        }
+        return true;
+}
+
+struct Error {
+        int largest = 0;
+        double rms = 0.0;
+};
+
+// Compresses rgba, decodes every block and compares the channels that
+// format keeps, the texels outside the image are skipped.
+Error round_trip(const std::vector<uint8_t>& rgba, uint32_t width, uint32_t height, bc::BlockFormat format)
+{
+        std::vector<uint8_t> compressed(bc::compressed_size(format, width, height));
+        bc::compress(rgba.data(), width, height, format, compressed.data());
+
+        const uint32_t blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+        const uint32_t channels = format == bc::BlockFormat::BC1 ? 3 : 4;
+        Error error;
+        uint64_t squares = 0, count = 0;
+        for (uint32_t blockY = 0; blockY < blocksY; blockY++) {
+                for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+                        const uint8_t* block = compressed.data() + (size_t(blockY) * blocksX + blockX) * bc::block_size(format);
+                        uint8_t texels[16][4] = {};
+                        switch (format) {
+                        case bc::BlockFormat::BC1:
+                                decode_color(block, texels);
+                                // the encoder only uses the opaque mode
+                                for (const uint8_t* texel : texels) {
+                                        CHECK(texel[3] == 255);
+                                }
+                                break;
+                        case bc::BlockFormat::BC3:
+                                decode_color(block + 8, texels);
+                                decode_alpha(block, texels);
+                                break;
+                        case bc::BlockFormat::BC7:
+                                CHECK(decode_bc7(block, texels));
+                                break;
+                        }
+                        for (uint32_t i = 0; i < 16; i++) {
+                                const uint32_t x = blockX * 4 + i % 4, y = blockY * 4 + i / 4;
+                                if (x >= width || y >= height) {
+                                        continue;
+                                }
+                                for (uint32_t c = 0; c < channels; c++) {
+                                        const int d = std::abs(int(texels[i][c]) - int(rgba[(size_t(y) * width + x) * 4 + c]));
+                                        error.largest = std::max(error.largest, d);
+                                        squares += uint64_t(d) * d;
+                                        count++;
+                                }
+                        }
+                }
+        }
+        error.rms = std::sqrt(double(squares) / double(count));
+        return error;
+}
+
+std::vector<uint8_t> flat(uint32_t width, uint32_t height, const uint8_t color[4])
+{
+        std::vector<uint8_t> rgba(size_t(width) * height * 4);
+        for (size_t i = 0; i < rgba.size(); i++) {
+                rgba[i] = color[i % 4];
+        }
+        return rgba;
+}
+
+// smooth ramps in every channel, what most of a photo looks like
+std::vector<uint8_t> gradient(uint32_t width, uint32_t height)
+{
+        std::vector<uint8_t> rgba(size_t(width) * height * 4);
+        for (uint32_t y = 0; y < height; y++) {
+                for (uint32_t x = 0; x < width; x++) {
+                        uint8_t* texel = rgba.data() + (size_t(y) * width + x) * 4;
+                        texel[0] = static_cast<uint8_t>(x * 255 / (width - 1));
+                        texel[1] = static_cast<uint8_t>(y * 255 / (height - 1));
+                        texel[2] = static_cast<uint8_t>(255 - (x + y) * 255 / (width + height - 2));
+                        texel[3] = static_cast<uint8_t>(128 + x * 127 / (width - 1));
+                }
+        }
+        return rgba;
+}
+
+std::vector<uint8_t> noise(uint32_t width, uint32_t height)
+{
+        std::mt19937 random(1234);
+        std::vector<uint8_t> rgba(size_t(width) * height * 4);
+        for (uint8_t& value : rgba) {
+                value = static_cast<uint8_t>(random() & 255);
+        }
+        return rgba;
+}
+
+void test_compress()
+{
+        CHECK(bc::compressed_size(bc::BlockFormat::BC1, 6, 5) == 4 * 8);
+        CHECK(bc::compressed_size(bc::BlockFormat::BC7, 6, 5) == 4 * 16);
+        CHECK(bc::compressed_size(bc::BlockFormat::BC3, 1, 1) == 16);
+
+        // flat colors only lose the 565 rounding, alpha stays exact in BC3
+        const uint8_t color[4] = { 200, 100, 50, 77 };
+        const std::vector<uint8_t> single = flat(8, 8, color);
+        CHECK(round_trip(single, 8, 8, bc::BlockFormat::BC1).largest <= 4);
+        CHECK(round_trip(single, 8, 8, bc::BlockFormat::BC3).largest <= 4);
+        CHECK(round_trip(single, 8, 8, bc::BlockFormat::BC7).largest <= 2);
+        std::vector<uint8_t> alpha(single);
+        for (size_t i = 3; i < alpha.size(); i += 4) {
+                alpha[i] = i % 8 == 3 ? 0 : 255;
+        }
+        CHECK(round_trip(alpha, 8, 8, bc::BlockFormat::BC3).largest <= 4);
+
+        // two colors per block are on the endpoint line
+        std::vector<uint8_t> checker(8 * 8 * 4);
+        for (size_t i = 0; i < 64; i++) {
+                const uint8_t value = (i % 8 + i / 8) % 2 ? 240 : 16;
+                std::fill(checker.begin() + i * 4, checker.begin() + i * 4 + 3, value);
+                checker[i * 4 + 3] = 255;
+        }
+        CHECK(round_trip(checker, 8, 8, bc::BlockFormat::BC1).largest <= 24);
+        CHECK(round_trip(checker, 8, 8, bc::BlockFormat::BC7).largest <= 8);
+
+        // partial blocks at the edges, a block of a 2D ramp isn't on one
+        // line so there is some error even with 16 levels
+        const std::vector<uint8_t> ramp = gradient(37, 19);
+        const Error bc1 = round_trip(ramp, 37, 19, bc::BlockFormat::BC1);
+        const Error bc3 = round_trip(ramp, 37, 19, bc::BlockFormat::BC3);
+        const Error bc7 = round_trip(ramp, 37, 19, bc::BlockFormat::BC7);
+        CHECK(bc1.largest <= 24 && bc1.rms < 8.0);
+        CHECK(bc3.largest <= 24 && bc3.rms < 8.0);
+        CHECK(bc7.largest <= 20 && bc7.rms < 7.0);
+        CHECK(bc7.rms < bc1.rms);
+
+        // no structure at all, just no worse than it has to be
+        const std::vector<uint8_t> random = noise(32, 32);
+        CHECK(round_trip(random, 32, 32, bc::BlockFormat::BC1).rms < 80.0);
+        CHECK(round_trip(random, 32, 32, bc::BlockFormat::BC7).rms < 70.0);
+}
+
+void test_ktx2(VkFormat format, uint32_t blockSize, uint32_t blockExtent, uint32_t model, uint32_t transfer, uint32_t sampleCount)
+{
+        const std::string path = (DIRECTORY / "test.ktx2").string();
+        const uint32_t width = 16, height = 8;
+        std::vector<std::vector<uint8_t>> levels;
+        for (uint32_t level = 0; level < 4; level++) {
+                const uint32_t blocksX = (std::max(width >> level, 1u) + blockExtent - 1) / blockExtent;
+                const uint32_t blocksY = (std::max(height >> level, 1u) + blockExtent - 1) / blockExtent;
+                std::vector<uint8_t>& data = levels.emplace_back(size_t(blocksX) * blocksY * blockSize);
+                for (size_t i = 0; i < data.size(); i++) {
+                        data[i] = static_cast<uint8_t>(i * 7 + level);
+                }
+        }
+        CHECK(ktx2::block_size(format) == blockSize);
+        CHECK(ktx2::block_extent(format) == blockExtent);
+        CHECK(ktx2::write(path.c_str(), format, width, height, levels));
+
+        MappedFile file;
+        CHECK(file.open(path.c_str()));
+        if (!file.is_open()) {
+                return;
+        }
+        const uint8_t* data = file.data();
+
+        // header
+        const uint8_t identifier[12] = { 0xab, 'K', 'T', 'X', ' ', '2', '0', 0xbb, '\r', '\n', 0x1a, '\n' };
+        CHECK(file.size() > 80 + levels.size() * 24);
+        CHECK(std::memcmp(data, identifier, sizeof(identifier)) == 0);
+        CHECK(read_u32(data + 12) == uint32_t(format));
+        CHECK(read_u32(data + 16) == 1);
+        CHECK(read_u32(data + 20) == width && read_u32(data + 24) == height && read_u32(data + 28) == 0);
+        CHECK(read_u32(data + 32) == 0 && read_u32(data + 36) == 1);
+        CHECK(read_u32(data + 40) == levels.size());
+        CHECK(read_u32(data + 44) == 0);
+        const uint32_t dfdOffset = read_u32(data + 48), dfdLength = read_u32(data + 52);
+        CHECK(dfdOffset == 80 + levels.size() * 24);
+        CHECK(read_u32(data + 56) == 0 && read_u32(data + 60) == 0);
+        CHECK(read_u64(data + 64) == 0 && read_u64(data + 72) == 0);
+
+        // level index, the smallest level first in the file, aligned
+        uint64_t previous = file.size();
+        for (size_t level = 0; level < levels.size(); level++) {
+                const uint8_t* index = data + 80 + level * 24;
+                const uint64_t offset = read_u64(index), length = read_u64(index + 8);
+                CHECK(length == levels[level].size() && read_u64(index + 16) == length);
+                CHECK(offset % blockSize == 0 && offset >= dfdOffset + dfdLength);
+                CHECK(offset + length <= previous);
+                CHECK(offset + length <= file.size() && std::memcmp(data + offset, levels[level].data(), length) == 0);
+                previous = offset;
+        }
+
+        // basic data format descriptor
+        const uint8_t* dfd = data + dfdOffset;
+        const uint32_t descriptorSize = 24 + 16 * sampleCount;
+        CHECK(dfdLength == 4 + descriptorSize);
+        CHECK(read_u32(dfd) == dfdLength);
+        CHECK(read_u32(dfd + 4) == 0);
+        CHECK(read_u32(dfd + 8) == (2 | (descriptorSize << 16)));
+        CHECK((read_u32(dfd + 12) & 0xff) == model);
+        CHECK(((read_u32(dfd + 12) >> 8) & 0xff) == 1);
+        CHECK(((read_u32(dfd + 12) >> 16) & 0xff) == transfer);
+        CHECK(read_u32(dfd + 16) == ((blockExtent - 1) | ((blockExtent - 1) << 8)));
+        CHECK(read_u32(dfd + 20) == blockSize && read_u32(dfd + 24) == 0);
+        uint32_t bits = 0;
+        for (uint32_t sample = 0; sample < sampleCount; sample++) {
+                const uint32_t word = read_u32(dfd + 28 + sample * 16);
+                CHECK((word & 0xffff) == bits);
+                bits += ((word >> 16) & 0xff) + 1;
+        }
+        CHECK(bits == blockSize * 8);
+
+        // and the reader hands out the same levels
+        ktx2::Image image;
+        CHECK(ktx2::parse(data, file.size(), image));
+        CHECK(image.format == format && image.width == width && image.height == height);
+        CHECK(image.levels.size() == levels.size());
+        for (size_t level = 0; level < image.levels.size() && level < levels.size(); level++) {
+                CHECK(image.levels[level].size == levels[level].size());
+                CHECK(std::memcmp(image.levels[level].data, levels[level].data(), levels[level].size()) == 0);
+        }
+
+        // cut short, or not a KTX2 at all
+        CHECK(!ktx2::parse(data, 79, image));
+        CHECK(!ktx2::parse(data, dfdOffset, image));
+        std::vector<uint8_t> broken(data, data + file.size());
+        broken[0] = 0;
+        CHECK(!ktx2::parse(broken.data(), broken.size(), image));
+        file.close();
+
+        // levels of the wrong size are never written
+        levels[1].pop_back();
+        CHECK(!ktx2::write(path.c_str(), format, width, height, levels));
+}
+
+}
+
+int main()
+{
+        std::filesystem::create_directories(DIRECTORY);
+
+        test_compress();
+
+        // Khronos data format models: RGBSDA 1, BC1A 128, BC3 130, BC7 134
+        test_ktx2(VK_FORMAT_BC1_RGB_SRGB_BLOCK, 8, 4, 128, 2, 1);
+        test_ktx2(VK_FORMAT_BC3_UNORM_BLOCK, 16, 4, 130, 1, 2);
+        test_ktx2(VK_FORMAT_BC7_SRGB_BLOCK, 16, 4, 134, 2, 1);
+        test_ktx2(VK_FORMAT_R8G8B8A8_UNORM, 4, 1, 1, 1, 4);
+
+        std::filesystem::remove_all(DIRECTORY);
+        return check_result();
+}
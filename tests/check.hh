@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the test executables: a failed CHECK prints where it
+// failed and the test keeps going, main returns check_result().
+inline int& check_failures()
+{
+        static int failures = 0;
+        return failures;
+}
+
+#define CHECK(condition)                                                                         \
+        do {                                                                                     \
+                if (!(condition)) {                                                              \
+                        std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+                        check_failures()++;                                                      \
+                }                                                                                \
+        } while (false)
+
+inline int check_result()
+{
+        if (check_failures() > 0) {
+                std::fprintf(stderr, "%d checks failed\n", check_failures());
+                return 1;
+        }
+        return 0;
+}
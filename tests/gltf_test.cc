@@ -0,0 +1,162 @@
+#include "check.hh"
+#include "gltf.hh"
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Broken glb files have to be rejected by the loader instead of handing out
+// views past the end of the mapping. Every case starts from a valid file
+// written by write_glb and breaks one thing about it.
+namespace {
+
+using Bytes = std::vector<uint8_t>;
+
+const std::filesystem::path DIRECTORY = std::filesystem::temp_directory_path() / "gltf_test";
+
+Bytes read_file(const std::filesystem::path& path)
+{
+        std::ifstream file(path, std::ios::binary);
+        return Bytes(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+uint32_t read_u32(const Bytes& bytes, size_t offset)
+{
+        uint32_t value;
+        std::memcpy(&value, bytes.data() + offset, sizeof(value));
+        return value;
+}
+
+void write_u32(Bytes& bytes, size_t offset, uint32_t value)
+{
+        std::memcpy(bytes.data() + offset, &value, sizeof(value));
+}
+
+// the loader maps the file, so every case gets a file of its own
+bool loads(const Bytes& bytes)
+{
+        static int counter = 0;
+        const std::filesystem::path path = DIRECTORY / ("case" + std::to_string(counter++) + ".glb");
+        std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        Mesh mesh;
+        return mesh.load_from_glb(path.string().c_str());
+}
+
+// write_glb puts the json chunk first, right after the 12 byte header
+std::string json_of(const Bytes& glb)
+{
+        return std::string(reinterpret_cast<const char*>(glb.data()) + 20, read_u32(glb, 12));
+}
+
+// The file with the first occurrence of from in its json replaced
+Bytes with_json(const Bytes& glb, const std::string& from, const std::string& to)
+{
+        std::string json = json_of(glb);
+        const size_t position = json.find(from);
+        CHECK(position != std::string::npos);
+        if (position == std::string::npos) {
+                return glb;
+        }
+        json.replace(position, from.size(), to);
+        json.resize((json.size() + 3) & ~size_t(3), ' ');
+
+        const size_t oldJsonEnd = 20 + read_u32(glb, 12);
+        Bytes result(glb.begin(), glb.begin() + 20);
+        result.insert(result.end(), json.begin(), json.end());
+        result.insert(result.end(), glb.begin() + oldJsonEnd, glb.end());
+        write_u32(result, 8, static_cast<uint32_t>(result.size()));
+        write_u32(result, 12, static_cast<uint32_t>(json.size()));
+        return result;
+}
+
+}
+
+int main()
+{
+        std::filesystem::create_directories(DIRECTORY);
+
+        std::vector<Vertex> vertices(3);
+        vertices[0].position = { 0.0f, 0.0f, 0.0f };
+        vertices[1].position = { 1.0f, 0.0f, 0.0f };
+        vertices[2].position = { 0.0f, 1.0f, 0.0f };
+        const std::vector<uint32_t> indices { 0, 1, 2 };
+        const std::filesystem::path valid = DIRECTORY / "valid.glb";
+        CHECK(gltf::write_glb(valid.string().c_str(), vertices, indices));
+        const Bytes glb = read_file(valid);
+        CHECK(glb.size() > 20);
+        if (glb.size() <= 20) {
+                return check_result();
+        }
+
+        Mesh mesh;
+        CHECK(mesh.load_from_glb(valid.string().c_str()));
+        CHECK(mesh.vertex_count() == 3 && mesh.index_count() == 3);
+        CHECK(loads(glb));
+        CHECK(!mesh.load_from_glb(valid.string().c_str(), 1));
+        CHECK(!mesh.load_from_glb((DIRECTORY / "missing.glb").string().c_str()));
+
+        // truncated files, whatever the header claims
+        for (size_t size : { size_t(0), size_t(11), size_t(12), size_t(19), glb.size() / 2, glb.size() - 4 }) {
+                CHECK(!loads(Bytes(glb.begin(), glb.begin() + size)));
+        }
+        Bytes truncated(glb.begin(), glb.end() - 4);
+        write_u32(truncated, 8, static_cast<uint32_t>(truncated.size()));
+        CHECK(!loads(truncated));
+
+        // broken header and chunks
+        Bytes broken = glb;
+        write_u32(broken, 0, 0x12345678);
+        CHECK(!loads(broken));
+        broken = glb;
+        write_u32(broken, 4, 1);
+        CHECK(!loads(broken));
+        broken = glb;
+        write_u32(broken, 8, static_cast<uint32_t>(glb.size() + 1));
+        CHECK(!loads(broken));
+        broken = glb;
+        write_u32(broken, 12, 0xfffffff0);
+        CHECK(!loads(broken));
+        broken = glb;
+        write_u32(broken, 16, 0x12345678);
+        CHECK(!loads(broken));
+        broken = glb;
+        const size_t binHeader = 20 + read_u32(glb, 12);
+        write_u32(broken, binHeader, 0xfffffff0);
+        CHECK(!loads(broken));
+        broken = glb;
+        write_u32(broken, binHeader + 4, 0x12345678);
+        CHECK(!loads(broken));
+        broken = glb;
+        write_u32(broken, 12, read_u32(glb, 12) - 8);
+        CHECK(!loads(broken));
+
+        // accessors and buffer views reaching outside of the binary chunk
+        CHECK(loads(with_json(glb, "\"count\":3,", "\"count\":3,")));
+        CHECK(!loads(with_json(glb, "\"count\":3,", "\"count\":4,")));
+        CHECK(!loads(with_json(glb, "\"count\":3,", "\"count\":1e300,")));
+        CHECK(!loads(with_json(glb, "\"count\":3,", "\"count\":18446744073709551615,")));
+        CHECK(!loads(with_json(glb, "\"bufferView\":0,", "\"bufferView\":0,\"byteOffset\":4,")));
+        CHECK(!loads(with_json(glb, "\"bufferView\":0,", "\"bufferView\":0,\"byteOffset\":-4,")));
+        CHECK(!loads(with_json(glb, "\"bufferView\":0,", "\"bufferView\":9,")));
+        CHECK(!loads(with_json(glb, "\"bufferView\":0,", "\"bufferView\":-1,")));
+        CHECK(!loads(with_json(glb, "\"POSITION\":0", "\"POSITION\":7")));
+        CHECK(!loads(with_json(glb, "\"indices\":3", "\"indices\":4")));
+        CHECK(!loads(with_json(glb, "\"byteOffset\":0,\"byteLength\":36", "\"byteOffset\":0,\"byteLength\":4096")));
+        CHECK(!loads(with_json(glb, "\"byteOffset\":0,\"byteLength\":36", "\"byteOffset\":4096,\"byteLength\":36")));
+        CHECK(!loads(with_json(glb, "\"byteOffset\":0,\"byteLength\":36", "\"byteOffset\":0,\"byteLength\":36,\"byteStride\":4")));
+        CHECK(!loads(with_json(glb, "\"componentType\":5126", "\"componentType\":1")));
+        CHECK(!loads(with_json(glb, "\"buffers\":[{", "\"buffers\":[{\"uri\":\"a.bin\",")));
+
+        // json that doesn't parse, or isn't shaped like a glTF document
+        CHECK(!loads(with_json(glb, "{\"asset\"", "{{\"asset\"")));
+        CHECK(!loads(with_json(glb, "\"meshes\":[", "\"meshes\":[[")));
+        CHECK(!loads(with_json(glb, "\"primitives\":[", "\"primitives\":7,\"unused\":[")));
+        CHECK(!loads(with_json(glb, "{\"asset\"", std::string(1000, '[') + "{\"asset\"")));
+
+        std::filesystem::remove_all(DIRECTORY);
+        return check_result();
+}
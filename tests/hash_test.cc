@@ -0,0 +1,48 @@
+#include "check.hh"
+#include "hash.hh"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// The cache keys have to stay XXH64, these are the sanity checks of the
+// reference xxhsum, over its generated buffer.
+namespace {
+
+constexpr uint64_t PRIME32 = 2654435761u;
+constexpr uint64_t PRIME64 = 11400714785074694797ull;
+
+std::vector<uint8_t> sanity_buffer(size_t size)
+{
+        std::vector<uint8_t> buffer(size);
+        uint64_t generator = PRIME32;
+        for (uint8_t& byte : buffer) {
+                byte = static_cast<uint8_t>(generator >> 56);
+                generator *= PRIME64;
+        }
+        return buffer;
+}
+
+}
+
+int main()
+{
+        const std::vector<uint8_t> buffer = sanity_buffer(222);
+
+        CHECK(hash64(nullptr, 0, 0) == 0xEF46DB3751D8E999ull);
+        CHECK(hash64(nullptr, 0, PRIME32) == 0xAC75FDA2929B17EFull);
+        CHECK(hash64(buffer.data(), 1, 0) == 0xE934A84ADB052768ull);
+        CHECK(hash64(buffer.data(), 1, PRIME32) == 0x5014607643A9B4C3ull);
+        CHECK(hash64(buffer.data(), 4, 0) == 0x9136A0DCA57457EEull);
+        CHECK(hash64(buffer.data(), 14, 0) == 0x8282DCC4994E35C8ull);
+        CHECK(hash64(buffer.data(), 14, PRIME32) == 0xC3BD6BF63DEB6DF0ull);
+        CHECK(hash64(buffer.data(), 222, 0) == 0xB641AE8CB691C174ull);
+        CHECK(hash64(buffer.data(), 222, PRIME32) == 0x20CB8AB7AE10C14Aull);
+
+        // unaligned input hashes like aligned input
+        std::vector<uint8_t> shifted(buffer.size() + 1);
+        std::copy(buffer.begin(), buffer.end(), shifted.begin() + 1);
+        CHECK(hash64(shifted.data() + 1, 222, 0) == 0xB641AE8CB691C174ull);
+
+        return check_result();
+}
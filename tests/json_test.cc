@@ -0,0 +1,86 @@
+#include "check.hh"
+#include "json.hh"
+
+#include <cstring>
+#include <string>
+
+// The parser reads glTF headers of files nobody checked, broken documents
+// have to fail cleanly instead of reading past the end or recursing forever.
+namespace {
+
+bool parse(const std::string& text, json::Value& value)
+{
+        return json::parse(text.data(), text.size(), value);
+}
+
+bool parses(const std::string& text)
+{
+        json::Value value;
+        return parse(text, value);
+}
+
+}
+
+int main()
+{
+        json::Value value;
+        CHECK(parse(R"( {"a": [1, -2.5e3, true, null], "b": {"c": "d"}} )", value));
+        CHECK(value.is_object() && value.size() == 2);
+        const json::Value* a = value.find("a");
+        CHECK(a && a->is_array() && a->size() == 4);
+        CHECK(a && (*a)[1].as_number() == -2500.0);
+        CHECK(a && (*a)[2].as_bool());
+        CHECK(a && (*a)[3].is_null() && (*a)[4].is_null());
+        CHECK(value.find("b") && value.find("b")->find("c")->as_string() == "d");
+        CHECK(!value.find("missing"));
+
+        // escapes, including a surrogate pair
+        CHECK(parse(R"("\"\\\/\b\f\n\r\t")", value));
+        CHECK(value.as_string() == "\"\\/\b\f\n\r\t");
+        CHECK(parse(R"("\u0041\u00e9\u20ac\ud83d\ude00")", value));
+        CHECK(value.as_string() == "A\xc3\xa9\xe2\x82\xac\xf0\x9f\x98\x80");
+
+        CHECK(!parses(R"("\x")"));
+        CHECK(!parses(R"("\u12")"));
+        CHECK(!parses(R"("\u12g4")"));
+        CHECK(!parses(R"("\ud83dA")"));
+        CHECK(!parses(R"("\ud83d\u0041")"));
+        CHECK(!parses(R"("\ude00")"));
+        CHECK(!parses(R"("\)"));
+
+        // truncated documents
+        const std::string whole = R"({"a": [1, 2, {"b": "text"}]})";
+        for (size_t size = 0; size < whole.size(); size++) {
+                CHECK(!json::parse(whole.data(), size, value));
+        }
+        CHECK(parses(whole));
+
+        CHECK(!parses("{} x"));
+        CHECK(!parses("[1,]"));
+        CHECK(!parses(R"({"a" 1})"));
+        CHECK(!parses(R"({1: 2})"));
+        CHECK(!parses("1.2.3"));
+        CHECK(!parses("-"));
+        CHECK(!parses("tru"));
+
+        // the size is the end, not a terminator
+        const char padded[] = "[1] garbage";
+        CHECK(json::parse(padded, 3, value) && value.size() == 1);
+
+        // nesting is limited, deep documents fail before the stack runs out
+        CHECK(parses(std::string(200, '[') + std::string(200, ']')));
+        std::string error;
+        const std::string deep = std::string(100000, '[') + std::string(100000, ']');
+        CHECK(!json::parse(deep.data(), deep.size(), value, &error));
+        CHECK(error.find("nested too deep") != std::string::npos);
+        const std::string deepObjects = [] {
+                std::string text;
+                for (int i = 0; i < 100000; i++) {
+                        text += R"({"a":)";
+                }
+                return text;
+        }();
+        CHECK(!parses(deepObjects));
+
+        return check_result();
+}
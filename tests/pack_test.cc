@@ -0,0 +1,170 @@
+#include "check.hh"
+#include "lz4.hh"
+#include "pack_file.hh"
+#include "vfs.hh"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+// The baker only rewrites the pack when is_current says the inputs changed,
+// so it must not miss any change that write would have picked up. What is in
+// the pack has to come back out of the vfs byte for byte, compressed or not.
+namespace {
+
+const std::filesystem::path DIRECTORY = std::filesystem::temp_directory_path() / "pack_test";
+
+void write_file(const std::filesystem::path& path, const std::string& contents)
+{
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+}
+
+bool round_trip(const std::vector<uint8_t>& data)
+{
+        std::vector<uint8_t> compressed(lz4::compress_bound(data.size()));
+        const size_t size = lz4::compress(data.data(), data.size(), compressed.data(), compressed.size());
+        if (size == 0 && !data.empty()) {
+                return false;
+        }
+        std::vector<uint8_t> decompressed(data.size());
+        return lz4::decompress(compressed.data(), size, decompressed.data(), decompressed.size()) && decompressed == data;
+}
+
+void test_lz4()
+{
+        std::mt19937 random(7);
+        std::vector<uint8_t> noise(100000);
+        for (uint8_t& value : noise) {
+                value = static_cast<uint8_t>(random());
+        }
+        // text like repetition with matches of every length and distance
+        std::vector<uint8_t> text;
+        const std::string words[] = { "v 1.0 2.0 3.0\n", "vn 0 1 0\n", "f 1/1/1 2/2/2 3/3/3\n", "# comment\n" };
+        while (text.size() < 200000) {
+                const std::string& word = words[random() % 4];
+                text.insert(text.end(), word.begin(), word.end());
+        }
+        const std::vector<uint8_t> runs(70000, 'x');
+
+        CHECK(round_trip({}));
+        CHECK(round_trip({ 'a' }));
+        CHECK(round_trip(std::vector<uint8_t>(noise.begin(), noise.begin() + 13)));
+        CHECK(round_trip(noise));
+        CHECK(round_trip(text));
+        CHECK(round_trip(runs));
+
+        // repetitive data compresses, and a short buffer is never written past
+        std::vector<uint8_t> compressed(lz4::compress_bound(text.size()));
+        const size_t size = lz4::compress(text.data(), text.size(), compressed.data(), compressed.size());
+        CHECK(size > 0 && size < text.size() / 4);
+        CHECK(lz4::compress(text.data(), text.size(), compressed.data(), size / 2) == 0);
+
+        // cut off blocks and wrong sizes are rejected, corrupt ones must at
+        // least stay inside both buffers
+        std::vector<uint8_t> out(text.size());
+        CHECK(!lz4::decompress(compressed.data(), size - 1, out.data(), out.size()));
+        CHECK(!lz4::decompress(compressed.data(), size, out.data(), out.size() - 1));
+        CHECK(!lz4::decompress(compressed.data(), size, out.data(), out.size() + 1));
+        std::vector<uint8_t> broken(compressed.begin(), compressed.begin() + size);
+        for (size_t i = 0; i < broken.size(); i += 97) {
+                broken[i] ^= 0xff;
+        }
+        lz4::decompress(broken.data(), broken.size(), out.data(), out.size());
+}
+
+// Every entry read through a vfs with the pack mounted, and the files that
+// aren't in it from the disk.
+void test_vfs(const std::string& packPath, const std::vector<pack::PackInput>& inputs, const std::filesystem::path& loose)
+{
+        Vfs vfs;
+        CHECK(vfs.mount(packPath.c_str(), DIRECTORY.string().c_str()));
+        for (const pack::PackInput& input : inputs) {
+                std::ifstream source(input.path, std::ios::binary);
+                const std::string contents((std::istreambuf_iterator<char>(source)), std::istreambuf_iterator<char>());
+                const std::string path = (DIRECTORY / input.name).string();
+                VfsFile file;
+                CHECK(vfs.exists(path.c_str()));
+                CHECK(vfs.read(path.c_str(), file));
+                CHECK(file.size == contents.size() && (contents.empty() || std::memcmp(file.data, contents.data(), file.size) == 0));
+        }
+
+        // the entries shadow the files, so the pack contents come back
+        const std::string a = (DIRECTORY / inputs[0].name).string();
+        const std::string original(4096, 'a');
+        write_file(a, "changed");
+        VfsFile file;
+        CHECK(vfs.read(a.c_str(), file) && file.size == original.size() && std::memcmp(file.data, original.data(), file.size) == 0);
+        write_file(a, original);
+
+        VfsFile outside;
+        CHECK(vfs.read(loose.string().c_str(), outside) && outside.size == 5 && std::memcmp(outside.data, "loose", 5) == 0);
+        CHECK(!vfs.read((DIRECTORY / "missing.txt").string().c_str(), outside));
+        CHECK(!vfs.exists((DIRECTORY / "missing.txt").string().c_str()));
+}
+
+}
+
+int main()
+{
+        std::filesystem::create_directories(DIRECTORY);
+        const std::string packPath = (DIRECTORY / "assets.pack").string();
+        const std::filesystem::path a = DIRECTORY / "a.txt", b = DIRECTORY / "b.txt", empty = DIRECTORY / "empty.txt";
+        write_file(a, std::string(4096, 'a'));
+        write_file(b, "bbbb");
+        write_file(empty, "");
+
+        std::vector<pack::PackInput> inputs {
+                { "a.txt", a.string(), true },
+                { "b.txt", b.string(), false },
+                { "empty.txt", empty.string(), false },
+        };
+        CHECK(!pack::is_current(packPath.c_str(), inputs));
+        CHECK(pack::write(packPath.c_str(), inputs));
+        CHECK(pack::is_current(packPath.c_str(), inputs));
+        const std::filesystem::path loose = DIRECTORY / "loose.txt";
+        write_file(loose, "loose");
+        test_vfs(packPath, inputs, loose);
+
+        // different names, order, count or compression
+        std::vector<pack::PackInput> changed = inputs;
+        changed[1].name = "c.txt";
+        CHECK(!pack::is_current(packPath.c_str(), changed));
+        changed = inputs;
+        std::swap(changed[0], changed[1]);
+        CHECK(!pack::is_current(packPath.c_str(), changed));
+        changed = inputs;
+        changed.pop_back();
+        CHECK(!pack::is_current(packPath.c_str(), changed));
+        changed = inputs;
+        changed.push_back({ "d.txt", a.string(), false });
+        CHECK(!pack::is_current(packPath.c_str(), changed));
+        changed = inputs;
+        changed[0].compress = false;
+        CHECK(!pack::is_current(packPath.c_str(), changed));
+        // b.txt is too short to gain anything, it was stored as it is
+        changed = inputs;
+        changed[1].compress = true;
+        CHECK(!pack::is_current(packPath.c_str(), changed));
+
+        // same size, other contents, and another size
+        write_file(b, "bbbc");
+        CHECK(!pack::is_current(packPath.c_str(), inputs));
+        write_file(b, "bbbb");
+        CHECK(pack::is_current(packPath.c_str(), inputs));
+        write_file(b, "bbbbb");
+        CHECK(!pack::is_current(packPath.c_str(), inputs));
+        std::filesystem::remove(b);
+        CHECK(!pack::is_current(packPath.c_str(), inputs));
+
+        // whatever isn't a pack
+        write_file(packPath, "not a pack");
+        CHECK(!pack::is_current(packPath.c_str(), inputs));
+
+        test_lz4();
+
+        std::filesystem::remove_all(DIRECTORY);
+        return check_result();
+}
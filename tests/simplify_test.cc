@@ -0,0 +1,60 @@
+#include "check.hh"
+#include "mesh.hh"
+#include "simplify.hh"
+
+// A bumpy grid whose left and right half have different colors. The column
+// in the middle exists twice, once per color, like a texture or color seam
+// does after loading. Every level has to keep drawing each half with its own
+// vertices, the welded positions are only for simplifying.
+int main()
+{
+        constexpr uint32_t SIZE = 32;
+        constexpr uint32_t SEAM = SIZE / 2;
+        const glm::vec3 left { 1.0f, 0.0f, 0.0f };
+        const glm::vec3 right { 0.0f, 0.0f, 1.0f };
+
+        std::vector<Vertex> vertices;
+        // vertex of a grid point, on the seam the copy of the given side
+        auto vertex = [&](uint32_t x, uint32_t y, bool leftSide) {
+                Vertex v;
+                v.position = { static_cast<float>(x), 0.1f * ((x * 7 + y * 3) % 5), static_cast<float>(y) };
+                v.normals = { 0.0f, 1.0f, 0.0f };
+                v.color = leftSide ? left : right;
+                vertices.push_back(v);
+                return static_cast<uint32_t>(vertices.size() - 1);
+        };
+        std::vector<uint32_t> leftIds((SIZE + 1) * (SIZE + 1)), rightIds((SIZE + 1) * (SIZE + 1));
+        for (uint32_t y = 0; y <= SIZE; y++) {
+                for (uint32_t x = 0; x <= SIZE; x++) {
+                        uint32_t i = y * (SIZE + 1) + x;
+                        leftIds[i] = x <= SEAM ? vertex(x, y, true) : UINT32_MAX;
+                        rightIds[i] = x == SEAM ? vertex(x, y, false) : x > SEAM ? vertex(x, y, false) : leftIds[i];
+                }
+        }
+
+        std::vector<uint32_t> indices;
+        for (uint32_t y = 0; y < SIZE; y++) {
+                for (uint32_t x = 0; x < SIZE; x++) {
+                        const std::vector<uint32_t>& ids = x < SEAM ? leftIds : rightIds;
+                        uint32_t a = ids[y * (SIZE + 1) + x];
+                        uint32_t b = ids[y * (SIZE + 1) + x + 1];
+                        uint32_t c = ids[(y + 1) * (SIZE + 1) + x];
+                        uint32_t d = ids[(y + 1) * (SIZE + 1) + x + 1];
+                        indices.insert(indices.end(), { a, c, b, b, c, d });
+                }
+        }
+
+        float error = 0.0f;
+        std::vector<uint32_t> lod = simplify_mesh(vertices, indices.data(), indices.size(), indices.size() / 4, error);
+        CHECK(lod.size() < indices.size());
+        CHECK(lod.size() % 3 == 0);
+
+        for (size_t i = 0; i + 2 < lod.size(); i += 3) {
+                CHECK(lod[i] < vertices.size() && lod[i + 1] < vertices.size() && lod[i + 2] < vertices.size());
+                // no triangle mixes the two halves
+                CHECK(vertices[lod[i]].color == vertices[lod[i + 1]].color);
+                CHECK(vertices[lod[i]].color == vertices[lod[i + 2]].color);
+        }
+
+        return check_result();
+}
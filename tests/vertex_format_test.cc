@@ -0,0 +1,113 @@
+#include "check.hh"
+#include "mesh.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <glm/glm.hpp>
+
+// The Packed vertices have to decode to the Full ones, within the precision of
+// their formats, for both formats to render the same. The decoding follows
+// what the input assembler and tri_mesh.vert do with them.
+namespace {
+
+float unorm16(uint16_t value)
+{
+        return value / 65535.0f;
+}
+
+float snorm(int value, float max)
+{
+        return std::max(value / max, -1.0f);
+}
+
+// octahedral_decode of tri_mesh.vert
+glm::vec3 octahedral_decode(float x, float y)
+{
+        glm::vec3 n { x, y, 1.0f - std::abs(x) - std::abs(y) };
+        float t = std::max(-n.z, 0.0f);
+        n.x += n.x >= 0.0f ? -t : t;
+        n.y += n.y >= 0.0f ? -t : t;
+        return glm::normalize(n);
+}
+
+bool near(const glm::vec3& a, const glm::vec3& b, float tolerance)
+{
+        return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+}
+
+}
+
+int main()
+{
+        // normals pointing every way, and like the loaders do, the normal
+        // doubles as the color on all but the last vertex
+        const glm::vec3 normals[] = {
+                { 1.0f, 0.0f, 0.0f },
+                { -1.0f, 0.0f, 0.0f },
+                { 0.0f, -1.0f, 0.0f },
+                { 0.0f, 0.0f, -1.0f },
+                glm::normalize(glm::vec3 { -0.3f, 0.5f, -0.8f }),
+                glm::normalize(glm::vec3 { 0.7f, -0.2f, 0.4f }),
+        };
+
+        Mesh mesh;
+        mesh._format = VertexFormat::Packed;
+        for (size_t i = 0; i < std::size(normals); i++) {
+                Vertex vertex;
+                vertex.position = { -2.0f + i * 0.7f, 1.0f - i * 0.3f, 0.5f * i };
+                vertex.normals = normals[i];
+                vertex.color = normals[i];
+                mesh._vertices.push_back(vertex);
+        }
+        mesh._vertices.back().color = { 0.25f, 0.5f, 1.0f };
+        mesh.compute_bounds();
+        mesh.pack_vertices();
+
+        CHECK(mesh._packedVertices.size() == mesh._vertices.size());
+        const glm::mat4 transform = mesh.vertex_transform();
+        const glm::vec3 extent = mesh._bounds.max - mesh._bounds.min;
+        const float positionTolerance = std::max({ extent.x, extent.y, extent.z }) / 65535.0f;
+
+        for (size_t i = 0; i < mesh._vertices.size(); i++) {
+                const Vertex& full = mesh._vertices[i];
+                const PackedVertex& packed = mesh._packedVertices[i];
+
+                glm::vec4 position = transform
+                        * glm::vec4(unorm16(packed.position[0]), unorm16(packed.position[1]), unorm16(packed.position[2]), 1.0f);
+                CHECK(near(glm::vec3(position), full.position, positionTolerance));
+
+                glm::vec3 normal = octahedral_decode(snorm(packed.normal[0], 32767.0f), snorm(packed.normal[1], 32767.0f));
+                CHECK(near(normal, full.normals, 1e-3f));
+
+                glm::vec3 color { snorm(packed.color[0], 127.0f), snorm(packed.color[1], 127.0f), snorm(packed.color[2], 127.0f) };
+                CHECK(near(color, full.color, 0.5f / 127.0f + 1e-6f));
+        }
+
+        // flat along z, the positions still come back and the matrix can be
+        // inverted for the normals
+        Mesh flat;
+        flat._format = VertexFormat::Packed;
+        for (const glm::vec3& position : { glm::vec3 { 0.0f, 0.0f, 3.0f }, glm::vec3 { 2.0f, 0.0f, 3.0f }, glm::vec3 { 0.0f, 1.0f, 3.0f } }) {
+                Vertex vertex;
+                vertex.position = position;
+                vertex.normals = { 0.0f, 0.0f, 1.0f };
+                vertex.color = vertex.normals;
+                flat._vertices.push_back(vertex);
+        }
+        flat.compute_bounds();
+        flat.pack_vertices();
+        const glm::mat4 flatTransform = flat.vertex_transform();
+        CHECK(glm::determinant(flatTransform) != 0.0f);
+        const glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(flatTransform)));
+        const glm::vec3 flatNormal = normalMatrix * glm::vec3(0.0f, 0.0f, 1.0f);
+        CHECK(std::isfinite(flatNormal.x) && std::isfinite(flatNormal.y) && std::isfinite(flatNormal.z));
+        CHECK(near(glm::normalize(flatNormal), glm::vec3(0.0f, 0.0f, 1.0f), 1e-5f));
+        for (size_t i = 0; i < flat._vertices.size(); i++) {
+                const PackedVertex& packed = flat._packedVertices[i];
+                glm::vec4 position = flatTransform
+                        * glm::vec4(unorm16(packed.position[0]), unorm16(packed.position[1]), unorm16(packed.position[2]), 1.0f);
+                CHECK(near(glm::vec3(position), flat._vertices[i].position, 2.0f / 65535.0f));
+        }
+
+        return check_result();
+}